@@ -0,0 +1,458 @@
+/* Name:        benchjigsaw.c
+ *
+ * Description: Micro-benchmarks for the jigsaw puzzle tools.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ * Build:       gcc -O2 -o benchjigsaw benchjigsaw.c jigsawload.c \
+ *                  jigsawnet.c jigsawpiece.c jigsawsol.c -lpthread
+ *
+ */
+
+/*
+ * INTRODUCTION
+ * This program times the inner routines of the solver and validator on
+ * random data so that changes to them can be measured on their own.  The
+ * first argument names the benchmark to run:
+ *     benchjigsaw rotate
+ *     benchjigsaw load <pieces>
+ *     benchjigsaw table <pieces> <edge>
+ *
+ * rotate
+ * Rotates random pieces of each edge size by 90, 180, and 270 degrees,
+ * once with jp_rotate() and once with the index arithmetic that the tools
+ * used before, moving one cell at a time.  The two results are compared
+ * for every piece and the time per rotation of each is printed.
+ *
+ * load
+ * Reads the files p0000.pbm up to the given number of pieces from the
+ * current directory with each way jl_foreach() has of reading them, one
+ * file at a time, on a pool of threads, and through io_uring, and prints
+ * the files read per second of each.  The first pass is not timed so that
+ * all three find the files in the page cache; to time reads from the disk
+ * drop the caches between runs and give each way a run of its own.
+ *
+ * table
+ * Times how a worker of solvejigsaw gets its pieces.  Without -b each
+ * worker reads and parses the .pbm files itself; with -b the coordinator
+ * reads them once and sends each worker a table of 8 byte masks in piece
+ * order.  The benchmark reads and parses the files in the current
+ * directory, then sends the table to a child process over a TCP socket
+ * on this machine, which checks it against its own copy.  The time per
+ * pass and pieces per second of each are printed.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "jigsawload.h"
+#include "jigsawnet.h"
+#include "jigsawpiece.h"
+#include "jigsawsol.h"
+
+
+
+/**************************************************************
+ *  - Limits and defines
+ **************************************************************/
+        // Maximum resolution of the fingers on a piece
+#define MAX_EDGE     8
+        // Number of random pieces rotated per edge size
+#define NPIECE       (1 << 16)
+        // Number of passes over the pieces
+#define NPASS        16
+        // Number of passes over the files
+#define NLOADPASS    3
+        // Message types of the table benchmark
+#define MSG_TABLE    1
+#define MSG_ACK      2
+
+
+/**************************************************************
+ *  - Data structures
+ **************************************************************/
+typedef struct {
+    uint64_t *mask;         // mask of each piece
+    int       edge;         // edge of the pieces
+    int       bad;          // set if a file is missing or bad
+} TABLEREAD;
+
+
+/**************************************************************
+ *  - Globals, function prototypes, and forward references
+ **************************************************************/
+void     benchrotate(void);
+void     benchload(int);
+void     benchtable(int, int);
+int      tablefile(void *, int, const char *, size_t);
+void     loadname(void *, int, char *, size_t);
+int      loadfile(void *, int, const char *, size_t);
+uint64_t indexrotate(uint64_t, int, int);
+uint64_t randpiece(int);
+double   elapsed(struct timespec *);
+
+
+
+
+/**************************************************************
+ * main(): - Run the benchmark named on the command line
+ *
+ * Input:        argc, argv
+ * Output:       0 on normal exit, 1 on error exit
+ **************************************************************/
+int main(int argc, char **argv)
+{
+    int   npiece;           // number of files for the load benchmark
+    int   edge;             // edge of the pieces for the table benchmark
+
+    if ((argc == 2) && (strcmp(argv[1], "rotate") == 0)) {
+        benchrotate();
+        exit(0);
+    }
+    if ((argc == 3) && (strcmp(argv[1], "load") == 0) &&
+        (sscanf(argv[2], "%d", &npiece) == 1) && (npiece > 0)) {
+        benchload(npiece);
+        exit(0);
+    }
+    if ((argc == 4) && (strcmp(argv[1], "table") == 0) &&
+        (sscanf(argv[2], "%d", &npiece) == 1) && (npiece > 0) &&
+        (sscanf(argv[3], "%d", &edge) == 1) && (edge >= 2) &&
+        (edge <= MAX_EDGE)) {
+        benchtable(npiece, edge);
+        exit(0);
+    }
+
+    printf("Usage: %s rotate | load <pieces> | table <pieces> <edge>\n", argv[0]);
+    exit(1);
+}
+
+
+/**************************************************************
+ * benchrotate(): - Time jp_rotate() against index rotation for
+ * each edge size and check that they agree.
+ *
+ **************************************************************/
+void benchrotate(void)
+{
+    uint64_t *piece;        // random pieces
+    uint64_t  sum;          // sum of results so no work is skipped
+    struct timespec start;  // start of a timed loop
+    double    tindex;       // ns per rotation by index
+    double    tbits;        // ns per rotation by jp_rotate()
+    int       edge;         // edge size being timed
+    int       rot;          // rotation
+    int       pass;         // pass over the pieces
+    int       n;            // piece index
+
+    piece = (uint64_t *) malloc(sizeof(uint64_t) * NPIECE);
+    if (piece == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+
+    printf("edge   index ns   jp_rotate ns   speedup\n");
+    for (edge = 2; edge <= MAX_EDGE; edge++) {
+        for (n = 0; n < NPIECE; n++)
+            piece[n] = randpiece(edge);
+
+        // Both ways must give the same answer
+        for (n = 0; n < NPIECE; n++) {
+            for (rot = 0; rot < 4; rot++) {
+                if (jp_rotate(piece[n], rot, edge) !=
+                    indexrotate(piece[n], rot, edge)) {
+                    printf("Mismatch at edge %d rotation %d on %016llx\n",
+                           edge, rot, (unsigned long long) piece[n]);
+                    exit(1);
+                }
+            }
+        }
+
+        sum = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (pass = 0; pass < NPASS; pass++)
+            for (n = 0; n < NPIECE; n++)
+                for (rot = 1; rot < 4; rot++)
+                    sum += indexrotate(piece[n], rot, edge);
+        tindex = elapsed(&start) / ((double) NPASS * NPIECE * 3);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (pass = 0; pass < NPASS; pass++)
+            for (n = 0; n < NPIECE; n++)
+                for (rot = 1; rot < 4; rot++)
+                    sum -= jp_rotate(piece[n], rot, edge);
+        tbits = elapsed(&start) / ((double) NPASS * NPIECE * 3);
+
+        printf("%4d %10.2f %14.2f %9.1fx%s\n", edge, tindex, tbits,
+               tindex / tbits, (sum == 0) ? "" : "  (sum mismatch)");
+    }
+    free(piece);
+}
+
+
+/**************************************************************
+ * benchload(): - Time reading the .pbm files of a puzzle one at
+ * a time, on a pool of threads, and through io_uring.
+ *
+ **************************************************************/
+void benchload(int npiece)
+{
+    static const char *way[] = { "auto", "io_uring", "threads", "serial" };
+    static const int order[] = { JL_SERIAL, JL_THREADS, JL_URING };
+    struct timespec start;  // start of a timed loop
+    long      bytes;        // bytes read in a pass
+    long      first;        // bytes read in the first pass
+    double    t;            // ns for one pass
+    double    tserial = 0;  // ns for one pass one file at a time
+    int       how;          // way of reading the files
+    int       pass;         // pass over the files
+    int       ret;          // return from jl_foreach()
+    int       i;            // index into order[]
+
+    // Warm the page cache, and check that all the files are there
+    bytes = 0;
+    if (jl_foreach(npiece, JL_AUTO, loadname, loadfile, &bytes) != JL_OK) {
+        printf("Missing piece files, run makejigsaw first\n");
+        exit(1);
+    }
+    first = bytes;
+
+    printf("%-10s %12s %12s %9s\n", "way", "ms/pass", "files/sec", "speedup");
+    for (i = 0; i < 3; i++) {
+        how = order[i];
+        ret = JL_OK;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (pass = 0; (pass < NLOADPASS) && (ret == JL_OK); pass++) {
+            bytes = 0;
+            ret = jl_foreach(npiece, how, loadname, loadfile, &bytes);
+            if ((ret == JL_OK) && (bytes != first)) {
+                printf("%s read %ld bytes, not %ld\n", way[how], bytes, first);
+                exit(1);
+            }
+        }
+        t = elapsed(&start) / NLOADPASS;
+        if (ret == JL_NOURING) {
+            printf("%-10s %12s\n", way[how], "not available");
+            continue;
+        }
+        else if (ret != JL_OK) {
+            printf("%-10s %12s\n", way[how], "failed");
+            continue;
+        }
+        if (how == JL_SERIAL)
+            tserial = t;
+        printf("%-10s %12.2f %12.0f %8.1fx\n", way[how], t / 1e6,
+               npiece / (t / 1e9), tserial / t);
+    }
+}
+
+
+/**************************************************************
+ * loadname(): - Give jl_foreach() the name of piece n
+ *
+ **************************************************************/
+void loadname(void *arg, int n, char *name, size_t len)
+{
+    js_name(JS_ENTRY(n, 0), name, len);
+}
+
+
+/**************************************************************
+ * loadfile(): - Count the bytes of each file read, or stop if
+ * a file is missing.
+ *
+ **************************************************************/
+int loadfile(void *arg, int n, const char *data, size_t len)
+{
+    if (data == 0)
+        return(1);
+    __atomic_fetch_add((long *) arg, (long) len, __ATOMIC_RELAXED);
+    return(0);
+}
+
+
+/**************************************************************
+ * benchtable(): - Time a worker getting the masks of the pieces
+ * by reading and parsing the files, and by taking the table of
+ * masks from the coordinator over TCP.
+ *
+ **************************************************************/
+void benchtable(int npiece, int edge)
+{
+    TABLEREAD tr;           // table filled from the files
+    struct timespec start;  // start of a timed loop
+    char  hostport[32];     // where the child connects
+    char *buf = 0;          // message body
+    size_t buflen = 0;      // size of buf
+    uint32_t type;          // message type
+    double tfiles;          // ns for one pass over the files
+    double ttable;          // ns to send the table once
+    int   lfd;              // listening socket
+    int   fd;               // socket to the child
+    int   port;             // port the child connects to
+    int   status;           // exit status of the child
+    int   pass;             // pass over the files or the table
+
+    tr.mask = (uint64_t *) malloc(sizeof(uint64_t) * npiece);
+    if (tr.mask == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    tr.edge = edge;
+    tr.bad = 0;
+
+    // Warm the page cache, and check that all the files are there
+    if ((jl_foreach(npiece, JL_AUTO, loadname, tablefile, &tr) != JL_OK) ||
+        tr.bad) {
+        printf("Missing or bad piece files, run makejigsaw first\n");
+        exit(1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (pass = 0; pass < NLOADPASS; pass++)
+        jl_foreach(npiece, JL_AUTO, loadname, tablefile, &tr);
+    tfiles = elapsed(&start) / NLOADPASS;
+
+    // The child has the table from before the fork to check against
+    lfd = jn_listen(0, &port);
+    if (lfd < 0) {
+        printf("Unable to listen: %s\n", strerror(errno));
+        exit(1);
+    }
+    snprintf(hostport, sizeof(hostport), "127.0.0.1:%d", port);
+    fflush(stdout);
+    if (fork() == 0) {
+        close(lfd);
+        fd = jn_connect(hostport);
+        for (pass = 0; pass < NLOADPASS; pass++) {
+            if ((fd < 0) ||
+                (jn_recv(fd, &type, &buf, &buflen) != (int) (sizeof(uint64_t) * npiece)) ||
+                (memcmp(buf, tr.mask, sizeof(uint64_t) * npiece) != 0) ||
+                (jn_send(fd, MSG_ACK, 0, 0) != 0))
+                exit(1);
+        }
+        exit(0);
+    }
+    fd = jn_accept(lfd);
+    if (fd < 0) {
+        printf("Unable to accept: %s\n", strerror(errno));
+        exit(1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (pass = 0; pass < NLOADPASS; pass++) {
+        if ((jn_send(fd, MSG_TABLE, tr.mask, sizeof(uint64_t) * npiece) != 0) ||
+            (jn_recv(fd, &type, &buf, &buflen) != 0))
+            break;
+    }
+    ttable = elapsed(&start) / NLOADPASS;
+    close(fd);
+    close(lfd);
+    wait(&status);
+    if ((pass < NLOADPASS) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+        printf("The table was not received intact\n");
+        exit(1);
+    }
+
+    printf("table of %d pieces is %.2f MB\n", npiece,
+           (sizeof(uint64_t) * (double) npiece) / 1e6);
+    printf("%-10s %12s %12s %9s\n", "way", "ms/pass", "pieces/sec", "speedup");
+    printf("%-10s %12.2f %12.0f %8.1fx\n", "files", tfiles / 1e6,
+           npiece / (tfiles / 1e9), 1.0);
+    printf("%-10s %12.2f %12.0f %8.1fx\n", "table", ttable / 1e6,
+           npiece / (ttable / 1e9), tfiles / ttable);
+    free(tr.mask);
+    free(buf);
+}
+
+
+/**************************************************************
+ * tablefile(): - Parse the text of a .pbm file into the table,
+ * or note that it is missing or bad.
+ *
+ **************************************************************/
+int tablefile(void *arg, int n, const char *data, size_t len)
+{
+    TABLEREAD *tr = (TABLEREAD *) arg;
+
+    if ((data == 0) || (jp_parsepbm(data, len, tr->edge, &tr->mask[n]) != 0)) {
+        tr->bad = 1;
+        return(1);
+    }
+    return(0);
+}
+
+
+/**************************************************************
+ * indexrotate(): - Rotate a piece one cell at a time using the
+ * rotation formulas of the validator's getgrid().
+ *
+ **************************************************************/
+uint64_t indexrotate(uint64_t mask, int rot, int edge)
+{
+    uint64_t out = 0;       // rotated piece
+    int   ik,jk;            // Increment over edge in i/j dimension
+    int   x = 0;            // bit of the rotated piece
+
+    for (jk = 0; jk < edge; jk++) {
+        for (ik = 0; ik < edge; ik++) {
+            if (((mask >> (ik + (jk * JP_STRIDE))) & 1) == 0)
+                continue;
+            if (rot == 0)
+                x = ik + (jk * JP_STRIDE);                          // 0
+            else if (rot == 1)
+                x = jk + ((edge -1 -ik) * JP_STRIDE);               // 90
+            else if (rot == 2)
+                x = (edge -1 -ik) + ((edge -1 -jk) * JP_STRIDE);    // 180
+            else
+                x = (edge -1 -jk) + (ik * JP_STRIDE);               // 270
+            out |= (uint64_t) 1 << x;
+        }
+    }
+    return(out);
+}
+
+
+/**************************************************************
+ * randpiece(): - Return a random mask with only the bits in the
+ * edge x edge square set.
+ *
+ **************************************************************/
+uint64_t randpiece(int edge)
+{
+    uint64_t mask = 0;      // piece being built
+    int   ik,jk;            // Increment over edge in i/j dimension
+
+    for (jk = 0; jk < edge; jk++)
+        for (ik = 0; ik < edge; ik++)
+            if (rand() % 2)
+                mask |= (uint64_t) 1 << (ik + (jk * JP_STRIDE));
+    return(mask);
+}
+
+
+/**************************************************************
+ * elapsed(): - Return the nanoseconds since start
+ *
+ **************************************************************/
+double elapsed(struct timespec *start)
+{
+    struct timespec now;    // current time
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return(((now.tv_sec - start->tv_sec) * 1e9) +
+           (now.tv_nsec - start->tv_nsec));
+}
@@ -0,0 +1,135 @@
+/* Name:        convertjigsaw.c
+ *
+ * Description: This program converts a jigsaw puzzle solution between the
+ *              text format of solution.txt and the binary format of
+ *              solution.bin.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ * Build:       gcc -o convertjigsaw convertjigsaw.c jigsawsol.c
+ *
+ */
+
+/*
+ * INTRODUCTION
+ * This program converts a solution to a jigsaw puzzle from one format to
+ * the other.  The input format is detected from the first bytes of the
+ * input file.  A typical use might be
+ *     convertjigsaw 500 500 7 solution.txt solution.bin
+ *
+ * The binary format is described in jigsawsol.h.  It stores the piece
+ * number from the pNNNN.pbm file name and the rotation in one 32 bit
+ * word, so a text solution can only be converted if all of its names
+ * have that form.
+ *
+ * The width, height, and edge resolution are stored in the header of a
+ * binary solution.  When converting from binary they must match the
+ * values given on the command line.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include "jigsawsol.h"
+
+
+
+/**************************************************************
+ *  - Limits and defines
+ **************************************************************/
+        // Maximum width and height of a puzzle
+#define MAX_WIDTH    500
+#define MAX_HEIGHT   500
+        // Maximum resolution of the fingers on a piece
+#define MAX_EDGE     8
+
+
+
+
+/**************************************************************
+ * main(): - Collect the width, height, finger size, and file
+ *           names, then convert the solution.
+ *
+ * Input:        argc, argv
+ * Output:       0 on normal exit, 1 on error exit
+ **************************************************************/
+int main(int argc, char **argv)
+{
+    JSOL  sol;              // the solution being converted
+    int   width;            // Width of the puzzle in pieces
+    int   height;           // Height of the puzzle in pieces
+    int   edge;             // Resolution of a piece edge
+    char *infile;           // file to convert
+    char *outfile;          // file to create
+
+
+    // Get the width, height, edge resolution, and files from the user
+    if (! ((argc == 6) &&
+           (sscanf(argv[1], "%d", &width) == 1) &&
+           (sscanf(argv[2], "%d", &height) == 1) &&
+           (sscanf(argv[3], "%d", &edge) == 1) &&
+           (width >= 2) &&
+           (height >= 2) &&
+           (edge >= 2) &&
+           (width <= MAX_WIDTH) &&
+           (height <= MAX_HEIGHT) &&
+           (edge <= MAX_EDGE)))
+    {
+        // Could not get puzzle parameters
+        printf("Usage: %s <width> <height> <size> <infile> <outfile>\n", argv[0]);
+        exit(1);
+    }
+    infile = argv[4];
+    outfile = argv[5];
+
+    if (js_isbin(infile)) {
+        // Binary to text
+        if (js_mapbin(&sol, infile) != 0) {
+            printf("Error reading binary solution %s\n", infile);
+            exit(1);
+        }
+        if ((sol.width != width) || (sol.height != height) || (sol.edge != edge)) {
+            printf("%s is for a %d %d %d puzzle\n", infile, sol.width,
+                   sol.height, sol.edge);
+            exit(1);
+        }
+        if (js_writetxt(outfile, sol.ent, sol.n) != 0) {
+            printf("Error writing %s: %s\n", outfile, strerror(errno));
+            exit(1);
+        }
+    }
+    else {
+        // Text to binary
+        if (js_readtxt(&sol, infile) != 0) {
+            if (sol.line)
+                printf("Error on line %d of %s\n", sol.line, infile);
+            else
+                printf("Error reading text solution %s\n", infile);
+            exit(1);
+        }
+        if (js_writebin(outfile, width, height, edge, sol.ent, sol.n) != 0) {
+            if (errno == EINVAL)
+                printf("%s has names not of the form pNNNN.pbm\n", infile);
+            else
+                printf("Error writing %s: %s\n", outfile, strerror(errno));
+            exit(1);
+        }
+    }
+
+    js_free(&sol);
+    exit(0);
+}
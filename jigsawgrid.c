@@ -0,0 +1,353 @@
+/* Name:        jigsawgrid.c
+ *
+ * Description: Incremental placement oracle for jigsaw puzzles.  Pieces
+ *              are placed on and removed from a bitset grid using the
+ *              same geometry as makejigsaw and validatejigsaw.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ * Build:       Link with the program that uses it, for example
+ *              gcc -o validatejigsaw validatejigsaw.c jigsawgrid.c \
+ *                  jigsawpiece.c ...
+ *
+ */
+
+/*
+ * PROGRAM DESIGN
+ * The grid is the same gw x gh grid of cells used by makejigsaw but it
+ * stores one bit per cell instead of the owning piece number.  A piece at
+ * puzzle position (i,j) covers the grid cells starting at
+ *     is = i * (edge -1)
+ *     js = j * (edge -1)
+ * Each piece is rotated with jp_rotate() so that bit (ik,jk) of the mask
+ * is the cell at offset (ik,jk) from (is,js).  jg_init() saves the grid
+ * offset and mask bit of each perimeter cell, and placing a piece is then
+ * a walk over that table.
+ *
+ * The owner of a cell is not stored.  When a collision is found the owner
+ * is recovered from the placement stack by checking the (at most four)
+ * positions whose pieces could cover the cell.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jigsawgrid.h"
+
+
+/**************************************************************
+ *  - Globals, function prototypes, and forward references
+ **************************************************************/
+static int  getbit(const JGRID *, long);
+static int  covers(const JGRID *, int, int, int);
+
+
+
+
+/**************************************************************
+ * jg_init(): - Allocate an empty grid for a puzzle of the given
+ * width, height, and edge resolution.
+ *
+ * Input:        grid to init, width, height, edge
+ * Output:       0 on success, -1 on malloc failure
+ **************************************************************/
+int jg_init(JGRID *g, int width, int height, int edge)
+{
+    int   ik,jk;            // Increment over edge in i/j dimension
+    int   n;                // perimeter cell count
+    long  nwords;           // size of the bitset in 64 bit words
+    int   i;                // generic loop counter
+
+    memset(g, 0, sizeof(JGRID));
+    g->width = width;
+    g->height = height;
+    g->edge = edge;
+    g->gw = (width * (edge - 1)) + 1;
+    g->gh = (height * (edge - 1)) + 1;
+
+    nwords = (((long) g->gw * g->gh) + 63) / 64;
+    g->bits = (uint64_t *) calloc(nwords, sizeof(uint64_t));
+    g->stack = (JGPLACE *) malloc(sizeof(JGPLACE) * width * height);
+    g->at = (int *) malloc(sizeof(int) * width * height);
+    if ((g->bits == 0) || (g->stack == 0) || (g->at == 0)) {
+        jg_free(g);
+        return(-1);
+    }
+    for (i = 0; i < width * height; i++)
+        g->at[i] = -1;
+
+    g->inner = jg_inner(edge);
+
+    // Perimeter cells in grid order, with the mask bit of each
+    n = 0;
+    for (jk = 0; jk < edge; jk++) {
+        for (ik = 0; ik < edge; ik++) {
+            if ((ik != 0) && (jk != 0) && (ik != edge - 1) && (jk != edge - 1))
+                continue;
+            g->poff[n] = ik + (jk * g->gw);
+            g->pbit[n] = ik + (jk * JG_STRIDE);
+            n++;
+        }
+    }
+    g->nperim = n;
+
+    return(0);
+}
+
+
+/**************************************************************
+ * jg_free(): - Release the memory held by a grid
+ *
+ **************************************************************/
+void jg_free(JGRID *g)
+{
+    free(g->bits);
+    free(g->stack);
+    free(g->at);
+    g->bits = 0;
+    g->stack = 0;
+    g->at = 0;
+}
+
+
+/**************************************************************
+ * jg_place(): - Claim the grid cells of a piece placed at the
+ * given position and rotation.  On failure the grid is not
+ * changed and cx, cy, and owner tell what went wrong.
+ *
+ * Input:        grid, .pbm mask, position, rotation (0-3)
+ * Output:       JG_OK, JG_COLLIDE, JG_HOLE, or JG_RANGE
+ **************************************************************/
+int jg_place(JGRID *g, uint64_t mask, int pos, int rot)
+{
+    long  base;             // grid location of the piece's top left cell
+    long  x;                // location in the grid
+    uint64_t bits;          // piece bits after rotation
+    int   k;                // perimeter cell index
+
+    if ((pos < 0) || (pos >= g->width * g->height) || (rot < 0) ||
+        (rot > 3) || (g->at[pos] != -1))
+        return(JG_RANGE);
+
+    base = ((long) (pos % g->width) * (g->edge - 1)) +
+           ((long) (pos / g->width) * (g->edge - 1) * g->gw);
+
+    // A hole in the interior can never be filled by a neighbour
+    bits = jp_rotate(mask, rot, g->edge);
+    if ((bits & g->inner) != g->inner) {
+        // Report the first hole in the grid frame
+        k = __builtin_ctzll(g->inner & ~bits);
+        x = base + (k % JG_STRIDE) + ((long) (k / JG_STRIDE) * g->gw);
+        g->cx = x % g->gw;
+        g->cy = x / g->gw;
+        g->owner = -1;
+        return(JG_HOLE);
+    }
+
+    // Check every perimeter cell before claiming any of them
+    for (k = 0; k < g->nperim; k++) {
+        if (((bits >> g->pbit[k]) & 1) == 0)
+            continue;
+        x = base + g->poff[k];
+        if (getbit(g, x)) {
+            g->cx = x % g->gw;
+            g->cy = x / g->gw;
+            g->owner = covers(g, g->cx, g->cy, pos);
+            return(JG_COLLIDE);
+        }
+    }
+    for (k = 0; k < g->nperim; k++) {
+        if ((bits >> g->pbit[k]) & 1) {
+            x = base + g->poff[k];
+            g->bits[x / 64] |= (uint64_t) 1 << (x % 64);
+        }
+    }
+
+    g->stack[g->nplaced].pos = pos;
+    g->stack[g->nplaced].rot = rot;
+    g->stack[g->nplaced].mask = bits;
+    g->at[pos] = g->nplaced;
+    g->nplaced++;
+    g->nfilled += __builtin_popcountll(mask);
+
+    return(JG_OK);
+}
+
+
+/**************************************************************
+ * jg_unplace(): - Remove the most recently placed piece
+ *
+ * Input:        grid
+ * Output:       position of the piece removed, -1 if grid is empty
+ **************************************************************/
+int jg_unplace(JGRID *g)
+{
+    JGPLACE *p;             // placement being undone
+    long  base;             // grid location of the piece's top left cell
+    long  x;                // location in the grid
+    int   k;                // perimeter cell index
+
+    if (g->nplaced == 0)
+        return(-1);
+
+    g->nplaced--;
+    p = &g->stack[g->nplaced];
+    base = ((long) (p->pos % g->width) * (g->edge - 1)) +
+           ((long) (p->pos / g->width) * (g->edge - 1) * g->gw);
+    for (k = 0; k < g->nperim; k++) {
+        if ((p->mask >> g->pbit[k]) & 1) {
+            x = base + g->poff[k];
+            g->bits[x / 64] &= ~((uint64_t) 1 << (x % 64));
+        }
+    }
+    g->at[p->pos] = -1;
+    g->nfilled -= __builtin_popcountll(p->mask);
+
+    return(p->pos);
+}
+
+
+/**************************************************************
+ * jg_is_complete(): - Return true if every cell of the grid is
+ * claimed.  Since jg_place() never allows a cell to be claimed
+ * twice this is just a count of the claimed cells.
+ *
+ **************************************************************/
+int jg_is_complete(const JGRID *g)
+{
+    return(g->nfilled == (long) g->gw * g->gh);
+}
+
+
+/**************************************************************
+ * jg_firsthole(): - Find the first unclaimed grid cell scanning
+ * from the top left.  Slow, for use in error messages only.
+ *
+ * Input:        grid, pointers for the grid i and j of the hole
+ * Output:       1 if a hole was found, 0 if the grid is complete
+ **************************************************************/
+int jg_firsthole(const JGRID *g, int *hi, int *hj)
+{
+    int   i,j;              // loop indices
+    int   step;             // distance between seams
+
+    step = g->edge - 1;
+    for (j = 0; j < g->gh; j++) {
+        for (i = 0; i < g->gw; i++) {
+            if (getbit(g, i + ((long) j * g->gw)))
+                continue;
+            // Interior cells are never in the bitset.  They are full
+            // if a piece has been placed at their position.
+            if ((i % step != 0) && (j % step != 0) &&
+                (g->at[(i / step) + ((j / step) * g->width)] != -1))
+                continue;
+            *hi = i;
+            *hj = j;
+            return(1);
+        }
+    }
+    return(0);
+}
+
+
+/**************************************************************
+ * jg_strips(): - Get the top, right, bottom, and left edge strips
+ * of a piece after rotation.  Strips are indexed by JG_TOP,
+ * JG_RIGHT, JG_BOTTOM, and JG_LEFT.
+ *
+ * Input:        .pbm mask, rotation (0-3), edge, array of 4 strips
+ * Output:       the strips are filled in
+ **************************************************************/
+void jg_strips(uint64_t mask, int rot, int edge, unsigned *strips)
+{
+    uint64_t bits;          // piece bits after rotation
+    uint64_t cols;          // the same, with columns as rows
+    unsigned emask;         // mask of the bits in a strip
+    int   last;             // shift to the last row
+
+    emask = (1 << edge) - 1;
+    last = (edge - 1) * JG_STRIDE;
+    bits = jp_rotate(mask, rot, edge);
+    cols = jp_transpose(bits);
+    strips[JG_TOP]    = bits & emask;
+    strips[JG_RIGHT]  = (cols >> last) & emask;
+    strips[JG_BOTTOM] = (bits >> last) & emask;
+    strips[JG_LEFT]   = cols & emask;
+}
+
+
+/**************************************************************
+ * jg_inner(): - Return the mask of the interior cells of a piece,
+ * those not on the first or last row or column.
+ *
+ **************************************************************/
+uint64_t jg_inner(int edge)
+{
+    uint64_t inner = 0;     // mask being built
+    int   ik,jk;            // Increment over edge in i/j dimension
+
+    for (jk = 1; jk < edge - 1; jk++) {
+        for (ik = 1; ik < edge - 1; ik++) {
+            inner |= (uint64_t) 1 << ((jk * JG_STRIDE) + ik);
+        }
+    }
+    return(inner);
+}
+
+
+/**************************************************************
+ * getbit(): - Return the bit for grid location x
+ *
+ **************************************************************/
+static int getbit(const JGRID *g, long x)
+{
+    return((g->bits[x / 64] >> (x % 64)) & 1);
+}
+
+
+/**************************************************************
+ * covers(): - Return the position of the placed piece, other
+ * than skip, that has claimed grid cell (gx,gy).  A cell on a
+ * seam can be covered by up to four pieces.
+ *
+ **************************************************************/
+static int covers(const JGRID *g, int gx, int gy, int skip)
+{
+    int   step;             // distance between seams
+    int   pi, pj;           // puzzle position being checked
+    int   di, dj;           // 0 or 1, step back to the left/up neighbour
+    int   ik, jk;           // location of the cell within the piece
+    const JGPLACE *p;       // placement at the position
+
+    step = g->edge - 1;
+    for (dj = 0; dj < 2; dj++) {
+        for (di = 0; di < 2; di++) {
+            pi = (gx / step) - di;
+            pj = (gy / step) - dj;
+            if ((pi < 0) || (pj < 0) || (pi >= g->width) || (pj >= g->height))
+                continue;
+            ik = gx - (pi * step);
+            jk = gy - (pj * step);
+            if ((ik >= g->edge) || (jk >= g->edge))
+                continue;
+            if (((pi + (pj * g->width)) == skip) ||
+                (g->at[pi + (pj * g->width)] == -1))
+                continue;
+            p = &g->stack[g->at[pi + (pj * g->width)]];
+            if ((p->mask >> (ik + (jk * JG_STRIDE))) & 1)
+                return(p->pos);
+        }
+    }
+    return(-1);
+}
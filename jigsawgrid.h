@@ -0,0 +1,113 @@
+/* Name:        jigsawgrid.h
+ *
+ * Description: Incremental placement oracle for jigsaw puzzles.  Pieces
+ *              are placed on and removed from a bitset grid using the
+ *              same geometry as makejigsaw and validatejigsaw.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ */
+
+/*
+ * OVERVIEW
+ * A solver spends most of its time asking "does this piece fit here?" and
+ * undoing the answer when a search path dead-ends.  The routines here give
+ * it the validator's own notion of fit:
+ *     jg_place()       - claim the cells of a piece at a position/rotation
+ *     jg_unplace()     - undo the most recent jg_place()
+ *     jg_is_complete() - true when every grid cell is claimed exactly once
+ *
+ * The interior (edge-2)x(edge-2) cells of a piece can never be shared
+ * with a neighbour, so they are checked once with a mask and are not kept
+ * in the grid.  Only the 4*(edge-1) perimeter cells are tested and set,
+ * which makes each call O(perimeter).  A failed jg_place() leaves the grid
+ * unchanged.
+ *
+ * jg_strips() returns the four edge strips of a rotated piece for code
+ * that checks seams directly instead of keeping a grid.  Bit k of the top
+ * and bottom strips is column k, and bit k of the left and right strips
+ * is row k, so bit 0 and bit edge-1 of each strip are corner cells.
+ *
+ * Pieces are passed as a 64 bit mask of the .pbm file as read from disk,
+ * bit (row * 8) + column, before any rotation.  Rotations are counter-
+ * clockwise in units of 90 degrees, exactly as in solution.txt.
+ */
+
+#ifndef JIGSAWGRID_H
+#define JIGSAWGRID_H
+
+#include <stdint.h>
+#include "jigsawpiece.h"
+
+
+/**************************************************************
+ *  - Limits and defines
+ **************************************************************/
+        // Stride of a row in a piece mask, see jigsawpiece.h
+#define JG_STRIDE    JP_STRIDE
+        // Maximum number of perimeter cells on a piece
+#define JG_MAXPERIM  (4 * (JG_STRIDE - 1))
+        // Return values from jg_place()
+#define JG_OK        0      // piece placed
+#define JG_COLLIDE   (-1)   // a cell is already claimed by another piece
+#define JG_HOLE      (-2)   // an interior cell of the piece is empty
+#define JG_RANGE     (-3)   // bad position or rotation, or position in use
+        // Index of each edge strip returned by jg_strips()
+#define JG_TOP       JP_TOP
+#define JG_RIGHT     JP_RIGHT
+#define JG_BOTTOM    JP_BOTTOM
+#define JG_LEFT      JP_LEFT
+
+
+/**************************************************************
+ *  - Data structures
+ **************************************************************/
+typedef struct {
+    int       pos;          // puzzle position, i + (j * width)
+    int       rot;          // counterclockwise rotation, 0 to 3
+    uint64_t  mask;         // piece bits after rotation
+} JGPLACE;
+
+typedef struct {
+    int       width;        // Width of the puzzle in pieces
+    int       height;       // Height of the puzzle in pieces
+    int       edge;         // Resolution of a piece edge
+    int       gw;           // Grid width
+    int       gh;           // Grid height
+    uint64_t *bits;         // one bit per grid cell, set when claimed
+    JGPLACE  *stack;        // placements in the order they were made
+    int      *at;           // stack index of the piece at each position
+    int       nplaced;      // number of entries on the stack
+    long      nfilled;      // number of claimed grid cells
+    uint64_t  inner;        // mask of the interior cells of a piece
+    int       nperim;       // number of perimeter cells on a piece
+    int       poff[JG_MAXPERIM];      // grid offset of each perimeter cell
+    int       pbit[JG_MAXPERIM];      // piece bit for each perimeter cell
+    int       cx, cy;       // grid location of the last failure
+    int       owner;        // position that owns (cx,cy) on collision
+} JGRID;
+
+
+/**************************************************************
+ *  - Function prototypes
+ **************************************************************/
+int  jg_init(JGRID *, int, int, int);
+void jg_free(JGRID *);
+int  jg_place(JGRID *, uint64_t, int, int);
+int  jg_unplace(JGRID *);
+int  jg_is_complete(const JGRID *);
+int  jg_firsthole(const JGRID *, int *, int *);
+void jg_strips(uint64_t, int, int, unsigned *);
+uint64_t jg_inner(int);
+
+#endif /* JIGSAWGRID_H */
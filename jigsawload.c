@@ -0,0 +1,485 @@
+/* Name:        jigsawload.c
+ *
+ * Description: Read many small files, such as the .pbm files of a large
+ *              puzzle, with many reads in flight at once.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ * Build:       Link with the program that uses it, for example
+ *              gcc -O2 -o solvejigsaw solvejigsaw.c jigsawgrid.c \
+ *                  jigsawload.c jigsawnet.c jigsawpiece.c jigsawq.c \
+ *                  jigsawsol.c jigsawzip.c -lz -lpthread
+ *
+ */
+
+/*
+ * PROGRAM DESIGN
+ * io_uring is used through its system calls directly, so no library is
+ * needed.  io_uring_setup() makes a ring of submission entries and a ring
+ * of completion entries shared with the kernel through mmap().  Requests
+ * are added at the tail of the submission ring, handed to the kernel with
+ * one io_uring_enter() that also waits for at least one to complete, and
+ * the results are taken from the head of the completion ring.
+ *
+ * The files in flight each have a slot with a buffer.  A free slot gets
+ * the next file and an OPENAT request.  When the open completes a READ of
+ * the whole buffer is queued, hard linked to a CLOSE of the file so that
+ * the kernel closes it as soon as the read is done without another round
+ * trip.  Files are nearly always shorter than the buffer, and a plain
+ * link takes a short read as a failure and cancels the close, so the link
+ * must be a hard one, which runs the close however the read ends.  The
+ * slot is passed to the caller's function and freed once both have
+ * completed.  Should the close still be cancelled the file is closed here
+ * instead.  The number of the slot and the kind of request are kept in
+ * the user data of each request.  Each slot has at most two requests
+ * queued at once, so a submission ring of twice the number of slots never
+ * fills.
+ *
+ * Kernels before 5.6 have io_uring but not the OPENAT and CLOSE requests,
+ * though they have hard links, which came in 5.5.
+ * IORING_FEAT_CUR_PERSONALITY came in 5.6 too, so a ring without it is
+ * treated as no ring at all.  io_uring may also be turned off or
+ * blocked by a seccomp filter, as in many containers.  JL_AUTO then falls
+ * back to a pool of threads that claim files with an atomic counter, as
+ * jz_foreach() does, and that keep NTHREAD reads in flight.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "jigsawload.h"
+#include "jigsawpiece.h"
+
+
+/**************************************************************
+ *  - Limits and defines
+ **************************************************************/
+        // Files in flight at once through io_uring
+#define NSLOT        256
+        // Threads reading files when io_uring is not used
+#define NTHREAD      16
+        // Kind of request, in the low bits of its user data
+#define OP_OPEN      0
+#define OP_READ      1
+#define OP_CLOSE     2
+#define OP_BITS      2
+
+
+/**************************************************************
+ *  - Data structures
+ **************************************************************/
+typedef struct {
+    int       nfile;        // number of files
+    JLNAME    name;         // caller's function for each file name
+    JLFUNC    func;         // caller's function for each file
+    void     *arg;          // caller's argument
+    int       next;         // next file to read
+    int       ret;          // first error seen, or 0
+} JLWORK;
+
+typedef struct {
+    int       fd;           // the ring
+    unsigned *sqtail;       // tail of the submission ring
+    unsigned *sqmask;       // size of the submission ring - 1
+    unsigned *sqarray;      // index of the entry in each submission slot
+    struct io_uring_sqe *sqe;   // submission entries
+    unsigned *cqhead;       // head of the completion ring
+    unsigned *cqtail;       // tail of the completion ring, moved by the kernel
+    unsigned *cqmask;       // size of the completion ring - 1
+    struct io_uring_cqe *cqe;   // completion entries
+    void     *sqmap;        // mapping of the submission ring
+    size_t    sqlen;        // its length
+    void     *cqmap;        // mapping of the completion ring, may be sqmap
+    size_t    cqlen;        // its length
+    size_t    sqelen;       // length of the mapping of the entries
+    unsigned  nqueued;      // requests added but not yet submitted
+} RING;
+
+typedef struct {
+    int       n;            // file in the slot
+    int       fd;           // its file descriptor once open
+    int       pending;      // read and close requests still to complete
+    ssize_t   len;          // bytes read
+    char      name[JL_NAMELEN]; // file name, kept until the open completes
+    char      buf[JP_FILELEN];  // contents of the file
+} SLOT;
+
+
+/**************************************************************
+ *  - Globals, function prototypes, and forward references
+ **************************************************************/
+static int   uringload(JLWORK *);
+static int   ringopen(RING *, unsigned);
+static void  ringclose(RING *);
+static struct io_uring_sqe *ringsqe(RING *, int, int, uint64_t);
+static int   ringenter(RING *);
+static void *worker(void *);
+static void  seterr(JLWORK *, int);
+
+
+
+
+/**************************************************************
+ * jl_foreach(): - Read every file in a list and call func with
+ * the contents of each, in no particular order.
+ *
+ * Input:        number of files, JL_ way to read them, function
+ *               giving the name of each file, function to call
+ *               with each file, and their argument
+ * Output:       JL_OK on success, a JL_ error, or the first
+ *               non-zero value returned by func
+ **************************************************************/
+int jl_foreach(int nfile, int how, JLNAME name, JLFUNC func, void *arg)
+{
+    JLWORK    work;         // shared by all threads
+    pthread_t tid[NTHREAD]; // worker threads
+    int   nthreads;         // threads reading files
+    int   ret;              // return value
+    int   i;                // thread index
+
+    work.nfile = nfile;
+    work.name = name;
+    work.func = func;
+    work.arg = arg;
+    work.next = 0;
+    work.ret = 0;
+
+    if ((how == JL_AUTO) || (how == JL_URING)) {
+        ret = uringload(&work);
+        if ((ret != JL_NOURING) || (how == JL_URING))
+            return(ret);
+    }
+
+    nthreads = (how == JL_SERIAL) ? 1 : NTHREAD;
+    for (i = 1; i < nthreads; i++) {
+        if (pthread_create(&tid[i], 0, worker, &work) != 0)
+            break;
+    }
+    nthreads = i;
+    worker(&work);          // this thread does its share too
+    for (i = 1; i < nthreads; i++)
+        pthread_join(tid[i], 0);
+
+    return(work.ret);
+}
+
+
+/**************************************************************
+ * uringload(): - Read the files through io_uring with up to
+ * NSLOT files in flight.
+ *
+ * Input:        work description
+ * Output:       as for jl_foreach(), JL_NOURING if no ring can
+ *               be made
+ **************************************************************/
+static int uringload(JLWORK *w)
+{
+    RING  ring;             // the io_uring
+    SLOT *slot;             // files in flight
+    int  *freeslot;         // stack of free slots
+    int   nfree;            // number of free slots
+    int   nbusy;            // number of slots in use
+    struct io_uring_sqe *sqe;   // request being queued
+    struct io_uring_cqe *cqe;   // request completed
+    unsigned head;          // head of the completion ring
+    unsigned tail;          // tail of the completion ring
+    SLOT *s;                // slot of a request
+    int   op;               // kind of request
+    int   ret;              // return value
+    int   i;                // slot index
+
+    if (ringopen(&ring, 2 * NSLOT) != 0)
+        return(JL_NOURING);
+    slot = (SLOT *) malloc(sizeof(SLOT) * NSLOT);
+    freeslot = (int *) malloc(sizeof(int) * NSLOT);
+    if ((slot == 0) || (freeslot == 0)) {
+        free(slot);
+        free(freeslot);
+        ringclose(&ring);
+        return(JL_NOMEM);
+    }
+    for (i = 0; i < NSLOT; i++)
+        freeslot[i] = NSLOT - 1 - i;
+    nfree = NSLOT;
+    nbusy = 0;
+
+    for (;;) {
+        // Start the next files in the free slots, unless stopping
+        while ((nfree > 0) && (w->next < w->nfile) && (w->ret == 0)) {
+            i = freeslot[--nfree];
+            s = &slot[i];
+            s->n = w->next++;
+            w->name(w->arg, s->n, s->name, JL_NAMELEN);
+            sqe = ringsqe(&ring, IORING_OP_OPENAT, AT_FDCWD,
+                          (i << OP_BITS) | OP_OPEN);
+            sqe->addr = (uintptr_t) s->name;
+            sqe->open_flags = O_RDONLY;
+            nbusy++;
+        }
+        if (nbusy == 0)
+            break;
+
+        // Submit them and wait for at least one to complete
+        if (ringenter(&ring) != 0) {
+            seterr(w, JL_IOERR);
+            break;          // files in flight are left open
+        }
+
+        head = *ring.cqhead;
+        tail = __atomic_load_n(ring.cqtail, __ATOMIC_ACQUIRE);
+        for ( ; head != tail; head++) {
+            cqe = &ring.cqe[head & *ring.cqmask];
+            i = cqe->user_data >> OP_BITS;
+            op = cqe->user_data & ((1 << OP_BITS) - 1);
+            s = &slot[i];
+
+            if (op == OP_OPEN) {
+                if (cqe->res < 0) {
+                    if (w->ret == 0) {
+                        ret = w->func(w->arg, s->n, 0, -cqe->res);
+                        if (ret != 0)
+                            seterr(w, ret);
+                    }
+                    freeslot[nfree++] = i;
+                    nbusy--;
+                    continue;
+                }
+                // Read the file, then close it when the read is done
+                s->fd = cqe->res;
+                s->pending = 2;
+                sqe = ringsqe(&ring, IORING_OP_READ, s->fd,
+                              (i << OP_BITS) | OP_READ);
+                sqe->addr = (uintptr_t) s->buf;
+                sqe->len = JP_FILELEN;
+                sqe->flags = IOSQE_IO_HARDLINK;
+                ringsqe(&ring, IORING_OP_CLOSE, s->fd,
+                        (i << OP_BITS) | OP_CLOSE);
+                continue;
+            }
+
+            if (op == OP_READ)
+                s->len = (cqe->res < 0) ? 0 : cqe->res;
+            else if (cqe->res == -ECANCELED)
+                close(s->fd);   // the close never ran
+            if (--s->pending > 0)
+                continue;
+
+            if (w->ret == 0) {
+                ret = w->func(w->arg, s->n, s->buf, s->len);
+                if (ret != 0)
+                    seterr(w, ret);
+            }
+            freeslot[nfree++] = i;
+            nbusy--;
+        }
+        __atomic_store_n(ring.cqhead, head, __ATOMIC_RELEASE);
+    }
+
+    ringclose(&ring);
+    free(slot);
+    free(freeslot);
+    return(w->ret);
+}
+
+
+/**************************************************************
+ * ringopen(): - Make an io_uring and map its rings
+ *
+ * Input:        ring to fill in, number of submission entries
+ * Output:       0 on success, -1 if io_uring is not available
+ **************************************************************/
+static int ringopen(RING *r, unsigned entries)
+{
+    struct io_uring_params p;   // sizes and offsets from the kernel
+
+    memset(r, 0, sizeof(RING));
+    memset(&p, 0, sizeof(p));
+    r->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0)
+        return(-1);
+    if ((p.features & IORING_FEAT_CUR_PERSONALITY) == 0) {
+        close(r->fd);       // too old for OPENAT and CLOSE
+        return(-1);
+    }
+
+    r->sqlen = p.sq_off.array + (p.sq_entries * sizeof(unsigned));
+    r->cqlen = p.cq_off.cqes + (p.cq_entries * sizeof(struct io_uring_cqe));
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cqlen > r->sqlen)
+            r->sqlen = r->cqlen;
+        r->cqlen = r->sqlen;
+    }
+    r->sqmap = mmap(0, r->sqlen, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sqmap == MAP_FAILED) {
+        close(r->fd);
+        return(-1);
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        r->cqmap = r->sqmap;
+    else {
+        r->cqmap = mmap(0, r->cqlen, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cqmap == MAP_FAILED) {
+            munmap(r->sqmap, r->sqlen);
+            close(r->fd);
+            return(-1);
+        }
+    }
+    r->sqelen = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqe = mmap(0, r->sqelen, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqe == MAP_FAILED) {
+        if (r->cqmap != r->sqmap)
+            munmap(r->cqmap, r->cqlen);
+        munmap(r->sqmap, r->sqlen);
+        close(r->fd);
+        return(-1);
+    }
+
+    r->sqtail = (unsigned *) ((char *) r->sqmap + p.sq_off.tail);
+    r->sqmask = (unsigned *) ((char *) r->sqmap + p.sq_off.ring_mask);
+    r->sqarray = (unsigned *) ((char *) r->sqmap + p.sq_off.array);
+    r->cqhead = (unsigned *) ((char *) r->cqmap + p.cq_off.head);
+    r->cqtail = (unsigned *) ((char *) r->cqmap + p.cq_off.tail);
+    r->cqmask = (unsigned *) ((char *) r->cqmap + p.cq_off.ring_mask);
+    r->cqe = (struct io_uring_cqe *) ((char *) r->cqmap + p.cq_off.cqes);
+    return(0);
+}
+
+
+/**************************************************************
+ * ringclose(): - Unmap the rings and close an io_uring
+ *
+ **************************************************************/
+static void ringclose(RING *r)
+{
+    munmap(r->sqe, r->sqelen);
+    if (r->cqmap != r->sqmap)
+        munmap(r->cqmap, r->cqlen);
+    munmap(r->sqmap, r->sqlen);
+    close(r->fd);
+}
+
+
+/**************************************************************
+ * ringsqe(): - Add a request at the tail of the submission ring.
+ * The caller fills in any fields other than the kind of request,
+ * the file descriptor, and the user data.  The caller keeps no
+ * more requests queued than the ring holds.
+ *
+ * Input:        ring, IORING_OP_ request, file descriptor, user data
+ * Output:       the submission entry of the request
+ **************************************************************/
+static struct io_uring_sqe *ringsqe(RING *r, int opcode, int fd,
+                                    uint64_t data)
+{
+    struct io_uring_sqe *sqe;   // entry being filled in
+    unsigned tail;          // tail of the submission ring
+    unsigned idx;           // slot of the entry
+
+    tail = *r->sqtail;
+    idx = tail & *r->sqmask;
+    sqe = &r->sqe[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = data;
+    r->sqarray[idx] = idx;
+    __atomic_store_n(r->sqtail, tail + 1, __ATOMIC_RELEASE);
+    r->nqueued++;
+    return(sqe);
+}
+
+
+/**************************************************************
+ * ringenter(): - Submit the queued requests and wait for at
+ * least one request to complete.
+ *
+ * Input:        ring
+ * Output:       0 on success, -1 on error with errno set
+ **************************************************************/
+static int ringenter(RING *r)
+{
+    int   ret;              // requests submitted, or -1
+
+    for (;;) {
+        ret = syscall(__NR_io_uring_enter, r->fd, r->nqueued, 1,
+                      IORING_ENTER_GETEVENTS, 0, 0);
+        if (ret >= 0) {
+            r->nqueued -= ret;
+            return(0);
+        }
+        if ((errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY))
+            return(-1);
+    }
+}
+
+
+/**************************************************************
+ * worker(): - Thread body for jl_foreach() without io_uring.
+ * Claim files until none are left or an error is seen.
+ *
+ **************************************************************/
+static void *worker(void *varg)
+{
+    JLWORK *w = (JLWORK *) varg;   // shared work description
+    char  name[JL_NAMELEN]; // file name
+    char  buf[JP_FILELEN];  // contents of the file
+    ssize_t len;            // bytes read
+    int   fd;               // file descriptor
+    int   n;                // file being read
+    int   ret;              // return value
+
+    while (__atomic_load_n(&w->ret, __ATOMIC_RELAXED) == 0) {
+        n = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED);
+        if (n >= w->nfile)
+            break;
+        w->name(w->arg, n, name, JL_NAMELEN);
+        fd = open(name, O_RDONLY);
+        if (fd < 0)
+            ret = w->func(w->arg, n, 0, errno);
+        else {
+            len = read(fd, buf, JP_FILELEN);
+            close(fd);
+            ret = w->func(w->arg, n, buf, (len < 0) ? 0 : len);
+        }
+        if (ret != 0) {
+            seterr(w, ret);
+            break;
+        }
+    }
+    return(0);
+}
+
+
+/**************************************************************
+ * seterr(): - Record an error unless one is already recorded.
+ * All threads stop at their next file.
+ *
+ **************************************************************/
+static void seterr(JLWORK *w, int ret)
+{
+    int   none = 0;         // value expected if no error yet
+
+    __atomic_compare_exchange_n(&w->ret, &none, ret, 0,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,83 @@
+/* Name:        jigsawload.h
+ *
+ * Description: Read many small files, such as the .pbm files of a large
+ *              puzzle, with many reads in flight at once.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ */
+
+/*
+ * OVERVIEW
+ * Reading the pieces of a large puzzle one open(), read(), and close() at
+ * a time spends most of its time waiting on each system call in turn.
+ * jl_foreach() reads a list of files and calls a function with the
+ * contents of each one, the same way jz_foreach() does for a zip file:
+ *     jl_foreach()  - read every file in a list, calling a function with
+ *                     the contents of each one
+ *
+ * The caller gives a function that returns the name of file n, so the
+ * list need not be built in memory.  The way the files are read is one of
+ *     JL_URING      - open, read, and close requests are queued to the
+ *                     kernel in batches through io_uring, with up to a few
+ *                     hundred files in flight, from the calling thread
+ *     JL_THREADS    - a pool of threads each reading one file at a time
+ *     JL_SERIAL     - the calling thread reads one file at a time
+ *     JL_AUTO       - JL_URING if the kernel has it, otherwise JL_THREADS
+ *
+ * Files of up to JP_FILELEN bytes are read whole; a longer file is cut
+ * short.  A file that can not be opened is passed to the function with
+ * NULL data and the errno as the length, and one that can not be read is
+ * passed as an empty file.  With JL_THREADS the function is called from
+ * many threads at once, so it must be thread safe in all modes.
+ */
+
+#ifndef JIGSAWLOAD_H
+#define JIGSAWLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**************************************************************
+ *  - Limits and defines
+ **************************************************************/
+        // Ways jl_foreach() can read the files
+#define JL_AUTO      0
+#define JL_URING     1
+#define JL_THREADS   2
+#define JL_SERIAL    3
+        // Return values from jl_foreach()
+#define JL_OK        0      // every file was passed to the function
+#define JL_NOURING   (-1)   // JL_URING was asked for and is not available
+#define JL_NOMEM     (-2)   // malloc failure
+#define JL_IOERR     (-3)   // io_uring failed part way through
+        // Longest file name
+#define JL_NAMELEN   256
+
+
+/**************************************************************
+ *  - Data structures
+ **************************************************************/
+        // Called by jl_foreach() to put the name of file n in name
+typedef void (*JLNAME)(void *arg, int n, char *name, size_t len);
+        // Called by jl_foreach() for each file.  Return non-zero to stop.
+typedef int (*JLFUNC)(void *arg, int n, const char *data, size_t len);
+
+
+/**************************************************************
+ *  - Function prototypes
+ **************************************************************/
+int  jl_foreach(int, int, JLNAME, JLFUNC, void *);
+
+#endif /* JIGSAWLOAD_H */
@@ -0,0 +1,328 @@
+/* Name:        jigsawnet.c
+ *
+ * Description: Send framed messages between the nodes of a cluster
+ *              solving a jigsaw puzzle over TCP.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ * Build:       Link with the program that uses it, for example
+ *              gcc -O2 -o solvejigsaw solvejigsaw.c jigsawgrid.c \
+ *                  jigsawload.c jigsawnet.c jigsawpiece.c jigsawq.c \
+ *                  jigsawsol.c jigsawzip.c -lz -lpthread
+ *
+ */
+
+/*
+ * PROGRAM DESIGN
+ * TCP is a stream, so a read or write may move only part of a message.
+ * fullwrite() and fullread() loop until the whole buffer has gone or
+ * come, retrying on EINTR.  jn_send() writes the header and body with
+ * one writev() so that a small message goes out in one segment.
+ * jn_recv() reads the header, grows the caller's buffer if the body does
+ * not fit, and reads the body into it, so a receive loop does one malloc
+ * per size of message instead of one per message.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "jigsawnet.h"
+
+
+/**************************************************************
+ *  - Limits and defines
+ **************************************************************/
+        // Longest host name in host:port
+#define HOSTLEN      256
+        // Workers that may wait to be accepted
+#define BACKLOG      64
+
+
+/**************************************************************
+ *  - Globals, function prototypes, and forward references
+ **************************************************************/
+static int  fullwrite(int, const struct iovec *, int);
+static int  fullread(int, void *, size_t);
+static void nodelay(int);
+
+
+
+
+/**************************************************************
+ * jn_listen(): - Listen for workers on a TCP port on all
+ * addresses.  A port of 0 picks any free port.
+ *
+ * Input:        port, where to put the port used, or NULL
+ * Output:       the listening socket, or -1 on error with errno set
+ **************************************************************/
+int jn_listen(int port, int *bound)
+{
+    struct sockaddr_in addr;    // address to listen on
+    socklen_t alen;         // length of addr
+    int   fd;               // the socket
+    int   on = 1;           // for SO_REUSEADDR
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return(-1);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    alen = sizeof(addr);
+    if ((bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) ||
+        (listen(fd, BACKLOG) != 0) ||
+        (getsockname(fd, (struct sockaddr *) &addr, &alen) != 0)) {
+        close(fd);
+        return(-1);
+    }
+    if (bound)
+        *bound = ntohs(addr.sin_port);
+    return(fd);
+}
+
+
+/**************************************************************
+ * jn_accept(): - Wait for a worker to connect
+ *
+ * Input:        listening socket
+ * Output:       the worker's socket, or -1 on error with errno set
+ **************************************************************/
+int jn_accept(int lfd)
+{
+    int   fd;               // the worker's socket
+
+    do
+        fd = accept(lfd, 0, 0);
+    while ((fd < 0) && (errno == EINTR));
+    if (fd >= 0)
+        nodelay(fd);
+    return(fd);
+}
+
+
+/**************************************************************
+ * jn_connect(): - Connect to a coordinator
+ *
+ * Input:        host:port of the coordinator
+ * Output:       the socket, or -1 on error
+ **************************************************************/
+int jn_connect(const char *hostport)
+{
+    char  host[HOSTLEN];    // host part of hostport
+    const char *colon;      // the last ':' in hostport
+    struct addrinfo hints;  // wanted kind of address
+    struct addrinfo *res;   // addresses of the host
+    struct addrinfo *ai;    // address being tried
+    int   fd = -1;          // the socket
+
+    colon = strrchr(hostport, ':');
+    if ((colon == 0) || (colon == hostport) ||
+        (colon - hostport >= HOSTLEN)) {
+        errno = EINVAL;
+        return(-1);
+    }
+    memcpy(host, hostport, colon - hostport);
+    host[colon - hostport] = 0;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, colon + 1, &hints, &res) != 0) {
+        errno = EHOSTUNREACH;
+        return(-1);
+    }
+    for (ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd >= 0)
+        nodelay(fd);
+    return(fd);
+}
+
+
+/**************************************************************
+ * jn_peername(): - Get the numeric address of the other end of
+ * a socket, to tell other nodes where to find it.
+ *
+ * Input:        socket, buffer for the address, its length
+ * Output:       0 on success, -1 on error
+ **************************************************************/
+int jn_peername(int fd, char *host, size_t len)
+{
+    struct sockaddr_storage addr;   // address of the other end
+    socklen_t alen = sizeof(addr);  // length of addr
+
+    if ((getpeername(fd, (struct sockaddr *) &addr, &alen) != 0) ||
+        (getnameinfo((struct sockaddr *) &addr, alen, host, len, 0, 0,
+                     NI_NUMERICHOST) != 0))
+        return(-1);
+    return(0);
+}
+
+
+/**************************************************************
+ * jn_send(): - Send one message
+ *
+ * Input:        socket, message type, body, length of the body
+ * Output:       0 on success, -1 on error with errno set
+ **************************************************************/
+int jn_send(int fd, uint32_t type, const void *body, size_t len)
+{
+    unsigned char hdr[JN_HDRLEN];  // message header
+    struct iovec iov[2];    // header and body
+    int   i;                // byte of a header word
+
+    if (len > JN_MAXLEN) {
+        errno = EMSGSIZE;
+        return(-1);
+    }
+    for (i = 0; i < 4; i++) {
+        hdr[i] = (type >> (8 * i)) & 0xff;
+        hdr[4 + i] = ((uint32_t) len >> (8 * i)) & 0xff;
+    }
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = JN_HDRLEN;
+    iov[1].iov_base = (void *) body;
+    iov[1].iov_len = len;
+    return(fullwrite(fd, iov, (len > 0) ? 2 : 1));
+}
+
+
+/**************************************************************
+ * jn_recv(): - Receive one message.  The buffer is grown with
+ * realloc() if the body does not fit and may start out NULL.
+ *
+ * Input:        socket, where to put the message type, buffer
+ *               and its size
+ * Output:       length of the body, or -1 on error with errno
+ *               set, or with errno 0 if the socket was closed
+ **************************************************************/
+int jn_recv(int fd, uint32_t *type, char **buf, size_t *buflen)
+{
+    unsigned char hdr[JN_HDRLEN];  // message header
+    uint32_t len;           // length of the body
+    char *nbuf;             // grown buffer
+    int   i;                // byte of a header word
+
+    if (fullread(fd, hdr, JN_HDRLEN) != 0)
+        return(-1);
+    *type = 0;
+    len = 0;
+    for (i = 3; i >= 0; i--) {
+        *type = (*type << 8) | hdr[i];
+        len = (len << 8) | hdr[4 + i];
+    }
+    if (len > JN_MAXLEN) {
+        errno = EMSGSIZE;
+        return(-1);
+    }
+    if ((*buf == 0) || (*buflen < len)) {
+        nbuf = (char *) realloc(*buf, len + 1);
+        if (nbuf == 0)
+            return(-1);
+        *buf = nbuf;
+        *buflen = len + 1;
+    }
+    if (fullread(fd, *buf, len) != 0)
+        return(-1);
+    return((int) len);
+}
+
+
+/**************************************************************
+ * fullwrite(): - Write all of a list of buffers to a socket
+ *
+ * Input:        socket, buffers, number of buffers
+ * Output:       0 on success, -1 on error with errno set
+ **************************************************************/
+static int fullwrite(int fd, const struct iovec *iovin, int niov)
+{
+    struct iovec iov[2];    // what is left to write
+    ssize_t ret;            // bytes written
+    int   i = 0;            // first buffer with bytes left
+
+    memcpy(iov, iovin, sizeof(struct iovec) * niov);
+    while (i < niov) {
+        ret = writev(fd, &iov[i], niov - i);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return(-1);
+        }
+        while ((i < niov) && ((size_t) ret >= iov[i].iov_len))
+            ret -= iov[i++].iov_len;
+        if (i < niov) {
+            iov[i].iov_base = (char *) iov[i].iov_base + ret;
+            iov[i].iov_len -= ret;
+        }
+    }
+    return(0);
+}
+
+
+/**************************************************************
+ * fullread(): - Read exactly len bytes from a socket
+ *
+ * Input:        socket, buffer, length
+ * Output:       0 on success, -1 on error or early end of file
+ **************************************************************/
+static int fullread(int fd, void *buf, size_t len)
+{
+    ssize_t ret;            // bytes read
+
+    while (len > 0) {
+        ret = read(fd, buf, len);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return(-1);
+        }
+        if (ret == 0) {
+            errno = 0;      // the other end closed the socket
+            return(-1);
+        }
+        buf = (char *) buf + ret;
+        len -= ret;
+    }
+    return(0);
+}
+
+
+/**************************************************************
+ * nodelay(): - Turn off Nagle's algorithm on a socket
+ *
+ **************************************************************/
+static void nodelay(int fd)
+{
+    int   on = 1;           // for TCP_NODELAY
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
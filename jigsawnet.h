@@ -0,0 +1,68 @@
+/* Name:        jigsawnet.h
+ *
+ * Description: Send framed messages between the nodes of a cluster
+ *              solving a jigsaw puzzle over TCP.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ */
+
+/*
+ * OVERVIEW
+ * A coordinator listens on a TCP port and workers connect to it, and
+ * workers may listen for and connect to each other the same way.  After
+ * that both sides send and receive whole messages:
+ *     jn_listen()   - listen on a port, or on any free port
+ *     jn_accept()   - wait for a worker to connect
+ *     jn_connect()  - connect to a coordinator given as host:port
+ *     jn_peername() - get the address of the other end of a socket
+ *     jn_send()     - send a message
+ *     jn_recv()     - receive a message into a buffer that grows to fit
+ *
+ * A message is an 8 byte header, the message type and the length of the
+ * body as 32 bit words, followed by the body.  The header is little
+ * endian.  Bodies are arrays of integers in the byte order of the sender,
+ * so all of the nodes of a cluster must have the same byte order.
+ * Sockets have Nagle's algorithm turned off so that small messages are
+ * not held back waiting for more.
+ */
+
+#ifndef JIGSAWNET_H
+#define JIGSAWNET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**************************************************************
+ *  - Limits and defines
+ **************************************************************/
+        // Size of a message header in bytes
+#define JN_HDRLEN    8
+        // Largest message body jn_recv() accepts
+#define JN_MAXLEN    (1 << 30)
+        // Room for a numeric address from jn_peername()
+#define JN_ADDRLEN   64
+
+
+/**************************************************************
+ *  - Function prototypes
+ **************************************************************/
+int  jn_listen(int, int *);
+int  jn_accept(int);
+int  jn_connect(const char *);
+int  jn_peername(int, char *, size_t);
+int  jn_send(int, uint32_t, const void *, size_t);
+int  jn_recv(int, uint32_t *, char **, size_t *);
+
+#endif /* JIGSAWNET_H */
@@ -0,0 +1,313 @@
+/* Name:        jigsawpiece.c
+ *
+ * Description: Read jigsaw puzzle pieces from portable bitmap (.pbm)
+ *              files into 64 bit piece masks.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ * Build:       Link with the program that uses it, for example
+ *              gcc -o solvejigsaw solvejigsaw.c jigsawpiece.c ...
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include "jigsawpiece.h"
+
+
+/**************************************************************
+ *  - Globals, function prototypes, and forward references
+ **************************************************************/
+static inline uint64_t rotate(uint64_t, int, int);
+static inline uint64_t mirrorh(uint64_t, int);
+static inline uint64_t mirrorv(uint64_t, int);
+static inline uint64_t deltaswap(uint64_t, uint64_t, int);
+
+
+
+/**************************************************************
+ * jp_parsepbm(): - convert the text of a .pbm file to a mask, bit
+ * (row * 8) + column.  The first three lines are skipped.
+ *
+ * Input:        text of the file, its length, edge, mask pointer
+ * Output:       0 on success, -1 if the text is malformed
+ **************************************************************/
+int jp_parsepbm(const char *buf, size_t len, int edge, uint64_t *mask)
+{
+    int   ik,jk;            // Increment over edge in i/j dimension
+    size_t x = 0;           // location in buf
+    int   discard;          // discard lines at top of .pbm file
+
+    // skip the first 3 lines in .pbm file
+    discard = 3;
+    while (discard) {
+        if (x >= len)
+            return(-1);
+        if (buf[x++] == '\n')
+            discard--;
+    }
+
+    // Collect the '1' bits in the .pbm file
+    *mask = 0;
+    for (jk = 0; jk < edge; jk++) {
+        for (ik = 0; ik < edge; ik++) {
+            if (x >= len)
+                return(-1);
+            if (buf[x] == '1')
+                *mask |= (uint64_t) 1 << ((jk * JP_STRIDE) + ik);
+            else if (buf[x] != '0')
+                return(-1);     // expected a 1 or 0
+            x++;
+        }
+        // skip to the next line
+        if ((x >= len) || (buf[x] != '\n'))
+            return(-1);
+        x++;
+    }
+
+    return(0);
+}
+
+
+/**************************************************************
+ * jp_readpbm(): - read a .pbm file from disk into a mask
+ *
+ * Input:        file name, edge, mask pointer
+ * Output:       JP_OK, JP_NOFILE, or JP_FORMAT
+ **************************************************************/
+int jp_readpbm(const char *fname, int edge, uint64_t *mask)
+{
+    int   fd;               // file descriptor of the .pbm file
+    char  buf[JP_FILELEN];  // contents of the .pbm file
+    ssize_t len;            // length of the .pbm file
+
+    fd = open(fname, O_RDONLY);
+    if (fd < 0)
+        return(JP_NOFILE);
+    len = read(fd, buf, JP_FILELEN);
+    close(fd);
+    if ((len < 0) || (jp_parsepbm(buf, len, edge, mask) != 0))
+        return(JP_FORMAT);
+    return(JP_OK);
+}
+
+
+/**************************************************************
+ * jp_rotate(): - Rotate a piece counterclockwise by rot * 90
+ * degrees.  Bit (ik,jk) of the result is the bit that lands on
+ * cell (ik,jk) of the piece when it is placed at that rotation,
+ * using the same rotation formulas as makejigsaw and the
+ * validator.
+ *
+ * Input:        piece mask, rotation (0-3), edge
+ * Output:       the rotated mask
+ **************************************************************/
+uint64_t jp_rotate(uint64_t mask, int rot, int edge)
+{
+    // Give the compiler a constant edge in each case
+    switch (edge) {
+    case 2:  return(rotate(mask, rot, 2));
+    case 3:  return(rotate(mask, rot, 3));
+    case 4:  return(rotate(mask, rot, 4));
+    case 5:  return(rotate(mask, rot, 5));
+    case 6:  return(rotate(mask, rot, 6));
+    case 7:  return(rotate(mask, rot, 7));
+    default: return(rotate(mask, rot, 8));
+    }
+}
+
+
+/**************************************************************
+ * jp_transpose(): - Swap the rows and columns of an 8x8 mask.
+ * Bit (row * 8) + column moves to bit (column * 8) + row, so
+ * an edge x edge piece stays in the top left corner.
+ *
+ **************************************************************/
+uint64_t jp_transpose(uint64_t mask)
+{
+    mask = deltaswap(mask, 0x00AA00AA00AA00AAULL, 7);
+    mask = deltaswap(mask, 0x0000CCCC0000CCCCULL, 14);
+    mask = deltaswap(mask, 0x00000000F0F0F0F0ULL, 28);
+    return(mask);
+}
+
+
+/**************************************************************
+ * jp_edges(): - Get the edge signature of each side of a piece,
+ * indexed by JP_TOP, JP_RIGHT, JP_BOTTOM, and JP_LEFT.  Turning
+ * the piece brings each side to the top, where it reads
+ * clockwise from bit 0 of the mask.
+ *
+ * Input:        piece mask, edge, array of 4 signatures
+ * Output:       the signatures are filled in
+ **************************************************************/
+void jp_edges(uint64_t mask, int edge, unsigned *sig)
+{
+    unsigned emask;         // mask of the bits in a signature
+    int   side;             // side of the piece
+
+    emask = (1 << edge) - 1;
+    for (side = JP_TOP; side <= JP_LEFT; side++)
+        sig[side] = jp_rotate(mask, side, edge) & emask;
+}
+
+
+/**************************************************************
+ * jp_sigkey(): - Return the seam cells of a signature as a key
+ * from 0 to (1 << (edge - 2)) - 1.  A side on the puzzle border
+ * has the largest key, all seam cells set.
+ *
+ **************************************************************/
+unsigned jp_sigkey(unsigned sig, int edge)
+{
+    return((sig >> 1) & ((1 << (edge - 2)) - 1));
+}
+
+
+/**************************************************************
+ * jp_matekey(): - Return the key that the touching side of a
+ * neighbour must have to fit against a side with this signature.
+ *
+ **************************************************************/
+unsigned jp_matekey(unsigned sig, int edge)
+{
+    // Mirroring a one row mask reverses its first edge bits
+    return(jp_sigkey((unsigned) mirrorh(~sig & ((1 << edge) - 1), edge), edge));
+}
+
+
+/**************************************************************
+ * jp_flatsides(): - Find the straight sides of each of n pieces.
+ * Bit JP_TOP, JP_RIGHT, JP_BOTTOM, or JP_LEFT of flat[k] is set
+ * when that side of piece k, unrotated, has all its seam cells
+ * set.  The loop has no branches so the compiler can vectorize
+ * it.
+ *
+ * Input:        piece masks, number of pieces, edge, flags out
+ * Output:       flat[] is filled in
+ **************************************************************/
+void jp_flatsides(const uint64_t *mask, int n, int edge, unsigned char *flat)
+{
+    uint64_t top;           // seam cells of the top side
+    uint64_t bottom;        // seam cells of the bottom side
+    uint64_t left;          // seam cells of the left side
+    uint64_t right;         // seam cells of the right side
+    int   jk;               // row of the piece
+    int   k;                // piece index
+
+    top = ((uint64_t) 1 << (edge - 1)) - 2;
+    bottom = top << ((edge - 1) * JP_STRIDE);
+    left = 0;
+    for (jk = 1; jk < edge - 1; jk++)
+        left |= (uint64_t) 1 << (jk * JP_STRIDE);
+    right = left << (edge - 1);
+
+    for (k = 0; k < n; k++) {
+        flat[k] = (((mask[k] & top) == top) << JP_TOP) |
+                  (((mask[k] & right) == right) << JP_RIGHT) |
+                  (((mask[k] & bottom) == bottom) << JP_BOTTOM) |
+                  (((mask[k] & left) == left) << JP_LEFT);
+    }
+}
+
+
+/**************************************************************
+ * jp_canon(): - Return the smallest of the four rotations of a
+ * piece, which is the same for every piece of the same shape.
+ *
+ * Input:        piece mask, edge, where to put the rotation
+ * Output:       canonical mask, and jp_rotate(mask, *rot, edge)
+ *               gives it
+ **************************************************************/
+uint64_t jp_canon(uint64_t mask, int edge, int *rot)
+{
+    uint64_t canon = mask;  // smallest rotation so far
+    uint64_t turned;        // mask at rotation r
+    int   r;                // rotation
+
+    *rot = 0;
+    for (r = 1; r < 4; r++) {
+        turned = jp_rotate(mask, r, edge);
+        if (turned < canon) {
+            canon = turned;
+            *rot = r;
+        }
+    }
+    return(canon);
+}
+
+
+/**************************************************************
+ * rotate(): - Rotate a mask, see jp_rotate()
+ *
+ **************************************************************/
+static inline uint64_t rotate(uint64_t mask, int rot, int edge)
+{
+    if (rot == 0)
+        return(mask);                                      // 0
+    else if (rot == 1)
+        return(jp_transpose(mirrorh(mask, edge)));         // 90
+    else if (rot == 2)
+        return(mirrorv(mirrorh(mask, edge), edge));        // 180
+    else
+        return(mirrorh(jp_transpose(mask), edge));         // 270
+}
+
+
+/**************************************************************
+ * mirrorh(): - Mirror a piece left to right.  Reversing the
+ * bits of each byte moves column ik to 7 - ik, and the shift
+ * moves it on to edge - 1 - ik.  The columns past the edge are
+ * clear so nothing shifts in from the next row.
+ *
+ **************************************************************/
+static inline uint64_t mirrorh(uint64_t mask, int edge)
+{
+    mask = ((mask >> 1) & 0x5555555555555555ULL) |
+           ((mask & 0x5555555555555555ULL) << 1);
+    mask = ((mask >> 2) & 0x3333333333333333ULL) |
+           ((mask & 0x3333333333333333ULL) << 2);
+    mask = ((mask >> 4) & 0x0F0F0F0F0F0F0F0FULL) |
+           ((mask & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return(mask >> (JP_STRIDE - edge));
+}
+
+
+/**************************************************************
+ * mirrorv(): - Mirror a piece top to bottom.  A byte swap moves
+ * row jk to 7 - jk and the shift moves it on to edge - 1 - jk.
+ *
+ **************************************************************/
+static inline uint64_t mirrorv(uint64_t mask, int edge)
+{
+    return(__builtin_bswap64(mask) >> ((JP_STRIDE - edge) * JP_STRIDE));
+}
+
+
+/**************************************************************
+ * deltaswap(): - Swap the bits in m with the bits s places to
+ * their left.
+ *
+ **************************************************************/
+static inline uint64_t deltaswap(uint64_t x, uint64_t m, int s)
+{
+    uint64_t t;             // bits that differ
+
+    t = (x ^ (x >> s)) & m;
+    return(x ^ t ^ (t << s));
+}
@@ -0,0 +1,112 @@
+/* Name:        jigsawpiece.h
+ *
+ * Description: Read jigsaw puzzle pieces from portable bitmap (.pbm)
+ *              files into 64 bit piece masks.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ */
+
+/*
+ * OVERVIEW
+ * Since MAX_EDGE is 8 every piece fits in one 64 bit mask, bit
+ * (row * 8) + column, with all bits outside the edge x edge square clear.
+ * makejigsaw, the validator, the solver, and jigsawgrid.c all keep pieces
+ * in this form.  These routines read and rotate piece masks:
+ *     jp_parsepbm() - convert the text of a .pbm file already in memory
+ *     jp_readpbm()  - read a .pbm file from disk and convert it
+ *     jp_rotate()   - rotate a piece counterclockwise by 90, 180, or 270
+ *     jp_transpose()- swap the rows and columns of a piece
+ *     jp_edges()    - get the edge signatures of a piece
+ *     jp_sigkey()   - get the seam cells of a signature as a small key
+ *     jp_matekey()  - get the key a neighbour's signature must have
+ *     jp_flatsides()- find the straight sides of many pieces at once
+ *     jp_canon()    - get the same mask for a piece however it is turned
+ *
+ * Rotation works on the whole mask at once instead of moving one cell at
+ * a time.  With T a transpose, H a mirror left to right, and V a mirror
+ * top to bottom,
+ *     90  = T(H(mask))
+ *     180 = V(H(mask))
+ *     270 = H(T(mask))
+ * The transpose is three delta swaps, V is a byte swap, and H reverses
+ * the bits of each byte.  The mirrors work on all 8 rows or columns and
+ * are then shifted back into the edge x edge square, so jp_rotate() has a
+ * copy of the code for each edge size with the shifts as constants.
+ *
+ * An edge signature is the edge cells of one side of a piece read
+ * clockwise around the piece, so that it does not depend on how the
+ * piece is turned.  Bits 0 and edge-1 are the corner cells, where four
+ * pieces meet and makejigsaw gives the cell to one of them.  The bits
+ * between are seam cells shared with one neighbour.  Read clockwise, the
+ * touching sides of two neighbours run in opposite directions, so two
+ * sides fit when the seam cells of one are the complement of the other
+ * reversed.  jp_sigkey() packs the seam cells into edge-2 bits and
+ * jp_matekey() gives the key the touching side of a neighbour must have,
+ * so finding who fits next to a side is a lookup on one small integer.
+ * The corner cells are not part of the key as they depend on all four
+ * pieces at the corner.  A piece turned by rot has signature
+ * sig[(side + rot) % 4] on each side.
+ *
+ * The outer rows and columns of the puzzle are never seam cells, so a
+ * piece on the border has all the seam cells of one side set (two sides
+ * for a corner).  jp_flatsides() finds these sides straight from the
+ * masks with four compares per piece and no branches.  An interior piece
+ * can have a straight side by chance, so a piece with a straight side
+ * may go on the border but is not known to.
+ *
+ * A large puzzle has many pieces of the same shape turned different ways.
+ * jp_canon() returns the smallest of the four rotations of a mask, so two
+ * pieces have the same shape exactly when their canonical masks are equal,
+ * and the rotation that gives it.
+ */
+
+#ifndef JIGSAWPIECE_H
+#define JIGSAWPIECE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**************************************************************
+ *  - Limits and defines
+ **************************************************************/
+        // Stride of a row in a piece mask.  MAX_EDGE must not exceed this.
+#define JP_STRIDE    8
+        // Sides of a piece in clockwise order
+#define JP_TOP       0
+#define JP_RIGHT     1
+#define JP_BOTTOM    2
+#define JP_LEFT      3
+        // Largest .pbm file we expect, with room for a long comment
+#define JP_FILELEN   1024
+        // Return values from jp_readpbm()
+#define JP_OK        0      // piece read
+#define JP_NOFILE    (-1)   // could not open the file
+#define JP_FORMAT    (-2)   // file is not a .pbm of the right size
+
+
+/**************************************************************
+ *  - Function prototypes
+ **************************************************************/
+int  jp_parsepbm(const char *, size_t, int, uint64_t *);
+int  jp_readpbm(const char *, int, uint64_t *);
+uint64_t jp_rotate(uint64_t, int, int);
+uint64_t jp_transpose(uint64_t);
+void     jp_edges(uint64_t, int, unsigned *);
+unsigned jp_sigkey(unsigned, int);
+unsigned jp_matekey(unsigned, int);
+void     jp_flatsides(const uint64_t *, int, int, unsigned char *);
+uint64_t jp_canon(uint64_t, int, int *);
+
+#endif /* JIGSAWPIECE_H */
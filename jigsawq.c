@@ -0,0 +1,174 @@
+/* Name:        jigsawq.c
+ *
+ * Description: A bounded lock-free queue for passing work between the
+ *              threads of a pipeline.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ * Build:       Link with the program that uses it, for example
+ *              gcc -O2 -o solvejigsaw solvejigsaw.c jigsawgrid.c \
+ *                  jigsawload.c jigsawnet.c jigsawpiece.c jigsawq.c \
+ *                  jigsawsol.c jigsawzip.c -lz -lpthread
+ *
+ */
+
+/*
+ * PROGRAM DESIGN
+ * The queue is a ring of slots with a free running head and tail.  Slot
+ * i starts with sequence number i.  A thread adding a value reads the tail
+ * t and looks at slot t % size: if its sequence number is t the slot is
+ * free on this lap, and the thread claims it by moving the tail from t to
+ * t + 1 with a compare and swap.  It then writes the value and sets the
+ * sequence number to t + 1 to say the slot is full.  Taking a value works
+ * the same way from the head, looking for sequence number h + 1, and sets
+ * the sequence number to h + size to free the slot for the next lap.  A
+ * sequence number behind the one wanted means the queue is full (or
+ * empty), and one ahead means another thread got the slot first.
+ *
+ * The release store of the sequence number after writing the value and
+ * the acquire load before reading it make the value, and anything the
+ * value points to, visible to the thread that takes it.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include "jigsawq.h"
+
+
+
+/**************************************************************
+ * jq_init(): - Allocate a queue of at least size slots.  The
+ * size is rounded up to a power of two.
+ *
+ * Input:        queue, number of slots
+ * Output:       0 on success, -1 on malloc failure
+ **************************************************************/
+int jq_init(JQUEUE *q, int size)
+{
+    long  n;                // number of slots
+    long  i;                // slot index
+
+    for (n = 2; n < size; n *= 2)
+        ;
+    q->slot = (JQSLOT *) malloc(sizeof(JQSLOT) * n);
+    if (q->slot == 0)
+        return(-1);
+    for (i = 0; i < n; i++)
+        q->slot[i].seq = i;
+    q->mask = n - 1;
+    q->head = 0;
+    q->tail = 0;
+    return(0);
+}
+
+
+/**************************************************************
+ * jq_free(): - Free a queue.  No thread may be using it.
+ *
+ **************************************************************/
+void jq_free(JQUEUE *q)
+{
+    free(q->slot);
+    q->slot = 0;
+}
+
+
+/**************************************************************
+ * jq_push(): - Add a value to the tail of a queue
+ *
+ * Input:        queue, value
+ * Output:       0 on success, -1 if the queue is full
+ **************************************************************/
+int jq_push(JQUEUE *q, intptr_t val)
+{
+    JQSLOT *s;              // slot at the tail
+    long  t;                // tail
+    long  seq;              // sequence number of the slot
+
+    t = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    for (;;) {
+        s = &q->slot[t & q->mask];
+        seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if (seq == t) {
+            if (__atomic_compare_exchange_n(&q->tail, &t, t + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;      // t is reloaded on failure
+        }
+        else if (seq < t)
+            return(-1);     // the slot is still full from the last lap
+        else
+            t = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    }
+    s->val = val;
+    __atomic_store_n(&s->seq, t + 1, __ATOMIC_RELEASE);
+    return(0);
+}
+
+
+/**************************************************************
+ * jq_pop(): - Take the value at the head of a queue
+ *
+ * Input:        queue, where to put the value
+ * Output:       0 on success, -1 if the queue is empty
+ **************************************************************/
+int jq_pop(JQUEUE *q, intptr_t *val)
+{
+    JQSLOT *s;              // slot at the head
+    long  h;                // head
+    long  seq;              // sequence number of the slot
+
+    h = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    for (;;) {
+        s = &q->slot[h & q->mask];
+        seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if (seq == h + 1) {
+            if (__atomic_compare_exchange_n(&q->head, &h, h + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;      // h is reloaded on failure
+        }
+        else if (seq < h + 1)
+            return(-1);     // the slot has not been filled yet
+        else
+            h = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    }
+    *val = s->val;
+    __atomic_store_n(&s->seq, h + q->mask + 1, __ATOMIC_RELEASE);
+    return(0);
+}
+
+
+/**************************************************************
+ * jq_put(): - Add a value to a queue, waiting for room
+ *
+ **************************************************************/
+void jq_put(JQUEUE *q, intptr_t val)
+{
+    while (jq_push(q, val) != 0)
+        sched_yield();
+}
+
+
+/**************************************************************
+ * jq_get(): - Take a value from a queue, waiting for one
+ *
+ **************************************************************/
+intptr_t jq_get(JQUEUE *q)
+{
+    intptr_t val;           // value taken
+
+    while (jq_pop(q, &val) != 0)
+        sched_yield();
+    return(val);
+}
@@ -0,0 +1,73 @@
+/* Name:        jigsawq.h
+ *
+ * Description: A bounded lock-free queue for passing work between the
+ *              threads of a pipeline.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ */
+
+/*
+ * OVERVIEW
+ * A queue holds up to a fixed power of two number of values, each a piece
+ * number or a pointer cast to intptr_t.  Any number of threads may put
+ * and get at the same time:
+ *     jq_init()     - allocate a queue
+ *     jq_free()     - free a queue
+ *     jq_push()     - add a value if there is room
+ *     jq_pop()      - take the oldest value if there is one
+ *     jq_put()      - add a value, waiting for room
+ *     jq_get()      - take the oldest value, waiting for one
+ *
+ * Each slot of the ring has a sequence number that tells a thread whether
+ * the slot is ready to be written or read on the current lap, so a thread
+ * only needs a compare and swap on the head or tail to claim a slot and
+ * never takes a lock.  jq_put() and jq_get() give up the CPU with
+ * sched_yield() while they wait, so a stage that is ahead lets the slower
+ * stages run.
+ */
+
+#ifndef JIGSAWQ_H
+#define JIGSAWQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**************************************************************
+ *  - Data structures
+ **************************************************************/
+typedef struct {
+    long      seq;          // lap on which the slot is next used
+    intptr_t  val;          // value held in the slot
+} JQSLOT;
+
+typedef struct {
+    JQSLOT   *slot;         // the ring of slots
+    long      mask;         // number of slots - 1
+    long      head;         // count of values taken
+    long      tail;         // count of values added
+} JQUEUE;
+
+
+/**************************************************************
+ *  - Function prototypes
+ **************************************************************/
+int  jq_init(JQUEUE *, int);
+void jq_free(JQUEUE *);
+int  jq_push(JQUEUE *, intptr_t);
+int  jq_pop(JQUEUE *, intptr_t *);
+void jq_put(JQUEUE *, intptr_t);
+intptr_t jq_get(JQUEUE *);
+
+#endif /* JIGSAWQ_H */
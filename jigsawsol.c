@@ -0,0 +1,444 @@
+/* Name:        jigsawsol.c
+ *
+ * Description: Read and write jigsaw puzzle solutions in the text format
+ *              of solution.txt and in a compact binary format.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ * Build:       Link with the program that uses it, for example
+ *              gcc -o convertjigsaw convertjigsaw.c jigsawsol.c
+ *
+ */
+
+/*
+ * PROGRAM DESIGN
+ * A binary solution is mapped read-only and its entries are used where
+ * they lie, so reading a 250,000 piece solution costs one mmap() call and
+ * a header check.  The format is little endian, which matches the x86 and
+ * ARM machines used on challenge night.
+ *
+ * A text solution is read whole into one buffer and split into lines by
+ * tokenize() in a single pass, instead of one fscanf() per line.  Names
+ * are nul terminated where they lie in the buffer, so there is no copy
+ * and no fixed size name buffer to overrun; names that are too long, and
+ * angles other than exactly 0, 90, 180, and 270, are errors.  Names of
+ * the form pNNNN.pbm also give the piece number for the binary form;
+ * other names get JS_NONUM.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "jigsawsol.h"
+
+
+/**************************************************************
+ *  - Limits and defines
+ **************************************************************/
+        // .pbm file name length
+#define PBMNAMELEN   40
+        // First read size for a text solution
+#define READCHUNK    (1 << 20)
+
+
+/**************************************************************
+ *  - Globals, function prototypes, and forward references
+ **************************************************************/
+static int      tokenize(JSOL *, char *, size_t);
+static void     put32(unsigned char *, uint32_t);
+static uint32_t get32(const unsigned char *);
+
+
+
+
+/**************************************************************
+ * js_readtxt(): - Read a text solution into memory.  On a syntax
+ * error s->line is the line number of the error.
+ *
+ * Input:        solution to fill in, path to the text file
+ * Output:       0 on success, -1 on error with errno set
+ **************************************************************/
+int js_readtxt(JSOL *s, const char *path)
+{
+    int   fd;               // file descriptor of the solution
+    char *text;             // whole text of the file
+    size_t len;             // bytes read so far
+    size_t size;            // size of the text buffer
+    ssize_t ret;            // read() return value
+    void *p;                // for realloc()
+
+    memset(s, 0, sizeof(JSOL));
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return(-1);
+
+    // Read the whole file with as few read() calls as possible
+    size = READCHUNK;
+    len = 0;
+    text = (char *) malloc(size + 1);
+    while (text) {
+        ret = read(fd, text + len, size - len);
+        if (ret < 0) {
+            close(fd);
+            free(text);
+            return(-1);
+        }
+        if (ret == 0)
+            break;
+        len += ret;
+        if (len == size) {
+            size *= 2;
+            p = realloc(text, size + 1);
+            if (p == 0)
+                free(text);
+            text = (char *) p;
+        }
+    }
+    close(fd);
+    if (text == 0) {
+        errno = ENOMEM;
+        return(-1);
+    }
+    text[len] = 0;
+    s->text = text;
+
+    if (tokenize(s, text, len) != 0) {
+        ret = errno;
+        len = s->line;
+        js_free(s);
+        s->line = len;
+        errno = ret;
+        return(-1);
+    }
+    return(0);
+}
+
+
+/**************************************************************
+ * tokenize(): - Split the text of a solution into names and
+ * angles in one pass.  Each line must be a name of less than
+ * PBMNAMELEN characters, blanks, and an angle of exactly 0, 90,
+ * 180, or 270.  Names are nul terminated in place.
+ *
+ * Input:        solution to fill in, text, length of text
+ * Output:       0 on success, -1 on error with errno set
+ **************************************************************/
+static int tokenize(JSOL *s, char *text, size_t len)
+{
+    char *p = text;         // current character
+    char *end = text + len; // end of the text
+    char *name;             // start of the name
+    uint32_t *ent = 0;      // entries being read
+    int   size = 0;         // allocated number of entries
+    int   angle;            // rotation in degrees
+    int   line = 0;         // line number
+    void *v;                // for realloc()
+
+    // A first guess at the number of lines saves most reallocs
+    size = (len / 16) + 16;
+    ent = (uint32_t *) malloc(sizeof(uint32_t) * size);
+    s->name = (char **) malloc(sizeof(char *) * size);
+    s->ent = ent;
+    s->mem = ent;
+    if ((ent == 0) || (s->name == 0)) {
+        errno = ENOMEM;
+        return(-1);
+    }
+
+    while (p < end) {
+        line++;
+        s->line = line;
+        // Blank lines are allowed
+        while ((p < end) && ((*p == ' ') || (*p == '\t') || (*p == '\r')))
+            p++;
+        if ((p == end) || (*p == '\n')) {
+            p++;
+            continue;
+        }
+
+        // The name runs to the next blank
+        name = p;
+        while ((p < end) && (*p > ' '))
+            p++;
+        if ((p - name >= PBMNAMELEN) || (p == end) ||
+            ((*p != ' ') && (*p != '\t'))) {
+            errno = EINVAL;
+            return(-1);
+        }
+        *p++ = 0;
+        while ((p < end) && ((*p == ' ') || (*p == '\t')))
+            p++;
+
+        // The angle must be 0, 90, 180, or 270 with no sign or padding
+        angle = -1;
+        if ((p < end) && (*p == '0')) {
+            angle = 0;
+            p++;
+        }
+        else if ((end - p >= 2) && (memcmp(p, "90", 2) == 0)) {
+            angle = 90;
+            p += 2;
+        }
+        else if ((end - p >= 3) && (memcmp(p, "180", 3) == 0)) {
+            angle = 180;
+            p += 3;
+        }
+        else if ((end - p >= 3) && (memcmp(p, "270", 3) == 0)) {
+            angle = 270;
+            p += 3;
+        }
+        while ((p < end) && ((*p == ' ') || (*p == '\t') || (*p == '\r')))
+            p++;
+        if ((angle < 0) || ((p < end) && (*p != '\n'))) {
+            errno = EINVAL;
+            return(-1);
+        }
+        p++;
+
+        if (s->n == size) {
+            size *= 2;
+            v = realloc(ent, sizeof(uint32_t) * size);
+            if (v == 0) {
+                errno = ENOMEM;
+                return(-1);
+            }
+            ent = (uint32_t *) v;
+            s->ent = ent;
+            s->mem = ent;
+            v = realloc(s->name, sizeof(char *) * size);
+            if (v == 0) {
+                errno = ENOMEM;
+                return(-1);
+            }
+            s->name = (char **) v;
+        }
+        s->name[s->n] = name;
+        ent[s->n] = JS_ENTRY(js_number(name), angle / 90);
+        s->n++;
+    }
+    s->line = 0;
+    return(0);
+}
+
+
+/**************************************************************
+ * js_writetxt(): - Write a solution in the text format.  Piece
+ * names are pNNNN.pbm.
+ *
+ * Input:        path, entries, number of entries
+ * Output:       0 on success, -1 on error with errno set
+ **************************************************************/
+int js_writetxt(const char *path, const uint32_t *ent, int n)
+{
+    FILE *fs;               // File pointer to solution file
+    char  fname[PBMNAMELEN]; // .pbm file name
+    int   i;                // entry index
+
+    fs = fopen(path, "w");
+    if (fs == 0)
+        return(-1);
+    for (i = 0; i < n; i++) {
+        js_name(ent[i], fname, PBMNAMELEN);
+        fprintf(fs, "%s %d\n", fname, JS_ROT(ent[i]) * 90);
+    }
+    if (fclose(fs) != 0)
+        return(-1);
+    return(0);
+}
+
+
+/**************************************************************
+ * js_mapbin(): - Map a binary solution into memory.  The entries
+ * are used in place.
+ *
+ * Input:        solution to fill in, path to the binary file
+ * Output:       0 on success, -1 on error with errno set
+ **************************************************************/
+int js_mapbin(JSOL *s, const char *path)
+{
+    int   fd;               // file descriptor of the solution
+    struct stat st;         // to get the size of the file
+    const unsigned char *p; // the mapped file
+
+    memset(s, 0, sizeof(JSOL));
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return(-1);
+    if ((fstat(fd, &st) != 0) || (st.st_size < JS_HDRLEN)) {
+        close(fd);
+        errno = EINVAL;
+        return(-1);
+    }
+    p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return(-1);
+    s->mem = (void *) p;
+    s->memlen = st.st_size;
+
+    // Check the header, and that the length prefix matches the file
+    if ((memcmp(p, JS_MAGIC, 4) != 0) || (get32(p + 4) != JS_VERSION) ||
+        (get32(p + 20) != (st.st_size - JS_HDRLEN) / 4) ||
+        ((st.st_size - JS_HDRLEN) % 4 != 0)) {
+        js_free(s);
+        errno = EINVAL;
+        return(-1);
+    }
+    s->width = get32(p + 8);
+    s->height = get32(p + 12);
+    s->edge = get32(p + 16);
+    s->n = get32(p + 20);
+    s->ent = (const uint32_t *) (p + JS_HDRLEN);
+
+    return(0);
+}
+
+
+/**************************************************************
+ * js_writebin(): - Write a solution in the binary format.  All
+ * piece numbers must be known.
+ *
+ * Input:        path, width, height, edge, entries, count
+ * Output:       0 on success, -1 on error with errno set
+ **************************************************************/
+int js_writebin(const char *path, int width, int height, int edge,
+                const uint32_t *ent, int n)
+{
+    FILE *fs;               // File pointer to solution file
+    unsigned char hdr[JS_HDRLEN]; // binary header
+    unsigned char word[4];  // one entry, little endian
+    int   i;                // entry index
+
+    for (i = 0; i < n; i++) {
+        if (JS_PIECE(ent[i]) == JS_NONUM) {
+            errno = EINVAL;
+            return(-1);
+        }
+    }
+
+    fs = fopen(path, "w");
+    if (fs == 0)
+        return(-1);
+    memcpy(hdr, JS_MAGIC, 4);
+    put32(hdr + 4, JS_VERSION);
+    put32(hdr + 8, width);
+    put32(hdr + 12, height);
+    put32(hdr + 16, edge);
+    put32(hdr + 20, n);
+    fwrite(hdr, 1, JS_HDRLEN, fs);
+    for (i = 0; i < n; i++) {
+        put32(word, ent[i]);
+        fwrite(word, 1, 4, fs);
+    }
+    if (fclose(fs) != 0)
+        return(-1);
+    return(0);
+}
+
+
+/**************************************************************
+ * js_isbin(): - Return true if the file is a binary solution
+ *
+ **************************************************************/
+int js_isbin(const char *path)
+{
+    FILE *fs;               // File pointer to solution file
+    char  magic[4];         // first bytes of the file
+
+    fs = fopen(path, "r");
+    if (fs == 0)
+        return(0);
+    if (fread(magic, 1, 4, fs) != 4) {
+        fclose(fs);
+        return(0);
+    }
+    fclose(fs);
+    return(memcmp(magic, JS_MAGIC, 4) == 0);
+}
+
+
+/**************************************************************
+ * js_free(): - Release a solution read by js_readtxt() or
+ * js_mapbin()
+ *
+ **************************************************************/
+void js_free(JSOL *s)
+{
+    free(s->name);
+    free(s->text);
+    if (s->memlen)
+        munmap(s->mem, s->memlen);
+    else
+        free(s->mem);
+    memset(s, 0, sizeof(JSOL));
+}
+
+
+/**************************************************************
+ * js_name(): - Get the .pbm file name for an entry
+ *
+ **************************************************************/
+void js_name(uint32_t ent, char *fname, size_t len)
+{
+    snprintf(fname, len, "p%04u.pbm", (unsigned) JS_PIECE(ent));
+}
+
+
+/**************************************************************
+ * js_number(): - Get the piece number from a name of the form
+ * pNNNN.pbm, with or without leading directories.  Return
+ * JS_NONUM for any other name.
+ *
+ **************************************************************/
+uint32_t js_number(const char *fname)
+{
+    const char *p;          // pointer into the name
+    uint32_t num = 0;       // piece number
+
+    p = strrchr(fname, '/');
+    p = (p) ? p + 1 : fname;
+    if ((*p++ != 'p') || (*p < '0') || (*p > '9'))
+        return(JS_NONUM);
+    while ((*p >= '0') && (*p <= '9')) {
+        num = (num * 10) + (*p++ - '0');
+        if (num >= JS_NONUM)
+            return(JS_NONUM);
+    }
+    if (strcmp(p, ".pbm") != 0)
+        return(JS_NONUM);
+    return(num);
+}
+
+
+/**************************************************************
+ * put32(), get32(): - Write and read little endian words
+ *
+ **************************************************************/
+static void put32(unsigned char *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+    return(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24));
+}
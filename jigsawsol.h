@@ -0,0 +1,92 @@
+/* Name:        jigsawsol.h
+ *
+ * Description: Read and write jigsaw puzzle solutions in the text format
+ *              of solution.txt and in a compact binary format.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ */
+
+/*
+ * OVERVIEW
+ * A solution lists the pieces from the top left corner going left to right
+ * and top to bottom, with the counterclockwise rotation of each.  The text
+ * form in solution.txt has one "pNNNN.pbm <angle>" line per piece.  The
+ * binary form, usually solution.bin, is a 24 byte header followed by one
+ * 32 bit word per piece:
+ *     offset  0   "JSOL"
+ *     offset  4   format version, 1
+ *     offset  8   puzzle width
+ *     offset 12   puzzle height
+ *     offset 16   edge resolution
+ *     offset 20   number of pieces, N
+ *     offset 24   N words of (piece number << 2) | (angle / 90)
+ * All values are little endian 32 bit words so the file can be mapped
+ * into memory and used in place.  The piece number is the NNNN in the
+ * name of the piece's .pbm file.
+ */
+
+#ifndef JIGSAWSOL_H
+#define JIGSAWSOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**************************************************************
+ *  - Limits and defines
+ **************************************************************/
+        // First four bytes of a binary solution
+#define JS_MAGIC     "JSOL"
+        // Version of the binary format
+#define JS_VERSION   1
+        // Size of the binary header in bytes
+#define JS_HDRLEN    24
+        // Piece number used for names not of the form pNNNN.pbm
+#define JS_NONUM     0x3fffffff
+        // Build and take apart the 32 bit entries
+#define JS_ENTRY(piece, rot)  (((uint32_t) (piece) << 2) | ((rot) & 3))
+#define JS_PIECE(ent)         ((ent) >> 2)
+#define JS_ROT(ent)           ((ent) & 3)
+
+
+/**************************************************************
+ *  - Data structures
+ **************************************************************/
+typedef struct {
+    int       width;        // Width of the puzzle, 0 if not known
+    int       height;       // Height of the puzzle, 0 if not known
+    int       edge;         // Edge resolution, 0 if not known
+    int       n;            // number of pieces in the solution
+    const uint32_t *ent;    // (piece << 2) | rotation for each piece
+    char    **name;         // .pbm file names from a text solution
+    char     *text;         // text of a text solution, holds the names
+    int       line;         // line of a syntax error in a text solution
+    void     *mem;          // memory or mapping holding the above
+    size_t    memlen;       // length of a mapping, 0 if malloc()ed
+} JSOL;
+
+
+/**************************************************************
+ *  - Function prototypes
+ **************************************************************/
+int  js_readtxt(JSOL *, const char *);
+int  js_writetxt(const char *, const uint32_t *, int);
+int  js_mapbin(JSOL *, const char *);
+int  js_writebin(const char *, int, int, int, const uint32_t *, int);
+int  js_isbin(const char *);
+void js_free(JSOL *);
+void js_name(uint32_t, char *, size_t);
+uint32_t js_number(const char *);
+
+#endif /* JIGSAWSOL_H */
@@ -0,0 +1,518 @@
+/* Name:        jigsawzip.c
+ *
+ * Description: Read the pieces of a jigsaw puzzle directly from the
+ *              password protected zip file given out on challenge night.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ * Build:       Link with the program that uses it, for example
+ *              gcc -o validatejigsaw validatejigsaw.c jigsawgrid.c \
+ *                  jigsawzip.c -lz -lpthread
+ *
+ */
+
+/*
+ * PROGRAM DESIGN
+ * The archive is mapped read-only with mmap() and the central directory at
+ * the end of the file is parsed once by jz_open().  The central directory
+ * has the sizes and offsets of every entry so entries can be extracted in
+ * any order and by any number of threads without further coordination.
+ *
+ * The traditional PKWARE cipher keeps three 32 bit keys that are updated
+ * with each plaintext byte.  Each encrypted entry starts with 12 random
+ * bytes, the last of which must match the high byte of the entry's CRC
+ * (or of its time stamp if the entry uses a data descriptor).  This catches
+ * most wrong passwords early; the CRC of the inflated data catches the rest.
+ *
+ * jz_foreach() starts a thread per CPU.  Each thread claims the next entry
+ * with an atomic counter, extracts it into a private buffer, and passes
+ * the result to the caller's function.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "jigsawzip.h"
+
+
+/**************************************************************
+ *  - Limits and defines
+ **************************************************************/
+        // Signatures of the zip records we use
+#define SIG_LOCAL    0x04034b50
+#define SIG_CENTRAL  0x02014b50
+#define SIG_END      0x06054b50
+#define SIG_END64    0x06064b50
+#define SIG_LOC64    0x07064b50
+        // Sizes of the fixed part of the records
+#define LEN_LOCAL    30
+#define LEN_CENTRAL  46
+#define LEN_END      22
+#define LEN_LOC64    20
+#define LEN_END64    56
+        // Size of the encryption header on each encrypted entry
+#define LEN_CRYPT    12
+        // Most threads jz_foreach() will start
+#define MAX_THREADS  64
+
+
+/**************************************************************
+ *  - Data structures
+ **************************************************************/
+typedef struct {
+    const JZIP *z;          // the archive
+    const char *password;   // password, or NULL if not encrypted
+    JZFUNC    func;         // caller's function for each entry
+    void     *arg;          // caller's argument
+    int       next;         // next entry to extract
+    int       ret;          // first error seen, or 0
+} JZWORK;
+
+
+/**************************************************************
+ *  - Globals, function prototypes, and forward references
+ **************************************************************/
+static uint32_t crctab[256];
+static pthread_once_t crconce = PTHREAD_ONCE_INIT;
+static void     crcinit(void);
+static unsigned get16(const unsigned char *);
+static uint32_t get32(const unsigned char *);
+static uint64_t get64(const unsigned char *);
+static void     getzip64(JZENTRY *, const unsigned char *, int);
+static void    *worker(void *);
+static void     seterr(JZWORK *, int);
+
+
+
+
+/**************************************************************
+ * jz_open(): - Map a zip archive into memory and read the list
+ * of entries from its central directory.
+ *
+ * Input:        zip structure to fill in, path to the archive
+ * Output:       0 on success, -1 on error with errno set
+ **************************************************************/
+int jz_open(JZIP *z, const char *path)
+{
+    int   fd;               // file descriptor of the archive
+    struct stat st;         // to get the size of the archive
+    const unsigned char *p; // pointer into the archive
+    const unsigned char *end; // end of the archive
+    uint64_t cdoff;         // offset of the central directory
+    uint64_t nent;          // number of entries
+    uint64_t off64;         // offset of the zip64 end record
+    unsigned namelen;       // length of the entry name
+    unsigned extralen;      // length of the extra field
+    unsigned commlen;       // length of the comment
+    char    *slash;         // last '/' in the name
+    uint64_t i;             // entry index
+
+    pthread_once(&crconce, crcinit);
+    memset(z, 0, sizeof(JZIP));
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return(-1);
+    if ((fstat(fd, &st) != 0) || (st.st_size < LEN_END)) {
+        close(fd);
+        errno = EINVAL;
+        return(-1);
+    }
+    z->size = st.st_size;
+    z->map = mmap(0, z->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (z->map == MAP_FAILED) {
+        z->map = 0;
+        return(-1);
+    }
+    end = z->map + z->size;
+
+    // The end record is last, followed only by a comment of up to 64K
+    for (p = end - LEN_END; p >= z->map; p--) {
+        if ((get32(p) == SIG_END) && (p + LEN_END + get16(p + 20) == end))
+            break;
+    }
+    if (p < z->map)
+        goto badzip;
+    nent = get16(p + 10);
+    cdoff = get32(p + 16);
+
+    // Zip64 archives put the real counts in a second end record
+    if ((p - LEN_LOC64 >= z->map) && (get32(p - LEN_LOC64) == SIG_LOC64)) {
+        off64 = get64(p - LEN_LOC64 + 8);
+        if ((off64 + LEN_END64 > z->size) ||
+            (get32(z->map + off64) != SIG_END64))
+            goto badzip;
+        nent = get64(z->map + off64 + 32);
+        cdoff = get64(z->map + off64 + 48);
+    }
+    if ((cdoff > z->size) || (nent > z->size / LEN_CENTRAL))
+        goto badzip;
+
+    z->ent = (JZENTRY *) calloc(nent ? nent : 1, sizeof(JZENTRY));
+    if (z->ent == 0) {
+        jz_close(z);
+        errno = ENOMEM;
+        return(-1);
+    }
+
+    p = z->map + cdoff;
+    for (i = 0; i < nent; i++) {
+        if ((p + LEN_CENTRAL > end) || (get32(p) != SIG_CENTRAL))
+            goto badzip;
+        namelen = get16(p + 28);
+        extralen = get16(p + 30);
+        commlen = get16(p + 32);
+        if (p + LEN_CENTRAL + namelen + extralen + commlen > end)
+            goto badzip;
+        z->ent[i].flags = get16(p + 8);
+        z->ent[i].method = get16(p + 10);
+        z->ent[i].mtime = get16(p + 12);
+        z->ent[i].crc = get32(p + 16);
+        z->ent[i].csize = get32(p + 20);
+        z->ent[i].usize = get32(p + 24);
+        z->ent[i].offset = get32(p + 42);
+        getzip64(&z->ent[i], p + LEN_CENTRAL + namelen, extralen);
+        z->ent[i].name = (char *) malloc(namelen + 1);
+        if (z->ent[i].name == 0) {
+            z->nent = i;
+            jz_close(z);
+            errno = ENOMEM;
+            return(-1);
+        }
+        memcpy(z->ent[i].name, p + LEN_CENTRAL, namelen);
+        z->ent[i].name[namelen] = 0;
+        slash = strrchr(z->ent[i].name, '/');
+        z->ent[i].base = (slash) ? slash + 1 : z->ent[i].name;
+        z->nent = i + 1;
+        p += LEN_CENTRAL + namelen + extralen + commlen;
+    }
+    return(0);
+
+badzip:
+    jz_close(z);
+    errno = EINVAL;
+    return(-1);
+}
+
+
+/**************************************************************
+ * jz_close(): - Unmap the archive and free the entry list
+ *
+ **************************************************************/
+void jz_close(JZIP *z)
+{
+    int   i;                // entry index
+
+    for (i = 0; i < z->nent; i++)
+        free(z->ent[i].name);
+    free(z->ent);
+    if (z->map)
+        munmap((void *) z->map, z->size);
+    memset(z, 0, sizeof(JZIP));
+}
+
+
+/**************************************************************
+ * jz_extract(): - Decrypt and inflate one entry into a buffer.
+ * The buffer must hold at least ent[n].usize bytes.  Safe to
+ * call from many threads at once.
+ *
+ * Input:        archive, entry index, password or NULL, output
+ *               buffer and its size
+ * Output:       JZ_OK, JZ_BADPASS, JZ_FORMAT, or JZ_NOMEM
+ **************************************************************/
+int jz_extract(const JZIP *z, int n, const char *password, char *out,
+               size_t outlen)
+{
+    const JZENTRY *e;       // entry to extract
+    const unsigned char *p; // pointer to the local header
+    const unsigned char *data; // start of the entry data
+    unsigned char *plain;   // decrypted data
+    unsigned char  hdr[LEN_CRYPT]; // decrypted encryption header
+    uint32_t key0, key1, key2; // cipher keys
+    uint64_t clen;          // length of the compressed data
+    unsigned t;             // temporary for the cipher
+    unsigned char c;        // plaintext byte
+    z_stream zs;            // zlib inflate state
+    uint64_t i;             // byte index
+    int   ret;              // return value
+
+    e = &z->ent[n];
+    if (e->usize > outlen)
+        return(JZ_NOMEM);
+    if ((e->method != 0) && (e->method != 8))
+        return(JZ_FORMAT);      // AES entries use method 99
+
+    // Find the data past the local header, which has its own name/extra
+    p = z->map + e->offset;
+    if ((e->offset + LEN_LOCAL > z->size) || (get32(p) != SIG_LOCAL))
+        return(JZ_FORMAT);
+    data = p + LEN_LOCAL + get16(p + 26) + get16(p + 28);
+    if ((uint64_t) (data - z->map) + e->csize > z->size)
+        return(JZ_FORMAT);
+    clen = e->csize;
+
+    // Decrypt into a private buffer if needed
+    plain = (unsigned char *) data;
+    if (e->flags & 1) {
+        if ((password == 0) || (clen < LEN_CRYPT))
+            return(JZ_BADPASS);
+        if (e->flags & 0x40)
+            return(JZ_FORMAT);  // strong encryption
+        key0 = 0x12345678;
+        key1 = 0x23456789;
+        key2 = 0x34567890;
+#define UPDATEKEYS(b) { \
+            key0 = crctab[(key0 ^ (b)) & 0xff] ^ (key0 >> 8); \
+            key1 = ((key1 + (key0 & 0xff)) * 134775813) + 1; \
+            key2 = crctab[(key2 ^ (key1 >> 24)) & 0xff] ^ (key2 >> 8); \
+        }
+        for (i = 0; password[i]; i++)
+            UPDATEKEYS((unsigned char) password[i]);
+        for (i = 0; i < LEN_CRYPT; i++) {
+            t = (key2 | 2) & 0xffff;
+            c = data[i] ^ ((t * (t ^ 1)) >> 8);
+            UPDATEKEYS(c);
+            hdr[i] = c;
+        }
+        if (hdr[LEN_CRYPT - 1] != ((e->flags & 8) ? (e->mtime >> 8) & 0xff
+                                                  : e->crc >> 24))
+            return(JZ_BADPASS);
+        clen -= LEN_CRYPT;
+        plain = (unsigned char *) malloc(clen ? clen : 1);
+        if (plain == 0)
+            return(JZ_NOMEM);
+        for (i = 0; i < clen; i++) {
+            t = (key2 | 2) & 0xffff;
+            c = data[LEN_CRYPT + i] ^ ((t * (t ^ 1)) >> 8);
+            UPDATEKEYS(c);
+            plain[i] = c;
+        }
+#undef UPDATEKEYS
+    }
+
+    // Copy or inflate the plaintext
+    ret = JZ_OK;
+    if (e->method == 0) {
+        if (clen != e->usize)
+            ret = JZ_BADPASS;
+        else
+            memcpy(out, plain, clen);
+    }
+    else {
+        memset(&zs, 0, sizeof(zs));
+        if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+            ret = JZ_NOMEM;
+        }
+        else {
+            zs.next_in = plain;
+            zs.avail_in = clen;
+            zs.next_out = (unsigned char *) out;
+            zs.avail_out = e->usize;
+            if ((inflate(&zs, Z_FINISH) != Z_STREAM_END) ||
+                (zs.total_out != e->usize))
+                ret = JZ_BADPASS;
+            inflateEnd(&zs);
+        }
+    }
+    if (plain != data)
+        free(plain);
+
+    if ((ret == JZ_OK) && (crc32(0, (unsigned char *) out, e->usize) != e->crc))
+        ret = JZ_BADPASS;
+    return(ret);
+}
+
+
+/**************************************************************
+ * jz_foreach(): - Extract every entry using a pool of threads
+ * and call func with the contents of each.  func is called from
+ * many threads at once and in no particular order.
+ *
+ * Input:        archive, password or NULL, number of threads
+ *               (0 for one per CPU), function and its argument
+ * Output:       0 on success, the first JZ_ error, or the first
+ *               non-zero value returned by func
+ **************************************************************/
+int jz_foreach(const JZIP *z, const char *password, int nthreads,
+               JZFUNC func, void *arg)
+{
+    JZWORK    work;         // shared by all threads
+    pthread_t tid[MAX_THREADS]; // worker threads
+    int   i;                // thread index
+
+    if (nthreads <= 0)
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+    if (nthreads < 1)
+        nthreads = 1;
+
+    work.z = z;
+    work.password = password;
+    work.func = func;
+    work.arg = arg;
+    work.next = 0;
+    work.ret = 0;
+
+    for (i = 1; i < nthreads; i++) {
+        if (pthread_create(&tid[i], 0, worker, &work) != 0)
+            break;
+    }
+    nthreads = i;
+    worker(&work);          // this thread does its share too
+    for (i = 1; i < nthreads; i++)
+        pthread_join(tid[i], 0);
+
+    return(work.ret);
+}
+
+
+/**************************************************************
+ * worker(): - Thread body for jz_foreach().  Claim entries until
+ * none are left or an error is seen.
+ *
+ **************************************************************/
+static void *worker(void *varg)
+{
+    JZWORK *w = (JZWORK *) varg;   // shared work description
+    char  *buf = 0;         // extracted entry
+    size_t buflen = 0;      // size of buf
+    int    n;               // entry being extracted
+    int    ret;             // return value
+
+    while (__atomic_load_n(&w->ret, __ATOMIC_RELAXED) == 0) {
+        n = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED);
+        if (n >= w->z->nent)
+            break;
+        if (w->z->ent[n].usize + 1 > buflen) {
+            free(buf);
+            buflen = w->z->ent[n].usize + 1;
+            buf = (char *) malloc(buflen);
+            if (buf == 0) {
+                buflen = 0;
+                seterr(w, JZ_NOMEM);
+                break;
+            }
+        }
+        ret = jz_extract(w->z, n, w->password, buf, buflen);
+        if (ret == JZ_OK) {
+            buf[w->z->ent[n].usize] = 0;
+            ret = w->func(w->arg, n, buf, w->z->ent[n].usize);
+        }
+        if (ret != 0) {
+            seterr(w, ret);
+            break;
+        }
+    }
+    free(buf);
+    return(0);
+}
+
+
+/**************************************************************
+ * seterr(): - Record an error unless one is already recorded.
+ * All threads stop at their next entry.
+ *
+ **************************************************************/
+static void seterr(JZWORK *w, int ret)
+{
+    int   none = 0;         // value expected if no error yet
+
+    __atomic_compare_exchange_n(&w->ret, &none, ret, 0,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+
+/**************************************************************
+ * getzip64(): - Pick up 64 bit sizes and offset from the zip64
+ * extra field for fields that are 0xffffffff in the central
+ * directory.
+ *
+ **************************************************************/
+static void getzip64(JZENTRY *e, const unsigned char *x, int len)
+{
+    unsigned id, sz;        // extra field id and size
+    int   k;                // offset in the zip64 field
+
+    while (len >= 4) {
+        id = get16(x);
+        sz = get16(x + 2);
+        if ((int) sz + 4 > len)
+            return;
+        if (id == 0x0001) {
+            // Fields appear only if the 32 bit value is all ones
+            k = 4;
+            if ((e->usize == 0xffffffff) && (k + 8 <= (int) sz + 4)) {
+                e->usize = get64(x + k);
+                k += 8;
+            }
+            if ((e->csize == 0xffffffff) && (k + 8 <= (int) sz + 4)) {
+                e->csize = get64(x + k);
+                k += 8;
+            }
+            if ((e->offset == 0xffffffff) && (k + 8 <= (int) sz + 4))
+                e->offset = get64(x + k);
+            return;
+        }
+        x += sz + 4;
+        len -= sz + 4;
+    }
+}
+
+
+/**************************************************************
+ * crcinit(): - Build the CRC-32 table used by the cipher
+ *
+ **************************************************************/
+static void crcinit(void)
+{
+    uint32_t c;             // CRC being computed
+    int   n, k;             // table index and bit count
+
+    for (n = 0; n < 256; n++) {
+        c = n;
+        for (k = 0; k < 8; k++)
+            c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        crctab[n] = c;
+    }
+}
+
+
+/**************************************************************
+ * get16(), get32(), get64(): - Read little endian values
+ *
+ **************************************************************/
+static unsigned get16(const unsigned char *p)
+{
+    return(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+    return(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24));
+}
+
+static uint64_t get64(const unsigned char *p)
+{
+    return(get32(p) | ((uint64_t) get32(p + 4) << 32));
+}
@@ -0,0 +1,88 @@
+/* Name:        jigsawzip.h
+ *
+ * Description: Read the pieces of a jigsaw puzzle directly from the
+ *              password protected zip file given out on challenge night.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ */
+
+/*
+ * OVERVIEW
+ * Unzipping a large puzzle to disk creates one file per piece before any
+ * work can start.  These routines map the archive into memory and hand
+ * back the contents of each entry instead:
+ *     jz_open()     - map the archive and read its central directory
+ *     jz_extract()  - decrypt and inflate one entry into a buffer
+ *     jz_foreach()  - extract every entry on a pool of threads, calling
+ *                     a function with the contents of each one
+ *     jz_close()    - unmap the archive
+ *
+ * Entries may be stored or deflated, and may be encrypted with the
+ * traditional PKWARE cipher used by "zip -e".  AES encrypted entries are
+ * reported as errors.  Zip64 archives, needed for more than 65535 pieces,
+ * are supported.
+ */
+
+#ifndef JIGSAWZIP_H
+#define JIGSAWZIP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**************************************************************
+ *  - Limits and defines
+ **************************************************************/
+        // Return values from jz_extract()
+#define JZ_OK        0      // entry extracted
+#define JZ_BADPASS   (-1)   // wrong password, or entry is corrupt
+#define JZ_FORMAT    (-2)   // unsupported compression or encryption
+#define JZ_NOMEM     (-3)   // output buffer too small or malloc failure
+
+
+/**************************************************************
+ *  - Data structures
+ **************************************************************/
+typedef struct {
+    char     *name;         // file name, nul terminated
+    const char *base;       // file name without any directory
+    uint64_t  offset;       // offset of the local file header
+    uint64_t  csize;        // compressed size, including encryption header
+    uint64_t  usize;        // uncompressed size
+    uint32_t  crc;          // CRC-32 of the uncompressed data
+    int       method;       // 0 = stored, 8 = deflated
+    int       flags;        // general purpose flags
+    int       mtime;        // DOS modification time
+} JZENTRY;
+
+typedef struct {
+    const unsigned char *map;   // the archive, mapped into memory
+    size_t    size;         // size of the archive
+    JZENTRY  *ent;          // the entries in central directory order
+    int       nent;         // number of entries
+} JZIP;
+
+        // Called by jz_foreach() for each entry.  Return non-zero to stop.
+typedef int (*JZFUNC)(void *arg, int entry, const char *data, size_t len);
+
+
+/**************************************************************
+ *  - Function prototypes
+ **************************************************************/
+int  jz_open(JZIP *, const char *);
+void jz_close(JZIP *);
+int  jz_extract(const JZIP *, int, const char *, char *, size_t);
+int  jz_foreach(const JZIP *, const char *, int, JZFUNC, void *);
+
+#endif /* JIGSAWZIP_H */
@@ -16,7 +16,7 @@
  *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
  *              GNU General Public License for more details.
  *
- * Build:       gcc -o makejigsaw makejigsaw.c
+ * Build:       gcc -o makejigsaw makejigsaw.c jigsawpiece.c jigsawsol.c
  *
  */
 
@@ -103,7 +103,8 @@
  * files. Outputgrid() saves the pieces but gives random numbers and 
  * rotations to each pieces as it is saved.  The solution to the jigsaw
  * is saved to the "solution.txt" file.  As shown above, solutions have
- * the piece number and its clockwise rotation.  
+ * the piece number and its clockwise rotation.  The same solution is
+ * saved in the compact binary format of jigsawsol.h as "solution.bin".
  *
  * Consider four valid solutions to the 3x3 puzzle above:
  *     123  369  987  741
@@ -124,6 +125,8 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include "jigsawpiece.h"
+#include "jigsawsol.h"
 
 
 
@@ -344,12 +347,15 @@ void outputpbm(int *grid, int width, int height, int edge)
     int   ret;              // system call return value
     char  fname[PBMNAMELEN]; // .pbm file name
     int   randrot;          // random rotation 0=0, 1=90, 2=180, 3=270
+    uint32_t *sol;          // solution in binary form
+    uint64_t mask;          // bits of the piece, see jigsawpiece.h
 
 
     // Build a list of pieces, number them, then rearrange them.
     npiece = height * width;
     piece = (int *) malloc(sizeof(int) * npiece);
-    if (piece == 0) {
+    sol = (uint32_t *) malloc(sizeof(uint32_t) * npiece);
+    if ((piece == 0) || (sol == 0)) {
         printf("malloc failure\n");
         exit(1);
     }
@@ -391,26 +397,29 @@ void outputpbm(int *grid, int width, int height, int edge)
 
         // Save the correct piece and rotation to the solution file
         fprintf(fs, "%s %d\n", fname, randrot * 90);
+        sol[n] = JS_ENTRY(piece[n], randrot);
 
         // get to the target piece
         i = n % width;    // as piece number
-        j = n / height;
+        j = n / width;
         is = i * (edge -1);      // as grid index
         js = j * (edge -1);
 
-        // walk the perimeter of the piece to get the edges
+        // Collect the piece into a mask, then turn it the other way
+        // so that rotating the .pbm by randrot puts it back.
+        mask = 0;
         for (jk = 0; jk < edge; jk++) {
             for (ik = 0; ik < edge; ik++) {
-                // select bit to print based on rotation
-                if (randrot == 0)
-                    x = ik + is + ((jk + js) * gw);              // 0 rotation
-                else if (randrot == 1)
-                    x = jk + is + (((edge -1 -ik) + js) * gw);           // 90
-                else if (randrot == 2)
-                    x = edge -1 - ik + is + (((edge -1 -jk) + js) * gw); // 180
-                else
-                    x = edge -1 - jk + is + ((ik + js) * gw);            // 270
+                x = ik + is + ((jk + js) * gw);
                 if (grid[x] == n)
+                    mask |= (uint64_t) 1 << (ik + (jk * JP_STRIDE));
+            }
+        }
+        mask = jp_rotate(mask, (4 - randrot) % 4, edge);
+
+        for (jk = 0; jk < edge; jk++) {
+            for (ik = 0; ik < edge; ik++) {
+                if ((mask >> (ik + (jk * JP_STRIDE))) & 1)
                     fprintf(fp, "1");
                 else
                     fprintf(fp, "0");
@@ -421,6 +430,10 @@ void outputpbm(int *grid, int width, int height, int edge)
     }
     fclose(fs);
 
+    // Save the solution again in binary form
+    if (js_writebin("solution.bin", width, height, edge, sol, npiece) != 0)
+        exit(1);
+
 
     // Walk the array printing the piece number at each location
     // gw = (width * (edge - 1)) + 1;
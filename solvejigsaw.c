@@ -0,0 +1,5797 @@
+/* Name:        solvejigsaw.c
+ *
+ * Description: This program solves a jigsaw puzzle created by makejigsaw.
+ *              The input is the set of portable bitmap files (.pbm), one
+ *              per piece, and the output is a solution.txt file.
+ *
+ * Copyright:   Copyright (C) 2019 by Bob Smith (bsmith@linuxtoys.org)
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ * Build:       gcc -O2 -o solvejigsaw solvejigsaw.c jigsawgrid.c \
+ *                  jigsawload.c jigsawnet.c jigsawpiece.c jigsawq.c \
+ *                  jigsawsol.c jigsawzip.c -lz -lpthread
+ *
+ */
+
+/*
+ * INTRODUCTION
+ * This program is a reference solver for the puzzles made by makejigsaw.
+ * It reads the pieces p0000.pbm, p0001.pbm, ... from the current directory
+ * and writes a solution.txt that validatejigsaw accepts.  A typical flow
+ * might be as follows:
+ *     makejigsaw 100 100 7
+ *     rm solution.txt
+ *     solvejigsaw 100 100 7
+ *     validatejigsaw 100 100 7
+ *
+ * The time taken by each stage of the solver is printed as it finishes.
+ * The -t option gives the number of threads used to start the assembly,
+ * or to search for puzzles with a small edge, for example
+ * "solvejigsaw -t 4 100 100 7".  The default is one thread.
+ *
+ * On challenge night the pieces come in an encrypted zip file and the
+ * clock starts when the password is given out.  With -z the pieces are
+ * read from the zip file instead of the current directory, with the
+ * password from -p or asked for at the terminal, for example
+ *     solvejigsaw -z pieces.zip 500 500 7
+ * The archive is opened and its directory read before the password is
+ * asked for, and the time from the password to solution.txt written is
+ * printed at the end.
+ *
+ * With -o, for an edge over SEARCH_EDGE and no workers, the assembly runs
+ * while the pieces are still being read, so the layout is done soon after
+ * the last piece is in.  The number of pieces in place when the last one
+ * arrived is printed as "online".
+ *
+ * With -s the assembly is a portfolio of strategies, one on each of the
+ * threads given by -t, up to NSTRATEGY: the search starting from each of
+ * the four corners and filling by anti-diagonals, then by rows, then by
+ * columns.  The first to fill the puzzle wins and the others stop.  The
+ * winner and the pieces placed by all of them are printed.
+ *
+ * With -m two threads assemble the puzzle at once, one from the top
+ * left corner and one from the bottom right, each filling about half
+ * of the anti-diagonals and meeting in the middle.  The pieces in each
+ * half are printed as "meet", and the search goes on from the seam.
+ *
+ * With -n the load, and for an edge over SEARCH_EDGE the start of the
+ * assembly, is shared out between that many worker processes that talk
+ * to the solver over TCP.  By default the workers are started on
+ * this machine, so "solvejigsaw -n 8 500 500 7" tries out a cluster of
+ * eight nodes.  With -l the solver instead listens on the given port for
+ * workers started on other machines with -c, each in a directory that
+ * holds the pieces and able to reach the others on any port:
+ *     solvejigsaw -n 2 -l 5000 500 500 7     (on the coordinator)
+ *     solvejigsaw -c coordinator:5000        (on each of two workers)
+ * With -b the solver reads the pieces itself, from the files or with -z
+ * from the zip file, and sends each worker the masks of its shard, so
+ * the workers need no copy of the pieces.
+ *
+ *
+ * PROGRAM DESIGN
+ * The solver uses the same grid model as makejigsaw.  Neighbouring pieces
+ * share a seam of edge cells.  The cells along a seam, other than the two
+ * ends, belong to exactly one of the two pieces, so each side of a piece
+ * is reduced to the edge signature and key of jigsawpiece.h, and the key
+ * of the left side of a piece must be the mate of the key of the right
+ * side of the piece to its left.  The same holds for the top and bottom
+ * sides.  The cells at the ends of a seam are where four pieces meet and
+ * belong to exactly one of them.
+ *
+ * The solver grows the layout from the top left corner.  The open
+ * positions next to the placed pieces that have two known sides next to
+ * each other, from a placed neighbour or the border, form the front of
+ * the search, and each step fills the position in the front with the
+ * fewest candidates.  A forced position is filled at once and one with
+ * nothing left is found at once, where a fixed order would only reach it
+ * later.  The candidates for two known sides are found with a single
+ * lookup in an array of buckets indexed by the pair of keys, which holds
+ * every turn of every piece, so any two sides next to each other serve.
+ * Each candidate is checked against every known side and corner cell and
+ * placed with the jigsawgrid.c oracle, which catches any cell claimed
+ * twice.  A piece is only kept if every open position around it still
+ * has a candidate, and if the sides and corner cells of the unused pieces
+ * still balance what the open positions want.  The candidates that pass
+ * are tried first that leave the most candidates around them.
+ *
+ * When nothing fits the search does not simply back up one step, since
+ * the piece at fault is often many steps back, with steps elsewhere in
+ * the front taken since.  Each step keeps the earlier steps that its
+ * failures depend on, those that placed the pieces around the positions
+ * that ran out of candidates or used up the shapes they wanted, and the
+ * search jumps back to the last of them (conflict-directed backjumping),
+ * undoing the placements with jg_unplace().  It gives up with "No
+ * solution found" after GROW_TRIES pieces placed for each position.
+ *
+ * Filling by rows does badly on the top row, where a wrong piece only has
+ * its left side checked and is not found out until the row ends.  Growing
+ * by the fewest candidates checks the other sides of each piece as soon as
+ * a position next to it can be looked up.
+ *
+ * With more than one thread the assembly starts with a wavefront.  The
+ * search fills column 0 on its own first, backing up as it needs to, and
+ * then each thread takes the next free row and fills it from column 1
+ * rightwards, keeping two pieces behind the row above so that the top
+ * neighbour of every position is in place.  A piece is claimed with an
+ * atomic decrement of the count of its shape, so two rows never take the
+ * same piece.  A row that runs out of candidates backs up only over the
+ * pieces the row below has not yet read, and never into column 0; any
+ * deeper dead end stops the wavefront.  The longest run of the
+ * anti-diagonal order that the wavefront filled is replayed as the first
+ * steps of the single threaded search, which continues from there.  Most
+ * wrong pieces on the top row are only found out by the row below, so on
+ * the puzzles tried the wavefront seldom gets much past the first row.
+ *
+ * Pieces of the same shape, the same mask once turned, can be swapped
+ * without changing anything that the validator checks, so trying one of
+ * them at a position and then the next is wasted work.  The load stage
+ * hashes the canonical mask of each piece from jp_canon() to sort the
+ * pieces into shapes.  The buckets hold one piece of each shape, the
+ * assembly keeps a count of the pieces of each shape still to place, and
+ * the pieces of a shape are handed out in turn when the layout is done.
+ *
+ * There are five stages:
+ *     load     - read every .pbm file into a 64 bit mask, and find its
+ *                straight sides, edge signatures, and shape
+ *     classify - group the pieces by shape
+ *     index    - sort the entries into buckets
+ *     assemble - place the pieces
+ *     output   - write solution.txt
+ *
+ * The load stage is itself a pipeline, as most of its time goes to
+ * opening and reading files.  A read thread reads the files with
+ * jl_foreach(), which keeps hundreds of them in flight through io_uring
+ * or, without io_uring, on a pool of threads.  A parse thread turns the
+ * text into masks, a side thread finds the straight
+ * sides, signatures, and canonical mask, and the main thread hashes the
+ * shapes.  The stages are joined by the bounded lock-free queues of
+ * jigsawq.h, and the read buffers go back to the read stage on a queue of
+ * their own, so the memory used does not grow with the puzzle.  All the
+ * work on a piece is done by the time its file has been read, and the
+ * index is built as soon as the last one is in.
+ *
+ * With -z the read stage runs jz_foreach() instead, which decrypts and
+ * inflates the entries on a thread per CPU.  Each of these threads parses
+ * the text it has just inflated straight into the mask table and passes
+ * the piece to the side thread, so the parse thread has nothing to do and
+ * the signatures of each piece are found as soon as it is decoded.  The
+ * piece number comes from the entry's name, and a name seen twice or a
+ * piece with no entry is an error.
+ *
+ * With -o an assembler thread is started before the load.  The shape
+ * stage adds the entries of the first piece of each new shape to the end
+ * of linked buckets, one per pool and key pair, kept in blocks that never
+ * move, and counts each piece of each shape.  It is the only writer, so a
+ * slot is published with a release store of the link to it and the
+ * assembler follows the links with acquire loads, with no locks.  The
+ * assembler runs the search of assemble() over these buckets.  At the end
+ * of a bucket it waits on a condition variable for more pieces, which the
+ * shape stage signals only while the assembler is waiting, so it backs up
+ * only once every piece is in, and the look ahead only rejects a piece
+ * then.  Pieces arrive in no useful order, so most of the layout is
+ * placed in the last moments of the load, but by the time the shapes are
+ * classified it is done and there is no index to build.  A shape passed
+ * over while all its pieces so far were in use is not tried again, so the
+ * assembler can get stuck where assemble() would not; the solver then
+ * indexes the pieces and assembles them as usual.
+ *
+ * A union-find that joins pieces into clusters as they arrive was tried
+ * on paper first, but it needs pairs of sides that match only each other,
+ * and with 2^(edge - 2) keys on a side no side of a large puzzle is
+ * unique.  Growing one layout from the corner needs no such pairs.
+ *
+ * With -n the solver is the coordinator of a cluster and the load stage
+ * is done by the workers.  Each worker is given a shard, a range of piece
+ * numbers, and reads those pieces, finds their sides, signatures, and
+ * canonical masks, and sends back the pieces in one message.  The
+ * coordinator has a thread per worker that stores the pieces and passes
+ * them to the shape stage as they come in, so the shapes are hashed while
+ * the other workers are still sending.
+ *
+ * With -b the coordinator reads every piece into the mask table first,
+ * once, and sends each worker its shard of the table, 8 bytes a piece in
+ * piece order so the number of a piece is its place in the table.  This
+ * is some 2 MB for 250,000 pieces, and a worker takes it in far faster
+ * than it could open and parse the files of its shard, which need not be
+ * on the worker at all.  benchjigsaw table times the two.
+ *
+ * The index is built by a hash join between the workers, so no worker
+ * ever holds more than its own shard and its share of the entries.  Each
+ * worker listens on a port of its own and the coordinator sends every
+ * worker the list of them.  A worker lists its entries as (pool and key
+ * pair, entry) tuples, sorts them by owner, the worker a hash of the key
+ * pair picks, and sends each other worker its tuples in batches of
+ * JOIN_BATCH while a thread per link takes in the tuples sent to it.
+ * The owner then sorts what it got into buckets by key pair and sends the
+ * coordinator the buckets it owns.  Tuples are kept by the sender and a
+ * worker sends its own in piece order, so taking them shard by shard
+ * gives each bucket in piece order.  The index stage joins the buckets of
+ * each key pair worker by worker, only the owner's being non-empty, and
+ * keeps only the piece that stands for each shape, which gives the same
+ * index as a single node would build.
+ *
+ * So the coordinator does end up with every signature, mask, and shape
+ * and the whole index, unlike the workers.  Leaving each bucket on its
+ * owner and asking for it over the network was weighed and not done.
+ * The assembler looks up a bucket for every position it fills and every
+ * time it backs up, hundreds of thousands of lookups even on puzzles it
+ * fills without trouble, and at a round trip each that would cost far
+ * more than the load.  The coordinator needs the masks anyway to place
+ * and check the pieces and to write the solution, and the index is only
+ * a few MB for 250,000 pieces.  What the join spares the coordinator is
+ * reading the pieces and sorting the entries, which is the work that
+ * grows with the puzzle.
+ *
+ * With workers the assembly starts with tiles of TILE_SIZE by TILE_SIZE
+ * positions in place of the wavefront.  Each worker is sent the edge
+ * signatures and count of every shape, and after that only tiles and the
+ * entries along their top and left borders go out and the entries of the
+ * filled tiles come back, so the traffic for a tile is its perimeter one
+ * way and its area once the other.  A worker fills a tile with the search
+ * of assemble() on the tile alone.  A wrong piece on the right or bottom
+ * of a tile is not found out by the tile itself, so the worker also fills
+ * a halo of TILE_HALO columns past the right side, and rows past the
+ * bottom of the tiles on the left border, and sends back only the tile.
+ * The halo to the right needs the tile above right, so tile (tx, ty) is
+ * sent out in step tx + 2 * ty and the tiles of a step are filled at
+ * once.  The coordinator puts each tile in place as it comes back,
+ * checking that its entries have pieces of their shape left and fit each
+ * other.  If a tile is stuck or does not fit no more are sent.  The tiles
+ * are then stitched together hierarchically: pairs of clusters, to begin
+ * with single tiles, are merged side by side and then one above the
+ * other, round after round, until one cluster covers the puzzle.  A merge
+ * checks only the seam between its halves, that each entry there is in
+ * the bucket for its neighbours and fits its corners, so the work of a
+ * round is the perimeter of its clusters.  The single threaded search
+ * carries on from the tiles put in place, the same as after the
+ * wavefront, and replays only those that fit.
+ *
+ * Every worker is still sent the signatures of every shape, not only
+ * those of its own shard and the keys along its tiles.  A shard is a
+ * range of piece numbers, and the numbers are in no order, so only one
+ * piece in n of a tile is in any one worker's shard and a worker could
+ * fill next to nothing from its own.  The shapes go out once, 12 bytes
+ * each, before the first tile.
+ *
+ * The buckets are the match graph of the puzzle in compressed sparse row
+ * form: the bucket for a key pair lists, with their rotations, the
+ * entries that can go to the right of one piece and below another, in a
+ * few MB for 250,000 pieces.  The anti-diagonal order is a breadth first
+ * walk of the grid from the top left corner, and the positions on an
+ * anti-diagonal depend only on those before it.  Pairs of sides
+ * that match only each other are too rare to build the layout from, as
+ * a side has only 2^(edge - 2) keys, so the graph is kept by key pair
+ * and a candidate is forced only once both of its neighbours are placed.
+ *
+ * With -s each strategy is the search of assemble() on a view of the
+ * puzzle turned so that its corner is the top left, a PUZZLE copied from
+ * the solver's with its own width, height, and layout that points at the
+ * same buckets, so the index is built once and never changed.  The
+ * buckets hold every turn of every piece, so they serve any view.  A
+ * strategy fills by anti-diagonals, rows, or columns, all of which have
+ * the left and top neighbours of a position in place before it, with the
+ * look ahead turned to match.  A spiral does not: along the right side
+ * of the puzzle the left neighbour is not yet placed, and the buckets
+ * are by left and top key, so it is not one of the strategies.  The
+ * first strategy to fill the puzzle takes a flag with an atomic compare
+ * and exchange, and the others check it before each step and stop.  The
+ * winner's layout is turned back to the puzzle, turning each piece with
+ * it.  Which corner goes fastest differs a great deal from puzzle to
+ * puzzle, and filling by rows or columns is seldom faster than by
+ * anti-diagonals, so the strategies run in that order.
+ *
+ * With -m the two halves are strategies of -s run side by side, the
+ * one from the bottom right on a view turned half way round.  They take
+ * pieces from one count of each shape with an atomic decrement, so both
+ * never use the last piece of a shape.  Each half also fills MEET_HALO
+ * anti-diagonals past its end, checked only against its own counts, so
+ * its pieces next to the seam have a likely fit on the other side.  A
+ * half that gets stuck after losing a piece to the other waits for the
+ * other to finish and tries once more.  The halves are not checked
+ * against each other: assemble() replays them as it does the layout
+ * from the workers, checking that each piece is in the bucket of its
+ * position and fits, and searches on from where a piece does not.
+ *
+ * Puzzles with an edge of SEARCH_EDGE or less are solved by search()
+ * instead of assemble().  With so few edge cells many pieces are the same
+ * and almost any piece fits at first, so a wrong choice is found out only
+ * much later.  search() keeps a code for every entry, the corner cells and
+ * side keys packed into at most 12 bits, which for a small edge is the
+ * whole outline of the piece, and a count of the unused entries with each
+ * code.  Its depth first search
+ *     - fills next the position in the front of the placed region with
+ *       the fewest unused entries that fit, so forced moves come first
+ *       and a position with nothing left is seen at once
+ *     - tries each code that fits once, most plentiful first, since
+ *       pieces with the same code are interchangeable
+ *     - counts, for every key, the sides of unused pieces with the key
+ *       and the sides of open positions that want it, and backs up as
+ *       soon as a key is short (the pigeonhole rule)
+ *     - keeps its choices on an explicit stack of frames, so a deep
+ *       search needs no recursion, and undoes a placement by counting the
+ *       piece back into its codes
+ * The number of pieces placed and taken back is printed when it is done.
+ *
+ * With more than one thread search() shares out the tree by work
+ * stealing.  A task is the list of placements down to the root of a
+ * subtree.  Each thread keeps its own search state and a deque of tasks,
+ * searching the newest task of its own deque and, when that is empty,
+ * stealing the oldest task of another thread.  While some thread is idle,
+ * a busy thread splits off the last untried code of its shallowest frame
+ * as a new task, so the tasks that are stolen are the largest subtrees
+ * left.  The first thread to fill the puzzle stops the others.
+ *
+ * How hard a puzzle is for assemble() depends on the number of entries
+ * that fit two known sides by chance, about 4N / 4^(edge - 2) for N
+ * pieces, less about half for the corner cells.  When this is well under
+ * one, as for an edge of 8 up to about 2,000 pieces or an edge of 7 up to
+ * about 400, a wrong candidate is almost always found out at once and
+ * the time is close to O(N).  Near one, as for 10x10 with an edge of 5,
+ * 25x25 with 7, or 50x50 with 8, a wrong piece is as likely as not to
+ * have a chance fit next to it, and wrong regions of many pieces grow
+ * before they run out of candidates.  Such puzzles may give up with "No
+ * solution found" within GROW_TRIES pieces for each position rather than
+ * run on.  search() solves
+ * puzzles with an edge of 3 up to 500x500 in about a second, but an edge
+ * of 4 is much like an edge of 6 for assemble(), and some puzzles of a
+ * hundred or so pieces take seconds.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include "jigsawgrid.h"
+#include "jigsawload.h"
+#include "jigsawnet.h"
+#include "jigsawpiece.h"
+#include "jigsawq.h"
+#include "jigsawsol.h"
+#include "jigsawzip.h"
+
+
+
+/**************************************************************
+ *  - Limits and defines
+ **************************************************************/
+        // Maximum width and height of a puzzle
+#define MAX_WIDTH    500
+#define MAX_HEIGHT   500
+        // Maximum resolution of the fingers on a piece
+#define MAX_EDGE     8
+        // .pbm file name length
+#define PBMNAMELEN   40
+        // Most threads for the wavefront or search
+#define MAX_THREADS  64
+        // Largest edge solved with search() instead of assemble()
+#define SEARCH_EDGE  4
+        // Pieces search() places between looks for idle workers
+#define SPLIT_NODES  256
+        // Pieces for each position search() places before it starts
+        // again in a new order, doubled each time
+#define RESTART_TRIES 256
+        // Candidates counted at a position when choosing where to go
+        // next; more than this are all the same to the choice
+#define GROW_CAP     4
+        // Pieces assemble() places for each position before it gives up
+#define GROW_TRIES   500
+        // Length of the load queues
+#define QUEUELEN     1024
+        // Most worker processes with -n
+#define MAX_WORKERS  64
+        // Messages between the coordinator and the workers, and
+        // between the workers in the join
+#define MSG_PORT     1      // port a worker listens on for its peers
+#define MSG_JOB      2      // width, height, edge, first, count, id, workers
+#define MSG_PEERS    3      // host:port of each worker, one per line
+#define MSG_PIECES   4      // a WIREPIECE for each piece of the shard
+#define MSG_INDEX    5      // the buckets of the key pairs a worker owns
+#define MSG_HELLO    6      // id of the worker at the other end of a link
+#define MSG_TUPLES   7      // (pool << 16 | key pair, entry) for the owner
+#define MSG_DONE     8      // no more tuples on this link
+#define MSG_SHAPES   9      // a WIRESHAPE for each shape
+#define MSG_TILE     10     // a tile and the pieces on its top and left
+#define MSG_LAYOUT   11     // the entries of a tile, none if it is stuck
+#define MSG_TABLE    12     // the mask of each piece of a shard
+        // Width and height of the tiles the workers assemble
+#define TILE_SIZE    16
+        // Extra columns and rows a worker fills past a tile to check it
+#define TILE_HALO    4
+#define TILE_AREA    ((TILE_SIZE + TILE_HALO) * (TILE_SIZE + TILE_HALO))
+        // Pieces a worker places in a tile before it gives up on it
+#define TILE_TRIES   (1 << 20)
+        // Tuples in one MSG_TUPLES message
+#define JOIN_BATCH   8192
+        // Anti-diagonals each half of -m fills past the middle to check it
+#define MEET_HALO    4
+        // Strategies -s runs, a corner to start at and an order to fill in
+#define NSTRATEGY    12
+#define ORDER_DIAG   0      // anti-diagonals
+#define ORDER_ROWS   1      // rows from left to right
+#define ORDER_COLS   2      // columns from top to bottom
+        // Slots in a block of the buckets -o fills as the pieces arrive
+#define ONLINE_BLOCK 4096
+#define SLOT_ENT(on, x)   ((on)->block[(x) / ONLINE_BLOCK][2 * ((x) % ONLINE_BLOCK)])
+#define SLOT_NEXT(on, x)  ((on)->block[(x) / ONLINE_BLOCK][2 * ((x) % ONLINE_BLOCK) + 1])
+        // Worker that owns the buckets of a key pair
+#define OWNER(key, nworker)  ((int) ((((key) * 0x9E3779B1u) >> 16) % (nworker)))
+        // A piece at a rotation is kept as one entry, piece * 4 + rotation
+#define ENTRY(piece, rot)  (((piece) * 4) + (rot))
+#define EPIECE(e)          ((e) / 4)
+#define EROT(e)            ((e) % 4)
+        // Entry looked up in POOL_ALL by the keys of sides s and s + 1,
+        // turned back so those sides face the way they were wanted
+#define TURNBACK(e, s)     ENTRY(EPIECE(e), (EROT(e) + 3 - (s)) % 4)
+        // Edge signature of an entry on a side, see jigsawpiece.h
+#define SIDE(pz, e, side)  ((pz)->sig[EPIECE(e)][((side) + EROT(e)) % 4])
+        // Candidate pools.  Pools 0 to 3 hold the entries with a straight
+        // side on JP_TOP, JP_RIGHT, JP_BOTTOM, or JP_LEFT.
+#define POOL_ALL     4
+#define NPOOL        5
+        // Bits of a code in search(): the corners, then the keys of the
+        // top, right, bottom, and left sides
+#define CODE_TL      1
+#define CODE_TR      2
+#define CODE_BR      4
+#define CODE_BL      8
+#define CODE_CORNERS 15
+#define CODE_KEY(pz, side)  (4 + ((side) * (pz)->keybits))
+
+
+/**************************************************************
+ *  - Data structures
+ **************************************************************/
+typedef struct {
+    int       first;        // first piece of the shard
+    int       count;        // number of pieces in the shard
+    int      *start[NPOOL]; // first candidate for each key pair
+    int      *cand[NPOOL];  // entries of the pairs the worker owns
+} SHARD;
+
+typedef struct {
+    int       width;        // Width of the puzzle in pieces
+    int       height;       // Height of the puzzle in pieces
+    int       edge;         // Resolution of a piece edge
+    int       npiece;       // number of pieces
+    int       keybits;      // bits in the key of one side, edge - 2
+    unsigned  flat;         // key of a side on the border
+    uint64_t *mask;         // .pbm mask of each piece
+    unsigned char *flatside; // straight sides of each piece
+    int       nclass;       // number of shapes
+    int      *cls;          // shape of each piece
+    int      *crot;         // rotation of each piece to its canonical mask
+    int      *cfirst;       // first of each shape's pieces in cmember[]
+    int      *cmember;      // pieces grouped by shape
+    unsigned char (*sig)[4]; // edge signatures of each piece
+    int       nkey;         // number of left and top key pairs
+    int      *start[NPOOL]; // first candidate for each key pair
+    int      *cand[NPOOL];  // entries sorted by key pair
+    int      *place;        // entry placed at each position, or -1
+    int       nthread;      // threads for the wavefront or search
+    int       nworker;      // worker processes for the load, or 0
+    int       port;         // port to wait for workers on, 0 to start them
+    int       broadcast;    // set to read the pieces here and send them out
+    int       first;        // first piece of a worker's shard
+    SHARD    *shard;        // shard of each worker, with its buckets
+    int      *sock;         // socket to each worker
+    int       stream;       // set to assemble while the pieces arrive
+    int       portfolio;    // set to run several strategies at once
+    int       bycolumn;     // set if the positions are filled by columns
+    int       meet;         // set to assemble from two corners at once
+    struct online *online;  // buckets filled as the pieces arrive, or NULL
+} PUZZLE;
+
+typedef struct online {
+    int      *head[NPOOL];  // first slot of each key pair, -1 if none yet
+    int      *tail[NPOOL];  // last slot of each key pair, for the shape stage
+    int     **block;        // blocks of slots, an entry and the next slot
+    int       nslot;        // slots used
+    int      *count;        // pieces of each shape arrived so far
+    int       arrived;      // pieces arrived so far
+    int       waiting;      // set while the assembler waits for pieces
+    int       done;         // set when the last piece has arrived
+    int       placed;       // pieces the assembler has in place
+    int       atdone;       // pieces in place when the last one arrived
+    int       result;       // 0 if the assembler filled the puzzle
+    pthread_mutex_t lock;   // held to wait for or announce pieces
+    pthread_cond_t more;    // signalled when pieces arrive
+    pthread_t tid;          // the assembler thread
+} ONLINE;
+
+typedef struct {
+    uint64_t  mask;         // .pbm mask of the piece
+    uint64_t  canon;        // canonical mask of the piece
+    unsigned char sig[4];   // edge signatures
+    unsigned char flatside; // straight sides
+    unsigned char crot;     // rotation to the canonical mask
+    unsigned char pad[2];   // unused, sent as zero
+} WIREPIECE;
+
+typedef struct {
+    unsigned char sig[4];   // edge signatures of the piece standing for it
+    unsigned char flatside; // straight sides
+    unsigned char pad[3];   // unused, sent as zero
+    int       count;        // pieces of the shape
+} WIRESHAPE;
+
+typedef struct {
+    int       n;            // piece number
+    size_t    len;          // bytes read
+    char      text[JP_FILELEN]; // text of the .pbm file
+} PBMBUF;
+
+typedef struct {
+    PUZZLE   *pz;           // the puzzle being solved
+    PBMBUF   *buf;          // buffers for the text of the files
+    JQUEUE    freeq;        // buffers free for the read stage
+    JQUEUE    textq;        // buffers read, for the parse stage
+    JQUEUE    maskq;        // pieces parsed, for the side stage
+    JQUEUE    sigq;         // pieces with sides, for the shape stage
+    uint64_t *canon;        // canonical mask of each piece
+    JZIP     *zip;          // zip file with the pieces, or NULL
+    const char *password;   // password for the zip file
+    char     *seen;         // set for each piece found in the zip file
+    char     *peers;        // host:port of each worker, one per line
+    int       nrecv;        // workers still sending
+} INGEST;
+
+typedef struct {
+    INGEST   *ing;          // state shared by the stages
+    int       id;           // worker and shard number
+} SHARDRECV;
+
+typedef struct {
+    int       id;           // this worker
+    int       nworker;      // number of workers
+    int       lfd;          // socket the other workers connect to
+    int      *tuple[MAX_WORKERS];  // tuples for this worker from each one
+    int       ntuple[MAX_WORKERS]; // ints in tuple[]
+} JOIN;
+
+typedef struct {
+    JOIN     *jn;           // the join
+    int       fd;           // link from another worker
+} JOINRECV;
+
+typedef struct {
+    PUZZLE   *pz;           // the puzzle, or the view of it, being filled
+    int      *left;         // pieces of each shape not yet placed
+    int      *rank;         // rank of each position, ties go to the lowest
+    int       nrank;        // open positions ranked below this are filled
+    int       nopen;        // of those, the positions not yet filled
+    int       whole;        // set if every open position is to be filled
+    int      *order;        // position filled at each step
+    int      *pair;         // first of the two known sides looked up
+    int      *cursor;       // next candidate in list[] at each step
+    int      *lstart;       // first candidate in list[] of each step
+    int      *list;         // candidates of the steps, best first
+    long     *rate;         // rating and order of the candidates of the
+                            // step being listed
+    int       nlist;        // room in list[] and rate[]
+    int      *count;        // candidates at each position in front[],
+                            // up to GROW_CAP
+    int      *known;        // known sides of each position in front[]
+    int      *front;        // open positions with two known sides next
+                            // to each other, that the search may fill
+    int      *fslot;        // slot of each position in front[], or -1
+    int       nfront;       // number of positions in front[]
+    unsigned *matek;        // key that fits next to each key
+    int      *supply;       // sides of unused pieces with each key
+    int      *demand;       // sides of open positions that want each key
+    int       corners;      // corner cells of the unused pieces
+    int       unowned;      // vertices with no placed piece's corner cell
+    JGRID     grid;         // placement oracle
+    int       k;            // steps taken, one for each piece placed
+    int      *stepof;       // step that filled each position, or -1
+    int      *lastuse;      // last step to place a piece of each shape,
+                            // or -1
+    int      *prevuse;      // step before each step to place a piece of
+                            // the same shape, or -1
+    int     **blame;        // earlier steps the failures at each step
+                            // depend on
+    int      *nblame;       // number of steps in blame[] of each step
+    int      *ablame;       // room for steps in blame[] of each step
+    char     *global;       // set if the failures at a step may depend
+                            // on every step before it
+    int      *seen;         // stamp of the steps in blame[] of step k
+    int       stamp;        // current stamp in seen[]
+    int      *stop;         // set elsewhere to stop the search, or NULL
+    long      nodes;        // pieces placed
+    long      backtracks;   // pieces taken back
+} GROW;
+
+typedef struct {
+    PUZZLE   *pz;           // the puzzle being solved
+    int      *left;         // pieces of each shape not yet placed
+    int      *next;         // next candidate at each position
+    int      *progress;     // number of pieces placed in each row
+    int       first;        // first column the rows fill
+    int       nextrow;      // next row for a thread to claim
+    int       stop;         // set when a position has no candidate
+} WAVE;
+
+typedef struct {
+    PUZZLE   *pz;           // the puzzle being solved
+    int      *left;         // pieces of each shape not yet claimed
+    int      *next;         // next candidate at each position, or -1
+    int       mid;          // first anti-diagonal of the bottom right half
+    int       stop;         // set when the top left half is stuck
+    int       nstuck;       // halves that got stuck after losing a claim
+    int       done[2];      // set when each half has finished
+} MEET;
+
+typedef struct {
+    MEET     *mt;           // state shared by the halves
+    int       turns;        // quarter turns of the view, 0 or 2
+    int       diags;        // anti-diagonals of the view in the half
+    PUZZLE    view;         // the puzzle turned to start at the corner
+    int      *spare;        // pieces of each shape the half has not used
+    int      *order;        // position to fill at each step
+    int      *cursor;       // next candidate to try at each step
+    int       nown;         // steps in the half
+    int       nstep;        // steps in the half and its halo
+    int       lost;         // set if the other half got a piece first
+    int       placed;       // pieces of the half, 0 if it is stuck
+} HALF;
+
+typedef struct {
+    int       nrun;         // strategies being run
+    int       stop;         // set when a strategy has filled the puzzle
+    int       winner;       // that strategy, or -1
+} PORTFOLIO;
+
+typedef struct {
+    PORTFOLIO *pf;          // state shared by the strategies
+    int       id;           // strategy, the corner plus 4 times the order
+    PUZZLE    view;         // the puzzle turned to start at the corner
+    int       result;       // 0 if this strategy filled the puzzle
+    long      nodes;        // pieces placed
+} STRATEGY;
+
+typedef struct {
+    int       pos;          // position filled at this depth
+    int       cbase;        // first of its candidate codes in ccode[]
+    int       ncand;        // number of candidate codes
+    int       next;         // next candidate code to try
+} FRAME;
+
+typedef struct {
+    PUZZLE   *pz;           // the puzzle being solved
+    int       ncode;        // number of codes
+    int      *code;         // code of each entry
+    int      *list;         // unused entries grouped by code
+    int      *first;        // first slot in list[] of each code
+    int      *len;          // number of unused entries with each code
+    int      *fitoff;       // first count of each set of sides in fitc[]
+    int      *fitc;         // unused entries with each corner cells and
+                            // keys on each set of sides
+    int      *slot;         // slot in list[] of each entry
+    int      *pcode;        // code placed at each position, -1 if open
+    unsigned *matek;        // key that fits next to each key
+    int      *supply;       // sides of unused pieces with each key
+    int      *demand;       // sides of open positions that want each key
+    int      *front;        // open positions search() may fill next
+    int      *fslot;        // slot of each position in front[], or -1
+    int       nfront;       // number of positions in front[]
+    FRAME    *stack;        // undo stack, one frame per placed piece
+    int      *ccode;        // candidate codes of all the frames
+    int       nccode;       // size of ccode[]
+    int      *place;        // entry placed at each position, or -1
+    unsigned  seed;         // breaks ties between positions
+    long      nodes;        // pieces placed
+    long      backtracks;   // pieces taken back
+} SEARCH;
+
+typedef struct {
+    pthread_mutex_t lock;   // held to add or take a task
+    int     **task;         // ring of tasks
+    int       size;         // slots in task[]
+    int       head;         // slot of the oldest task
+    int       count;        // number of tasks held
+} DEQUE;
+
+typedef struct {
+    DEQUE     dq[MAX_THREADS]; // tasks of each worker
+    int       nthread;      // number of workers
+    int       pending;      // tasks queued or being searched
+    int       idle;         // workers looking for a task
+    int       stop;         // set when the puzzle is solved or the
+                            // limit is reached
+    int       winner;       // worker that solved it, or -1
+    int       spent;        // set when a worker reached its budget
+} STEAL;
+
+typedef struct {
+    STEAL    *st;           // state shared by the workers
+    int       id;           // index of the worker and its deque
+    long      budget;       // nodes at which the worker gives up
+    SEARCH    s;            // this worker's search state
+} WORKER;
+
+
+/**************************************************************
+ *  - Globals, function prototypes, and forward references
+ **************************************************************/
+void   loadpieces(PUZZLE *, JZIP *, const char *);
+void  *readstage(void *);
+void   readname(void *, int, char *, size_t);
+int    readpiece(void *, int, const char *, size_t);
+void   readzip(INGEST *);
+void   readtable(INGEST *);
+int    zippiece(void *, int, const char *, size_t);
+void  *parsestage(void *);
+void  *sidestage(void *);
+void   shapestage(INGEST *);
+void   startonline(PUZZLE *);
+void   onlineadd(PUZZLE *, int, int);
+void   onlinedone(PUZZLE *);
+void  *onlineworker(void *);
+int    onlinenext(ONLINE *, int, unsigned, int);
+int    onlinecandidate(PUZZLE *, int *, int);
+int    finishonline(PUZZLE *);
+void   startcluster(INGEST *, pthread_t *);
+void  *recvshard(void *);
+void   runshard(const char *);
+void   sendtuples(PUZZLE *, JOIN *, char *);
+void  *acceptpeers(void *);
+void  *recvtuples(void *);
+int   *ownedindex(PUZZLE *, JOIN *, int *);
+void   runtiles(int, PUZZLE *);
+int    filltile(PUZZLE *, int *, int, int, int, int);
+void   stopcluster(PUZZLE *);
+void   shardname(void *, int, char *, size_t);
+int    shardpiece(void *, int, const char *, size_t);
+void   mergeindex(PUZZLE *);
+int    poolentries(PUZZLE *, int, int *, int);
+int    pieceentries(PUZZLE *, int, int, int *);
+unsigned keypair(PUZZLE *, int);
+void   classifypieces(PUZZLE *);
+void   indexpieces(PUZZLE *);
+void   indexpool(PUZZLE *, int, int *, int);
+int    poolof(PUZZLE *, int);
+int    assemble(PUZZLE *);
+void   growinit(GROW *, PUZZLE *, int *, int *, int);
+void   growfree(GROW *);
+int    growrun(GROW *, long);
+int    growreplay(GROW *, int, int);
+int    growlist(GROW *, int, int);
+int    growrate(GROW *, int);
+int    ratecmp(const void *, const void *);
+int    growchoose(GROW *, int *);
+int    growcount(GROW *, int, int *);
+int    growwants(GROW *, int, int *, int *);
+int    growfits(GROW *, int, int *, int *);
+int    vertexwant(PUZZLE *, int, int, int);
+void   growput(GROW *, int, int);
+void   growtake(GROW *, int);
+void   growaround(GROW *, int);
+void   growfront(GROW *, int);
+int    growcheck(GROW *, int, int *);
+void   growblame(GROW *, int);
+void   growblamearound(GROW *, int);
+void   growblameshape(GROW *, int);
+void   growblameempty(GROW *, int);
+void   wavefront(PUZZLE *, int *, int *);
+void   tiles(PUZZLE *, int *, int *);
+void   sendtile(PUZZLE *, int, int, int);
+int    recvtile(PUZZLE *, int *, int *, int, int, int);
+int    seam(PUZZLE *, int *, int, int, int, int, int, int, int);
+int    tilefits(PUZZLE *, int *, int);
+void  *rowworker(void *);
+void   meet(PUZZLE *, int *, int *);
+void  *halfworker(void *);
+int    halfsearch(HALF *);
+int    portfolio(PUZZLE *);
+void  *strategyworker(void *);
+void   strategyorder(PUZZLE *, int, int *);
+void   unturn(PUZZLE *, PUZZLE *, int);
+int    placeone(WAVE *, int);
+void   fillorder(PUZZLE *, int *);
+int    lookahead(PUZZLE *, int *, int);
+int    hascandidate(PUZZLE *, int *, int);
+void   unfold(PUZZLE *);
+void   outputsolution(PUZZLE *);
+int    fits(PUZZLE *, int, int);
+unsigned wantkey(PUZZLE *, int);
+int    search(PUZZLE *);
+void  *searchworker(void *);
+int    dfs(WORKER *, int);
+void   split(WORKER *, int, int);
+void   pushtask(DEQUE *, int *);
+int   *poptask(DEQUE *, int);
+void   searchinit(SEARCH *, PUZZLE *);
+void   searchcopy(SEARCH *, SEARCH *);
+void   searchfree(SEARCH *);
+int    choose(SEARCH *, int *);
+int    candidates(SEARCH *, int, int);
+int    domain(SEARCH *, int, int *, int *);
+void   fixedbits(SEARCH *, int, int *, int *);
+int    fitcount(SEARCH *, int, int);
+void   fitadd(SEARCH *, int, int);
+int    cornerwant(SEARCH *, int, int, int);
+int    neighbour(PUZZLE *, int, int);
+int    known(SEARCH *, int);
+void   setfront(SEARCH *, int);
+void   sput(SEARCH *, int, int);
+void   stake(SEARCH *, int);
+int    pigeonhole(SEARCH *);
+double stagetime(const char *);
+
+
+
+
+/**************************************************************
+ * main(): - Collect the width, height, and finger size of the
+ *           puzzle, then run each stage of the solver.
+ *
+ * Input:        argc, argv
+ * Output:       0 if solved, 1 on error or if no solution found
+ **************************************************************/
+int main(int argc, char **argv)
+{
+    PUZZLE pz;              // the puzzle being solved
+    int   width;            // Width of the puzzle in pieces
+    int   height;           // Height of the puzzle in pieces
+    int   edge;             // Resolution of a piece edge
+    int   nthread = 1;      // threads for the wavefront or search
+    int   opt;              // command line option
+    int   badopt = 0;       // set on an unknown option
+    char *zipname = 0;      // zip file with the pieces, if any
+    char *password = 0;     // password for the zip file
+    JZIP  zip;              // the open zip file
+    int   nworker = 0;      // worker processes for the load
+    int   port = 0;         // port to wait for workers on
+    char *coord = 0;        // host:port of the coordinator, if a worker
+    int   broadcast = 0;    // set to send the workers the pieces
+    int   stream = 0;       // set to assemble while the pieces arrive
+    int   several = 0;      // set to run several strategies at once
+    int   bothends = 0;     // set to assemble from two corners at once
+
+
+    // Get the options, then the width, height, and edge resolution
+    while ((opt = getopt(argc, argv, "t:z:p:n:l:c:bosm")) != -1) {
+        if ((opt == 't') && (sscanf(optarg, "%d", &nthread) == 1) &&
+            (nthread >= 1) && (nthread <= MAX_THREADS))
+            continue;
+        else if ((opt == 'n') && (sscanf(optarg, "%d", &nworker) == 1) &&
+                 (nworker >= 1) && (nworker <= MAX_WORKERS))
+            continue;
+        else if ((opt == 'l') && (sscanf(optarg, "%d", &port) == 1) &&
+                 (port >= 1) && (port <= 65535))
+            continue;
+        else if (opt == 'c')
+            coord = optarg;
+        else if (opt == 'b')
+            broadcast = 1;
+        else if (opt == 'o')
+            stream = 1;
+        else if (opt == 's')
+            several = 1;
+        else if (opt == 'm')
+            bothends = 1;
+        else if (opt == 'z')
+            zipname = optarg;
+        else if (opt == 'p')
+            password = optarg;
+        else
+            badopt = 1;
+    }
+
+    // A worker gets the puzzle from the coordinator
+    if (coord && (badopt == 0) && (argc == optind)) {
+        runshard(coord);
+        exit(0);
+    }
+
+    if (! ((badopt == 0) &&
+           (coord == 0) &&
+           ((port == 0) || (nworker > 0)) &&
+           ((broadcast == 0) || (nworker > 0)) &&
+           ((zipname == 0) || (nworker == 0) || broadcast) &&
+           (argc - optind == 3) &&
+           (sscanf(argv[optind], "%d", &width) == 1) &&
+           (sscanf(argv[optind + 1], "%d", &height) == 1) &&
+           (sscanf(argv[optind + 2], "%d", &edge) == 1) &&
+           (width >= 2) &&
+           (height >= 2) &&
+           (edge >= 2) &&
+           (width <= MAX_WIDTH) &&
+           (height <= MAX_HEIGHT) &&
+           (edge <= MAX_EDGE) &&
+           ((several == 0) || (bothends == 0))))
+    {
+        // Could not get puzzle parameters
+        printf("Usage: %s [-t <threads>] [-o] [-s | -m] [-z <zipfile> [-p <password>]] [-n <workers> [-l <port>] [-b]] <width> <height> <size>\n", argv[0]);
+        printf("       %s -c <host:port>\n", argv[0]);
+        exit(1);
+    }
+
+    // -o, -s, and -m change how assemble() works, so they mean nothing
+    // for the small edges search() solves or for the workers' tiles
+    if ((stream || several || bothends) && (edge <= SEARCH_EDGE)) {
+        printf("-%c needs an edge over %d\n",
+               stream ? 'o' : (several ? 's' : 'm'), SEARCH_EDGE);
+        exit(1);
+    }
+    if ((stream || several || bothends) && (nworker > 0)) {
+        printf("-%c can not be used with -n\n",
+               stream ? 'o' : (several ? 's' : 'm'));
+        exit(1);
+    }
+
+    // Read the zip directory before the password, which starts the clock
+    if (zipname) {
+        if (jz_open(&zip, zipname) != 0) {
+            printf("Unable to open zip file %s: %s\n", zipname, strerror(errno));
+            exit(1);
+        }
+        if (password == 0)
+            password = getpass("Password: ");
+    }
+
+    memset(&pz, 0, sizeof(pz));
+    pz.width = width;
+    pz.height = height;
+    pz.edge = edge;
+    pz.npiece = width * height;
+    pz.nthread = nthread;
+    pz.nworker = nworker;
+    pz.port = port;
+    pz.broadcast = broadcast;
+    pz.stream = stream;
+    pz.portfolio = several;
+    pz.meet = bothends;
+    pz.keybits = edge - 2;
+    pz.flat = (1 << pz.keybits) - 1;
+    pz.nkey = 1 << (2 * pz.keybits);
+
+    stagetime(0);
+    loadpieces(&pz, zipname ? &zip : 0, password);
+    stagetime("load");
+    classifypieces(&pz);
+    stagetime("classify");
+    // With -o the layout is mostly done already; if it is stuck
+    // the pieces are indexed and assembled as usual.
+    if ((stream == 0) || (finishonline(&pz) != 0)) {
+        indexpieces(&pz);
+        stagetime("index");
+        // The workers are only needed again to assemble tiles
+        if ((nworker > 0) && (edge <= SEARCH_EDGE))
+            stopcluster(&pz);
+        if (((edge <= SEARCH_EDGE) ? search(&pz) :
+             several ? portfolio(&pz) : assemble(&pz)) != 0) {
+            stagetime("assemble");
+            printf("No solution found\n");
+            exit(1);
+        }
+    }
+    stagetime("assemble");
+    outputsolution(&pz);
+    stagetime("output");
+    if (zipname)
+        printf("%.3f ms from password to solution\n", stagetime(0));
+    else
+        printf("%.3f ms total\n", stagetime(0));
+
+    exit(0);
+}
+
+
+/**************************************************************
+ * loadpieces(): - Read every .pbm file, get its mask, straight
+ * sides, edge signatures, and canonical mask, and sort it into a
+ * shape, with each step a stage of a pipeline.  One thread reads
+ * the files, one parses them, one gets the sides, and this thread
+ * hashes the shapes, so all of the work on the pieces is done
+ * while the files are still being read.  With a zip file the
+ * entries are read from it instead, and with workers the first
+ * three stages are done by the workers.  With -b the pieces are
+ * read here into the mask table before the workers are started.
+ * With -o the assembler thread is started first and the shape
+ * stage hands it each piece as it arrives.
+ *
+ * Input:        puzzle, zip file or NULL, password for the zip file
+ **************************************************************/
+void loadpieces(PUZZLE *pz, JZIP *zip, const char *password)
+{
+    INGEST ing;             // state shared by the stages
+    pthread_t tid[MAX_WORKERS]; // stage threads, or a thread per worker
+    int   i;                // generic loop counter
+
+    memset(&ing, 0, sizeof(ing));
+    ing.pz = pz;
+    ing.zip = zip;
+    ing.password = password;
+    pz->mask = (uint64_t *) malloc(sizeof(uint64_t) * pz->npiece);
+    pz->flatside = (unsigned char *) malloc(pz->npiece);
+    pz->sig = malloc(sizeof(*pz->sig) * pz->npiece);
+    pz->cls = (int *) malloc(sizeof(int) * pz->npiece);
+    pz->crot = (int *) malloc(sizeof(int) * pz->npiece);
+    ing.canon = (uint64_t *) malloc(sizeof(uint64_t) * pz->npiece);
+    ing.buf = (PBMBUF *) malloc(sizeof(PBMBUF) * QUEUELEN);
+    ing.seen = (char *) calloc(pz->npiece, sizeof(char));
+    if ((pz->mask == 0) || (pz->flatside == 0) || (pz->sig == 0) ||
+        (pz->cls == 0) || (pz->crot == 0) || (ing.canon == 0) ||
+        (ing.buf == 0) || (ing.seen == 0) ||
+        (jq_init(&ing.freeq, QUEUELEN) != 0) ||
+        (jq_init(&ing.textq, QUEUELEN) != 0) ||
+        (jq_init(&ing.maskq, QUEUELEN) != 0) ||
+        (jq_init(&ing.sigq, QUEUELEN) != 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (i = 0; i < QUEUELEN; i++)
+        jq_put(&ing.freeq, (intptr_t) &ing.buf[i]);
+    if (pz->stream)
+        startonline(pz);
+
+    if (pz->nworker > 0) {
+        if (pz->broadcast)
+            readtable(&ing);
+        startcluster(&ing, tid);
+    }
+    else {
+        for (i = 0; i < 3; i++) {
+            if (pthread_create(&tid[i], 0, (i == 0) ? readstage :
+                               (i == 1) ? parsestage : sidestage, &ing) != 0) {
+                printf("Unable to start the load threads\n");
+                exit(1);
+            }
+        }
+    }
+    shapestage(&ing);
+    for (i = 0; i < ((pz->nworker > 0) ? pz->nworker : 3); i++)
+        pthread_join(tid[i], 0);
+
+    jq_free(&ing.freeq);
+    jq_free(&ing.textq);
+    jq_free(&ing.maskq);
+    jq_free(&ing.sigq);
+    free(ing.buf);
+    free(ing.canon);
+    free(ing.seen);
+}
+
+
+/**************************************************************
+ * readstage(): - Read every .pbm file into a free buffer for the
+ * parse stage, or every zip entry straight into the mask table,
+ * then put a NULL buffer on the queue to end the stream.
+ *
+ **************************************************************/
+void *readstage(void *arg)
+{
+    INGEST *ing = (INGEST *) arg;
+
+    if (ing->zip)
+        readzip(ing);
+    else if (jl_foreach(ing->pz->npiece, JL_AUTO, readname, readpiece,
+                   ing) != JL_OK) {
+        printf("Error reading the piece files\n");
+        exit(1);
+    }
+    jq_put(&ing->textq, (intptr_t) 0);
+    return(0);
+}
+
+
+/**************************************************************
+ * readname(): - Give jl_foreach() the name of piece n
+ *
+ **************************************************************/
+void readname(void *arg, int n, char *name, size_t len)
+{
+    js_name(JS_ENTRY(n, 0), name, len);
+}
+
+
+/**************************************************************
+ * readpiece(): - called by jl_foreach() with the text of each
+ * .pbm file.  Copy it into a free buffer for the parse stage.
+ *
+ **************************************************************/
+int readpiece(void *arg, int n, const char *data, size_t len)
+{
+    INGEST *ing = (INGEST *) arg;
+    PBMBUF *b;              // buffer being filled
+    char  fname[PBMNAMELEN]; // .pbm file name
+
+    if (data == 0) {
+        js_name(JS_ENTRY(n, 0), fname, PBMNAMELEN);
+        printf("No piece file for %s\n", fname);
+        exit(1);
+    }
+    b = (PBMBUF *) jq_get(&ing->freeq);
+    b->n = n;
+    b->len = len;
+    memcpy(b->text, data, len);
+    jq_put(&ing->textq, (intptr_t) b);
+    return(0);
+}
+
+
+/**************************************************************
+ * readzip(): - Decrypt and inflate every entry of the zip file
+ * on a thread per CPU, then check that every piece was there.
+ *
+ **************************************************************/
+void readzip(INGEST *ing)
+{
+    char  fname[PBMNAMELEN]; // .pbm file name
+    int   ret;              // return from jz_foreach()
+    int   n;                // piece number
+
+    ret = jz_foreach(ing->zip, ing->password, 0, zippiece, ing);
+    if (ret == JZ_BADPASS) {
+        printf("Wrong password for zip file\n");
+        exit(1);
+    }
+    else if (ret != JZ_OK) {
+        printf("Error reading zip file\n");
+        exit(1);
+    }
+    for (n = 0; n < ing->pz->npiece; n++) {
+        if (! ing->seen[n]) {
+            js_name(JS_ENTRY(n, 0), fname, PBMNAMELEN);
+            printf("No piece file for %s\n", fname);
+            exit(1);
+        }
+    }
+}
+
+
+/**************************************************************
+ * readtable(): - Read every piece into the mask table once, from
+ * the files or the zip file, for the workers to be sent their
+ * shards of it.  The table is in piece order, so the index of a
+ * mask is the number in its file name.
+ *
+ **************************************************************/
+void readtable(INGEST *ing)
+{
+    PUZZLE *pz = ing->pz;   // the puzzle being solved
+
+    pz->first = 0;
+    if (ing->zip)
+        readzip(ing);
+    else if (jl_foreach(pz->npiece, JL_AUTO, shardname, shardpiece, pz) != JL_OK) {
+        printf("Error reading the piece files\n");
+        exit(1);
+    }
+    stagetime("table");
+}
+
+
+/**************************************************************
+ * zippiece(): - called from many threads by jz_foreach() with
+ * the contents of each zip entry.  Parse it into the mask table
+ * and pass the piece on to the side stage, unless the table is
+ * for the workers.  Entries that are not named like a piece are
+ * skipped.
+ *
+ **************************************************************/
+int zippiece(void *arg, int entry, const char *data, size_t len)
+{
+    INGEST *ing = (INGEST *) arg;
+    const char *name;       // name of the entry
+    uint32_t n;             // piece number
+
+    name = ing->zip->ent[entry].base;
+    n = js_number(name);
+    if (n == JS_NONUM)
+        return(0);
+    if ((n >= (uint32_t) ing->pz->npiece) ||
+        __atomic_exchange_n(&ing->seen[n], 1, __ATOMIC_RELAXED) ||
+        (jp_parsepbm(data, len, ing->pz->edge, &ing->pz->mask[n]) != 0)) {
+        printf("Error processing file %s\n", name);
+        exit(1);
+    }
+    if (ing->pz->nworker == 0)
+        jq_put(&ing->maskq, n);
+    return(0);
+}
+
+
+/**************************************************************
+ * parsestage(): - Convert the text of each piece to its mask and
+ * give the buffer back to the read stage.  A piece number of -1
+ * ends the stream.
+ *
+ **************************************************************/
+void *parsestage(void *arg)
+{
+    INGEST *ing = (INGEST *) arg;
+    PBMBUF *b;              // buffer holding a piece
+    char  fname[PBMNAMELEN]; // .pbm file name
+    int   n;                // piece number
+
+    while ((b = (PBMBUF *) jq_get(&ing->textq)) != 0) {
+        n = b->n;
+        if (jp_parsepbm(b->text, b->len, ing->pz->edge,
+                        &ing->pz->mask[n]) != 0) {
+            js_name(JS_ENTRY(n, 0), fname, PBMNAMELEN);
+            printf("Error processing file %s\n", fname);
+            exit(1);
+        }
+        jq_put(&ing->freeq, (intptr_t) b);
+        jq_put(&ing->maskq, n);
+    }
+    jq_put(&ing->maskq, -1);
+    return(0);
+}
+
+
+/**************************************************************
+ * sidestage(): - Find the straight sides, the edge signatures,
+ * and the canonical mask of each piece.
+ *
+ **************************************************************/
+void *sidestage(void *arg)
+{
+    INGEST *ing = (INGEST *) arg;
+    PUZZLE *pz = ing->pz;   // the puzzle being solved
+    unsigned sig[4];        // signatures of one piece
+    int   n;                // piece number
+    int   k;                // side
+
+    while ((n = (int) jq_get(&ing->maskq)) >= 0) {
+        jp_flatsides(&pz->mask[n], 1, pz->edge, &pz->flatside[n]);
+        jp_edges(pz->mask[n], pz->edge, sig);
+        for (k = 0; k < 4; k++)
+            pz->sig[n][k] = sig[k];
+        ing->canon[n] = jp_canon(pz->mask[n], pz->edge, &pz->crot[n]);
+        jq_put(&ing->sigq, n);
+    }
+    jq_put(&ing->sigq, -1);
+    return(0);
+}
+
+
+/**************************************************************
+ * shapestage(): - Give each piece a shape by looking up its
+ * canonical mask in a hash table, adding a new shape if it is
+ * not there.  Only this stage touches the table, so it needs no
+ * locks.  With -o each piece is then passed to the assembler.
+ *
+ **************************************************************/
+void shapestage(INGEST *ing)
+{
+    PUZZLE *pz = ing->pz;   // the puzzle being solved
+    uint64_t *shape;        // canonical mask of each shape
+    uint64_t  cm;           // canonical mask of a piece
+    int  *table;            // hash table of shapes, -1 if empty
+    int   tbits;            // log2 of the table size
+    int   h;                // slot in the table
+    int   n;                // piece number
+    int   isnew;            // set if the piece is of a new shape
+
+    for (tbits = 1; (1 << tbits) < 2 * pz->npiece; tbits++)
+        ;
+    table = (int *) malloc(sizeof(int) << tbits);
+    shape = (uint64_t *) malloc(sizeof(uint64_t) * pz->npiece);
+    if ((table == 0) || (shape == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+
+    // Open addressing with a multiplicative hash of the mask
+    memset(table, -1, sizeof(int) << tbits);
+    pz->nclass = 0;
+    while ((n = (int) jq_get(&ing->sigq)) >= 0) {
+        cm = ing->canon[n];
+        h = (int) ((cm * 0x9E3779B97F4A7C15ULL) >> (64 - tbits));
+        while ((table[h] >= 0) && (shape[table[h]] != cm))
+            h = (h + 1) & ((1 << tbits) - 1);
+        isnew = (table[h] < 0);
+        if (isnew) {
+            table[h] = pz->nclass;
+            shape[pz->nclass++] = cm;
+        }
+        pz->cls[n] = table[h];
+        if (pz->online)
+            onlineadd(pz, n, isnew);
+    }
+    if (pz->online)
+        onlinedone(pz);
+    free(table);
+    free(shape);
+}
+
+
+/**************************************************************
+ * startonline(): - Set up the buckets that are filled as the
+ * pieces arrive and start the thread that assembles from them.
+ *
+ **************************************************************/
+void startonline(PUZZLE *pz)
+{
+    ONLINE *on;             // the buckets and the assembler
+    int   pool;             // candidate pool
+
+    on = (ONLINE *) calloc(1, sizeof(ONLINE));
+    if (on == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    // A shape has at most 4 entries in POOL_ALL and 4 in each border pool
+    on->block = (int **) calloc((20 * pz->npiece) / ONLINE_BLOCK + 1, sizeof(int *));
+    on->count = (int *) calloc(pz->npiece, sizeof(int));
+    if ((on->block == 0) || (on->count == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (pool = 0; pool < NPOOL; pool++) {
+        on->head[pool] = (int *) malloc(sizeof(int) * pz->nkey);
+        on->tail[pool] = (int *) malloc(sizeof(int) * pz->nkey);
+        if ((on->head[pool] == 0) || (on->tail[pool] == 0)) {
+            printf("malloc failure\n");
+            exit(1);
+        }
+        memset(on->head[pool], -1, sizeof(int) * pz->nkey);
+        memset(on->tail[pool], -1, sizeof(int) * pz->nkey);
+    }
+    pthread_mutex_init(&on->lock, 0);
+    pthread_cond_init(&on->more, 0);
+    pz->online = on;
+    if (pthread_create(&on->tid, 0, onlineworker, pz) != 0) {
+        printf("Unable to start the assembler thread\n");
+        exit(1);
+    }
+}
+
+
+/**************************************************************
+ * onlineadd(): - Give the assembler a piece that has just been
+ * given its shape.  The first piece of a shape stands for it, so
+ * only its entries are added, each to the end of the bucket for
+ * its key pair.  The buckets are linked lists in blocks that are
+ * never moved, and only this thread adds to them, so a slot is
+ * published to the assembler with a release store of the link
+ * to it.  The assembler is woken only if it is waiting.
+ *
+ * Input:        puzzle, piece, set if the piece is of a new shape
+ **************************************************************/
+void onlineadd(PUZZLE *pz, int n, int isnew)
+{
+    ONLINE *on = pz->online; // the buckets and the assembler
+    int   ent[4];           // entries of the piece in a pool
+    int   nent;             // number of entries in ent
+    int   pool;             // candidate pool
+    int   i;                // index into ent
+    int   x;                // slot of an entry
+    unsigned key;           // key pair of an entry
+
+    // Count the piece first so its entries are never seen without it
+    __atomic_add_fetch(&on->count[pz->cls[n]], 1, __ATOMIC_RELEASE);
+    for (pool = 0; isnew && (pool < NPOOL); pool++) {
+        nent = pieceentries(pz, pool, n, ent);
+        for (i = 0; i < nent; i++) {
+            x = on->nslot++;
+            if ((x % ONLINE_BLOCK) == 0) {
+                on->block[x / ONLINE_BLOCK] =
+                    (int *) malloc(sizeof(int) * 2 * ONLINE_BLOCK);
+                if (on->block[x / ONLINE_BLOCK] == 0) {
+                    printf("malloc failure\n");
+                    exit(1);
+                }
+            }
+            SLOT_ENT(on, x) = ent[i];
+            SLOT_NEXT(on, x) = -1;
+            key = keypair(pz, ent[i]);
+            if (on->tail[pool][key] < 0)
+                __atomic_store_n(&on->head[pool][key], x, __ATOMIC_RELEASE);
+            else
+                __atomic_store_n(&SLOT_NEXT(on, on->tail[pool][key]), x,
+                                 __ATOMIC_RELEASE);
+            on->tail[pool][key] = x;
+        }
+    }
+    __atomic_add_fetch(&on->arrived, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&on->waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&on->lock);
+        pthread_cond_broadcast(&on->more);
+        pthread_mutex_unlock(&on->lock);
+    }
+}
+
+
+/**************************************************************
+ * onlinedone(): - Tell the assembler that the last piece is in,
+ * noting how far it had got.
+ *
+ **************************************************************/
+void onlinedone(PUZZLE *pz)
+{
+    ONLINE *on = pz->online; // the buckets and the assembler
+
+    pthread_mutex_lock(&on->lock);
+    on->atdone = __atomic_load_n(&on->placed, __ATOMIC_RELAXED);
+    __atomic_store_n(&on->done, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&on->more);
+    pthread_mutex_unlock(&on->lock);
+}
+
+
+/**************************************************************
+ * onlineworker(): - Assemble the puzzle from the buckets as they
+ * fill.  This is the search of assemble(), walking the linked
+ * buckets instead of the index and counting the pieces of each
+ * shape used instead of those left.  A step that comes to the
+ * end of its bucket while pieces are still arriving waits for
+ * more instead of backing up, so the search only backs up over
+ * what it has seen, and the look ahead only rejects a piece once
+ * every piece is in.  A shape passed over because all of its
+ * pieces so far were used is not tried again if more arrive, so
+ * the search can get stuck where assemble() would not, and the
+ * solver then starts over with the index.
+ *
+ **************************************************************/
+void *onlineworker(void *arg)
+{
+    PUZZLE *pz = (PUZZLE *) arg;
+    ONLINE *on = pz->online; // the buckets and the assembler
+    JGRID grid;             // placement oracle
+    int  *used;             // pieces of each shape placed
+    int  *order;            // position to fill at each step
+    int  *cursor;           // last slot tried at each step, or -1
+    int   k;                // step, the number of pieces placed
+    int   pos;              // position being filled
+    int   pool;             // pool searched at the position
+    unsigned key;           // key pair wanted at the position
+    int   x;                // slot of the candidate
+    int   e;                // candidate entry
+    int   c;                // shape of the candidate
+
+    used = (int *) calloc(pz->npiece, sizeof(int));
+    order = (int *) malloc(sizeof(int) * pz->npiece);
+    cursor = (int *) malloc(sizeof(int) * pz->npiece);
+    pz->place = (int *) malloc(sizeof(int) * pz->npiece);
+    if ((used == 0) || (order == 0) || (cursor == 0) || (pz->place == 0) ||
+        (jg_init(&grid, pz->width, pz->height, pz->edge) != 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (pos = 0; pos < pz->npiece; pos++)
+        pz->place[pos] = -1;
+    fillorder(pz, order);
+
+    k = 0;
+    cursor[0] = -1;
+    while (k < pz->npiece) {
+        pos = order[k];
+        pool = poolof(pz, pos);
+        key = wantkey(pz, pos);
+        for (x = onlinenext(on, pool, key, cursor[k]); x >= 0;
+             x = onlinenext(on, pool, key, x)) {
+            e = SLOT_ENT(on, x);
+            c = pz->cls[EPIECE(e)];
+            if ((__atomic_load_n(&on->count[c], __ATOMIC_ACQUIRE) == used[c]) ||
+                !fits(pz, pos, e))
+                continue;
+            if (jg_place(&grid, pz->mask[EPIECE(e)], pos, EROT(e)) != JG_OK)
+                continue;
+            pz->place[pos] = e;
+            used[c]++;
+            if (lookahead(pz, used, pos))
+                break;
+            used[c]--;
+            jg_unplace(&grid);
+        }
+
+        if (x >= 0) {
+            cursor[k] = x;
+            k++;
+            if (k < pz->npiece)
+                cursor[k] = -1;
+        }
+        else {
+            if (k == 0)
+                break;
+            k--;
+            jg_unplace(&grid);
+            used[pz->cls[EPIECE(pz->place[order[k]])]]--;
+        }
+        __atomic_store_n(&on->placed, k, __ATOMIC_RELAXED);
+    }
+
+    on->result = ((k == pz->npiece) && jg_is_complete(&grid)) ? 0 : -1;
+    jg_free(&grid);
+    free(used);
+    free(order);
+    free(cursor);
+    return(0);
+}
+
+
+/**************************************************************
+ * onlinenext(): - Return the slot after x in the bucket for a
+ * key pair, or the first slot if x is -1.  At the end of the
+ * bucket wait for more pieces unless the last one is in.  The
+ * count of pieces arrived is read before the bucket, so a piece
+ * added after the bucket is read always wakes the wait.
+ *
+ * Input:        buckets, pool, key pair, slot or -1
+ * Output:       the next slot, or -1 if there is none
+ **************************************************************/
+int onlinenext(ONLINE *on, int pool, unsigned key, int x)
+{
+    int   seen;             // pieces arrived before the bucket was read
+    int   done;             // set if every piece was in before it was read
+    int   y;                // the next slot
+
+    while (1) {
+        seen = __atomic_load_n(&on->arrived, __ATOMIC_SEQ_CST);
+        done = __atomic_load_n(&on->done, __ATOMIC_SEQ_CST);
+        y = (x < 0) ? __atomic_load_n(&on->head[pool][key], __ATOMIC_ACQUIRE) :
+                      __atomic_load_n(&SLOT_NEXT(on, x), __ATOMIC_ACQUIRE);
+        if ((y >= 0) || done)
+            return(y);
+        pthread_mutex_lock(&on->lock);
+        __atomic_store_n(&on->waiting, 1, __ATOMIC_SEQ_CST);
+        while ((__atomic_load_n(&on->arrived, __ATOMIC_SEQ_CST) == seen) &&
+               (__atomic_load_n(&on->done, __ATOMIC_SEQ_CST) == 0))
+            pthread_cond_wait(&on->more, &on->lock);
+        __atomic_store_n(&on->waiting, 0, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&on->lock);
+    }
+}
+
+
+/**************************************************************
+ * onlinecandidate(): - hascandidate() for the buckets that fill
+ * as the pieces arrive.  While pieces are still arriving a
+ * position with no candidate yet may get one, so it counts as
+ * having one.
+ *
+ * Input:        puzzle, pieces of each shape used, position
+ * Output:       1 if the position has or may get a candidate
+ **************************************************************/
+int onlinecandidate(PUZZLE *pz, int *used, int pos)
+{
+    ONLINE *on = pz->online; // the buckets and the assembler
+    int   done;             // set if every piece was in before the scan
+    int   pool;             // pool searched at the position
+    unsigned key;           // key pair wanted at the position
+    int   x;                // slot of the candidate
+    int   e;                // candidate entry
+    int   c;                // shape of the candidate
+
+    done = __atomic_load_n(&on->done, __ATOMIC_SEQ_CST);
+    pool = poolof(pz, pos);
+    key = wantkey(pz, pos);
+    for (x = __atomic_load_n(&on->head[pool][key], __ATOMIC_ACQUIRE); x >= 0;
+         x = __atomic_load_n(&SLOT_NEXT(on, x), __ATOMIC_ACQUIRE)) {
+        e = SLOT_ENT(on, x);
+        c = pz->cls[EPIECE(e)];
+        if ((__atomic_load_n(&on->count[c], __ATOMIC_ACQUIRE) > used[c]) &&
+            fits(pz, pos, e))
+            return(1);
+    }
+    return(done == 0);
+}
+
+
+/**************************************************************
+ * finishonline(): - Wait for the assembler to finish with the
+ * last of the pieces.  If it filled the puzzle hand out the
+ * pieces of each shape, which needs the shapes classified.
+ *
+ * Output:       0 if the puzzle is assembled, -1 if it is stuck
+ **************************************************************/
+int finishonline(PUZZLE *pz)
+{
+    ONLINE *on = pz->online; // the buckets and the assembler
+    int   result;           // 0 if the assembler filled the puzzle
+    int   pool;             // candidate pool
+    int   b;                // block of slots
+
+    pthread_join(on->tid, 0);
+    printf("%-10s %10d of %d pieces\n", "online", on->atdone, pz->npiece);
+    result = on->result;
+    if (result == 0)
+        unfold(pz);
+    else {
+        printf("%-10s %10s\n", "online", "stuck");
+        free(pz->place);
+        pz->place = 0;
+    }
+    for (pool = 0; pool < NPOOL; pool++) {
+        free(on->head[pool]);
+        free(on->tail[pool]);
+    }
+    for (b = 0; b * ONLINE_BLOCK < on->nslot; b++)
+        free(on->block[b]);
+    free(on->block);
+    free(on->count);
+    pthread_mutex_destroy(&on->lock);
+    pthread_cond_destroy(&on->more);
+    free(on);
+    pz->online = 0;
+    return(result);
+}
+
+
+/**************************************************************
+ * startcluster(): - Get the workers, starting them as processes
+ * on this machine unless a port was given, and start a thread
+ * for each one to send it its shard and take in the results.
+ *
+ * Input:        load state, where to put the thread ids
+ **************************************************************/
+void startcluster(INGEST *ing, pthread_t *tid)
+{
+    PUZZLE *pz = ing->pz;   // the puzzle being solved
+    SHARDRECV *rv;          // argument of each thread
+    char  hostport[32];     // where a local worker connects
+    char  host[JN_ADDRLEN]; // address of a worker
+    char *buf = 0;          // message body
+    size_t buflen = 0;      // size of buf
+    uint32_t type;          // message type
+    int   lfd;              // listening socket
+    int   port;             // port the workers connect to
+    int   w;                // worker
+
+    pz->shard = (SHARD *) calloc(pz->nworker, sizeof(SHARD));
+    pz->sock = (int *) malloc(sizeof(int) * pz->nworker);
+    rv = (SHARDRECV *) malloc(sizeof(SHARDRECV) * pz->nworker);
+    if ((pz->shard == 0) || (pz->sock == 0) || (rv == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    lfd = jn_listen(pz->port, &port);
+    if (lfd < 0) {
+        printf("Unable to listen on port %d: %s\n", pz->port, strerror(errno));
+        exit(1);
+    }
+
+    // No other threads are running yet, so fork() is safe here
+    if (pz->port == 0) {
+        snprintf(hostport, sizeof(hostport), "127.0.0.1:%d", port);
+        fflush(stdout);
+        for (w = 0; w < pz->nworker; w++) {
+            if (fork() == 0) {
+                close(lfd);
+                runshard(hostport);
+                exit(0);
+            }
+        }
+    }
+
+    // Shards are handed out in the order the workers connect.  Each
+    // worker says which port it listens on for the others.
+    ing->peers = (char *) malloc(pz->nworker * (JN_ADDRLEN + 8));
+    if (ing->peers == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    ing->peers[0] = 0;
+    for (w = 0; w < pz->nworker; w++) {
+        pz->sock[w] = jn_accept(lfd);
+        if ((pz->sock[w] < 0) ||
+            (jn_recv(pz->sock[w], &type, &buf, &buflen) != sizeof(int)) ||
+            (type != MSG_PORT) ||
+            (jn_peername(pz->sock[w], host, sizeof(host)) != 0)) {
+            printf("Unable to accept a worker: %s\n", strerror(errno));
+            exit(1);
+        }
+        snprintf(ing->peers + strlen(ing->peers), JN_ADDRLEN + 8, "%s:%d\n",
+                 host, *(int *) buf);
+    }
+    free(buf);
+
+    ing->nrecv = pz->nworker;
+    for (w = 0; w < pz->nworker; w++) {
+        pz->shard[w].first = (int) (((long) pz->npiece * w) / pz->nworker);
+        pz->shard[w].count = (int) (((long) pz->npiece * (w + 1)) /
+                                    pz->nworker) - pz->shard[w].first;
+        rv[w].ing = ing;
+        rv[w].id = w;
+        if (pthread_create(&tid[w], 0, recvshard, &rv[w]) != 0) {
+            printf("Unable to start the load threads\n");
+            exit(1);
+        }
+    }
+    close(lfd);
+    // rv and peers are used until the threads end, and are small, so
+    // they are not freed
+}
+
+
+/**************************************************************
+ * recvshard(): - Send a worker its shard and the list of the
+ * other workers, and with -b the masks of the pieces of the
+ * shard, store the pieces it sends back and pass them on
+ * to the shape stage, then keep the buckets of the key pairs it
+ * owns.  The last thread to finish ends the stream.
+ *
+ **************************************************************/
+void *recvshard(void *arg)
+{
+    SHARDRECV *rv = (SHARDRECV *) arg;
+    INGEST *ing = rv->ing;  // state shared by the stages
+    PUZZLE *pz = ing->pz;   // the puzzle being solved
+    SHARD  *sh = &pz->shard[rv->id];  // this worker's shard
+    int     fd = pz->sock[rv->id];    // socket to the worker
+    int     job[8];         // the job sent to the worker
+    char   *buf = 0;        // message body
+    size_t  buflen = 0;     // size of buf
+    uint32_t type;          // message type
+    int     len;            // length of a message body
+    WIREPIECE *wp;          // pieces in a message
+    int    *count;          // entries in each pool of the partial index
+    int    *p;              // pointer into the partial index
+    long    need;           // ints the partial index should have
+    int     pool;           // pool
+    int     n;              // piece
+    int     k;              // side
+
+    job[0] = pz->width;
+    job[1] = pz->height;
+    job[2] = pz->edge;
+    job[3] = sh->first;
+    job[4] = sh->count;
+    job[5] = rv->id;
+    job[6] = pz->nworker;
+    job[7] = pz->broadcast;
+    if ((jn_send(fd, MSG_JOB, job, sizeof(job)) != 0) ||
+        (jn_send(fd, MSG_PEERS, ing->peers, strlen(ing->peers) + 1) != 0) ||
+        (pz->broadcast &&
+         (jn_send(fd, MSG_TABLE, &pz->mask[sh->first],
+                  sizeof(uint64_t) * sh->count) != 0))) {
+        printf("Lost worker %d\n", rv->id);
+        exit(1);
+    }
+
+    len = jn_recv(fd, &type, &buf, &buflen);
+    if ((len < 0) || (type != MSG_PIECES) ||
+        (len != (int) (sizeof(WIREPIECE) * sh->count))) {
+        printf("Lost worker %d\n", rv->id);
+        exit(1);
+    }
+    wp = (WIREPIECE *) buf;
+    for (n = 0; n < sh->count; n++) {
+        pz->mask[sh->first + n] = wp[n].mask;
+        ing->canon[sh->first + n] = wp[n].canon;
+        pz->crot[sh->first + n] = wp[n].crot;
+        pz->flatside[sh->first + n] = wp[n].flatside;
+        for (k = 0; k < 4; k++)
+            pz->sig[sh->first + n][k] = wp[n].sig[k];
+        jq_put(&ing->sigq, sh->first + n);
+    }
+
+    // The owned buckets are the entry count of each pool, then the
+    // start[] and cand[] arrays of each pool in turn
+    len = jn_recv(fd, &type, &buf, &buflen);
+    count = (int *) buf;
+    need = NPOOL;
+    for (pool = 0; (len >= (int) (sizeof(int) * NPOOL)) && (pool < NPOOL); pool++)
+        need += pz->nkey + 1 + count[pool];
+    if ((len < 0) || (type != MSG_INDEX) || (len != (int) (sizeof(int) * need))) {
+        printf("Lost worker %d\n", rv->id);
+        exit(1);
+    }
+    p = count + NPOOL;
+    for (pool = 0; pool < NPOOL; pool++) {
+        sh->start[pool] = (int *) malloc(sizeof(int) * (pz->nkey + 1));
+        sh->cand[pool] = (int *) malloc(sizeof(int) * (count[pool] + 1));
+        if ((sh->start[pool] == 0) || (sh->cand[pool] == 0)) {
+            printf("malloc failure\n");
+            exit(1);
+        }
+        memcpy(sh->start[pool], p, sizeof(int) * (pz->nkey + 1));
+        p += pz->nkey + 1;
+        memcpy(sh->cand[pool], p, sizeof(int) * count[pool]);
+        p += count[pool];
+    }
+    free(buf);
+
+    if (__atomic_sub_fetch(&ing->nrecv, 1, __ATOMIC_ACQ_REL) == 0)
+        jq_put(&ing->sigq, -1);
+    return(0);
+}
+
+
+/**************************************************************
+ * runshard(): - Be a worker.  Connect to the coordinator, read
+ * the pieces of the shard it gives or take the masks it sends,
+ * find their sides, and send
+ * back the pieces.  Then join the entries with the other workers
+ * and send back the buckets of the key pairs this worker owns.
+ *
+ * Input:        host:port of the coordinator
+ **************************************************************/
+void runshard(const char *coord)
+{
+    PUZZLE pz;              // the shard, with pieces numbered from 0
+    JOIN   jn;              // the join with the other workers
+    int    fd;              // socket to the coordinator
+    char  *buf = 0;         // message body
+    size_t buflen = 0;      // size of buf
+    char  *peers = 0;       // host:port of each worker
+    size_t peerlen = 0;     // size of peers
+    uint32_t type;          // message type
+    int    len;             // length of a message body
+    int    port;            // port the other workers connect to
+    int   *job;             // width, height, edge, first, count, id,
+                            // workers, and set if the masks are sent
+    WIREPIECE *wp;          // pieces to send
+    unsigned sig[4];        // signatures of one piece
+    int    crot;            // rotation to the canonical mask
+    int   *index;           // the owned buckets to send
+    int    nindex;          // ints in index[]
+    int    n;               // piece
+    int    k;               // side
+
+    memset(&jn, 0, sizeof(jn));
+    fd = jn_connect(coord);
+    jn.lfd = jn_listen(0, &port);
+    if ((fd < 0) || (jn.lfd < 0) ||
+        (jn_send(fd, MSG_PORT, &port, sizeof(port)) != 0)) {
+        printf("Unable to connect to %s\n", coord);
+        exit(1);
+    }
+    len = jn_recv(fd, &type, &buf, &buflen);
+    if ((len != 8 * sizeof(int)) || (type != MSG_JOB) ||
+        (jn_recv(fd, &type, &peers, &peerlen) <= 0) || (type != MSG_PEERS)) {
+        printf("Bad job from %s\n", coord);
+        exit(1);
+    }
+    job = (int *) buf;
+    memset(&pz, 0, sizeof(pz));
+    pz.width = job[0];
+    pz.height = job[1];
+    pz.edge = job[2];
+    pz.first = job[3];
+    pz.npiece = job[4];
+    jn.id = job[5];
+    jn.nworker = job[6];
+    pz.keybits = pz.edge - 2;
+    pz.nkey = 1 << (2 * pz.keybits);
+
+    pz.mask = (uint64_t *) malloc(sizeof(uint64_t) * (pz.npiece + 1));
+    pz.flatside = (unsigned char *) malloc(pz.npiece + 1);
+    pz.sig = malloc(sizeof(*pz.sig) * (pz.npiece + 1));
+    wp = (WIREPIECE *) calloc(pz.npiece + 1, sizeof(WIREPIECE));
+    if ((pz.mask == 0) || (pz.flatside == 0) || (pz.sig == 0) || (wp == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+
+    // Read the pieces, or take them from the coordinator, then find
+    // their sides and shapes
+    if (job[7]) {
+        len = jn_recv(fd, &type, &buf, &buflen);
+        if ((len != (int) (sizeof(uint64_t) * pz.npiece)) || (type != MSG_TABLE)) {
+            printf("Bad piece table from %s\n", coord);
+            exit(1);
+        }
+        memcpy(pz.mask, buf, len);
+    }
+    else if (jl_foreach(pz.npiece, JL_AUTO, shardname, shardpiece, &pz) != JL_OK) {
+        printf("Error reading the piece files\n");
+        exit(1);
+    }
+    jp_flatsides(pz.mask, pz.npiece, pz.edge, pz.flatside);
+    for (n = 0; n < pz.npiece; n++) {
+        jp_edges(pz.mask[n], pz.edge, sig);
+        for (k = 0; k < 4; k++)
+            pz.sig[n][k] = wp[n].sig[k] = sig[k];
+        wp[n].mask = pz.mask[n];
+        wp[n].canon = jp_canon(pz.mask[n], pz.edge, &crot);
+        wp[n].crot = crot;
+        wp[n].flatside = pz.flatside[n];
+    }
+    if (jn_send(fd, MSG_PIECES, wp, sizeof(WIREPIECE) * pz.npiece) != 0) {
+        printf("Lost the coordinator\n");
+        exit(1);
+    }
+    free(wp);
+
+    // Send every entry to the owner of its key pair, then build the
+    // buckets of the key pairs this worker owns
+    sendtuples(&pz, &jn, peers);
+    index = ownedindex(&pz, &jn, &nindex);
+    if (jn_send(fd, MSG_INDEX, index, sizeof(int) * nindex) != 0) {
+        printf("Lost the coordinator\n");
+        exit(1);
+    }
+    free(index);
+
+    // Then assemble tiles until the coordinator is done
+    runtiles(fd, &pz);
+    close(fd);
+}
+
+
+/**************************************************************
+ * sendtuples(): - The all to all exchange of a worker.  List the
+ * entries of the shard in each pool as (pool << 16 | key pair,
+ * entry) tuples, sort them by owner, and send each other worker
+ * its tuples in batches.  The tuples this worker owns are kept.
+ * A thread takes in the tuples of the other workers at the same
+ * time, so no worker waits on one that is sending.
+ *
+ * Input:        shard, join, host:port of each worker
+ **************************************************************/
+void sendtuples(PUZZLE *pz, JOIN *jn, char *peers)
+{
+    char  *addr[MAX_WORKERS]; // host:port of each worker
+    char  *save;            // strtok_r() state
+    pthread_t acceptid;     // thread taking in the other workers' tuples
+    int   *ent;             // entries in a pool
+    int    nent;            // number of entries in a pool
+    int   *tuple;           // tuples of the shard sorted by owner
+    int    ntuple;          // tuples listed
+    int    first[MAX_WORKERS + 1]; // first tuple for each owner
+    int    owner;           // owner of a tuple
+    int    pool;            // pool
+    int    fd;              // link to another worker
+    int    w;               // worker
+    int    d;               // step from this worker to the one sent to
+    int    x;               // index into ent[]
+    int    len;             // tuples in a batch
+
+    ent = (int *) malloc(sizeof(int) * 4 * (pz->npiece + 1));
+    if (ent == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (w = 0, addr[0] = strtok_r(peers, "\n", &save);
+         (w < jn->nworker) && addr[w]; )
+        if (++w < jn->nworker)
+            addr[w] = strtok_r(0, "\n", &save);
+    if (w < jn->nworker) {
+        printf("Bad list of workers\n");
+        exit(1);
+    }
+    if (pthread_create(&acceptid, 0, acceptpeers, jn) != 0) {
+        printf("Unable to start the join threads\n");
+        exit(1);
+    }
+
+    // Count the tuples of each owner, then fill them in from the end
+    // back so each owner's tuples stay in pool and piece order
+    memset(first, 0, sizeof(first));
+    for (pool = 0; pool < NPOOL; pool++) {
+        nent = poolentries(pz, pool, ent, 0);
+        for (x = 0; x < nent; x++)
+            first[OWNER(keypair(pz, ent[x]), jn->nworker)]++;
+    }
+    for (w = 1; w <= jn->nworker; w++)
+        first[w] += first[w - 1];
+    ntuple = first[jn->nworker];
+    tuple = (int *) malloc(sizeof(int) * 2 * (ntuple + 1));
+    if (tuple == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (pool = NPOOL - 1; pool >= 0; pool--) {
+        nent = poolentries(pz, pool, ent, 0);
+        for (x = nent - 1; x >= 0; x--) {
+            owner = OWNER(keypair(pz, ent[x]), jn->nworker);
+            first[owner]--;
+            tuple[2 * first[owner]] = (pool << 16) | keypair(pz, ent[x]);
+            tuple[(2 * first[owner]) + 1] = ent[x] + ENTRY(pz->first, 0);
+        }
+    }
+    first[jn->nworker] = ntuple;
+
+    // Keep our own, and send the rest starting with the next worker
+    // so that the workers do not all send to the same one at once
+    jn->ntuple[jn->id] = 2 * (first[jn->id + 1] - first[jn->id]);
+    jn->tuple[jn->id] = (int *) malloc(sizeof(int) * (jn->ntuple[jn->id] + 1));
+    if (jn->tuple[jn->id] == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    memcpy(jn->tuple[jn->id], &tuple[2 * first[jn->id]],
+           sizeof(int) * jn->ntuple[jn->id]);
+    for (d = 1; d < jn->nworker; d++) {
+        w = (jn->id + d) % jn->nworker;
+        fd = jn_connect(addr[w]);
+        if ((fd < 0) || (jn_send(fd, MSG_HELLO, &jn->id, sizeof(int)) != 0)) {
+            printf("Unable to connect to worker %d at %s\n", w, addr[w]);
+            exit(1);
+        }
+        for (x = first[w]; x < first[w + 1]; x += len) {
+            len = (first[w + 1] - x < JOIN_BATCH) ? first[w + 1] - x : JOIN_BATCH;
+            if (jn_send(fd, MSG_TUPLES, &tuple[2 * x], sizeof(int) * 2 * len) != 0) {
+                printf("Lost worker %d\n", w);
+                exit(1);
+            }
+        }
+        if (jn_send(fd, MSG_DONE, 0, 0) != 0) {
+            printf("Lost worker %d\n", w);
+            exit(1);
+        }
+        close(fd);
+    }
+    pthread_join(acceptid, 0);
+    close(jn->lfd);
+    free(ent);
+    free(tuple);
+}
+
+
+/**************************************************************
+ * acceptpeers(): - Take a link from each other worker and start
+ * a thread to read its tuples, then wait for them all.
+ *
+ **************************************************************/
+void *acceptpeers(void *arg)
+{
+    JOIN  *jn = (JOIN *) arg;
+    JOINRECV jr[MAX_WORKERS]; // argument of each thread
+    pthread_t tid[MAX_WORKERS]; // thread for each link
+    int    i;               // link
+
+    for (i = 0; i < jn->nworker - 1; i++) {
+        jr[i].jn = jn;
+        jr[i].fd = jn_accept(jn->lfd);
+        if ((jr[i].fd < 0) ||
+            (pthread_create(&tid[i], 0, recvtuples, &jr[i]) != 0)) {
+            printf("Unable to accept a worker: %s\n", strerror(errno));
+            exit(1);
+        }
+    }
+    for (i = 0; i < jn->nworker - 1; i++)
+        pthread_join(tid[i], 0);
+    return(0);
+}
+
+
+/**************************************************************
+ * recvtuples(): - Read the tuples another worker sends on a link
+ * until it is done.  The tuples are kept by the sending worker so
+ * that they can be put back in piece order.
+ *
+ **************************************************************/
+void *recvtuples(void *arg)
+{
+    JOINRECV *jr = (JOINRECV *) arg;
+    JOIN  *jn = jr->jn;     // the join
+    char  *buf = 0;         // message body
+    size_t buflen = 0;      // size of buf
+    uint32_t type;          // message type
+    int    len;             // length of a message body
+    int    from;            // worker at the other end
+    int    size = 0;        // ints allocated in its tuple[]
+    int   *grow;            // tuple[] made larger
+
+    if ((jn_recv(jr->fd, &type, &buf, &buflen) != sizeof(int)) ||
+        (type != MSG_HELLO) || ((from = *(int *) buf) < 0) ||
+        (from >= jn->nworker) || (from == jn->id)) {
+        printf("Bad link from another worker\n");
+        exit(1);
+    }
+    for (;;) {
+        len = jn_recv(jr->fd, &type, &buf, &buflen);
+        if ((len < 0) || ((type != MSG_TUPLES) && (type != MSG_DONE))) {
+            printf("Lost worker %d\n", from);
+            exit(1);
+        }
+        if (type == MSG_DONE)
+            break;
+        if (jn->ntuple[from] + (len / (int) sizeof(int)) > size) {
+            size = 2 * (jn->ntuple[from] + (len / sizeof(int)));
+            grow = (int *) realloc(jn->tuple[from], sizeof(int) * size);
+            if (grow == 0) {
+                printf("malloc failure\n");
+                exit(1);
+            }
+            jn->tuple[from] = grow;
+        }
+        memcpy(&jn->tuple[from][jn->ntuple[from]], buf, len);
+        jn->ntuple[from] += len / sizeof(int);
+    }
+    close(jr->fd);
+    free(buf);
+    return(0);
+}
+
+
+/**************************************************************
+ * ownedindex(): - Sort the tuples this worker owns into buckets
+ * by pool and key pair, taking the senders in shard order so
+ * that each bucket lists its entries in piece order, and pack
+ * them as a MSG_INDEX body: the entry count of each pool, then
+ * the start[] and cand[] arrays of each pool in turn.
+ *
+ * Input:        shard, join, where to put the number of ints
+ * Output:       the message body
+ **************************************************************/
+int *ownedindex(PUZZLE *pz, JOIN *jn, int *nindex)
+{
+    int   *index;           // the message body
+    int   *count;           // entries in each pool
+    int   *start[NPOOL];    // first candidate for each key pair
+    int   *cand[NPOOL];     // entries sorted by key pair
+    int    ntuple = 0;      // tuples owned
+    int    pool;            // pool of a tuple
+    int    key;             // key pair of a tuple
+    int    w;               // sending worker
+    int    x;               // index into a tuple list
+    int    at;              // where the next array goes in index[]
+
+    for (w = 0; w < jn->nworker; w++)
+        ntuple += jn->ntuple[w] / 2;
+    index = (int *) calloc(NPOOL + (NPOOL * (pz->nkey + 1)) + ntuple + 1,
+                           sizeof(int));
+    if (index == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+
+    // Count the tuples in each pool, and lay out the pools
+    count = index;
+    for (w = 0; w < jn->nworker; w++)
+        for (x = 0; x < jn->ntuple[w]; x += 2)
+            count[jn->tuple[w][x] >> 16]++;
+    at = NPOOL;
+    for (pool = 0; pool < NPOOL; pool++) {
+        start[pool] = &index[at];
+        cand[pool] = &index[at + pz->nkey + 1];
+        at += pz->nkey + 1 + count[pool];
+    }
+    *nindex = at;
+
+    // Counting sort by key pair within each pool, filling from the
+    // last tuple of the last sender back to keep piece order
+    for (w = 0; w < jn->nworker; w++) {
+        for (x = 0; x < jn->ntuple[w]; x += 2) {
+            pool = jn->tuple[w][x] >> 16;
+            start[pool][jn->tuple[w][x] & 0xffff]++;
+        }
+    }
+    for (pool = 0; pool < NPOOL; pool++)
+        for (key = 1; key <= pz->nkey; key++)
+            start[pool][key] += start[pool][key - 1];
+    for (w = jn->nworker - 1; w >= 0; w--) {
+        for (x = jn->ntuple[w] - 2; x >= 0; x -= 2) {
+            pool = jn->tuple[w][x] >> 16;
+            key = jn->tuple[w][x] & 0xffff;
+            cand[pool][--start[pool][key]] = jn->tuple[w][x + 1];
+        }
+        free(jn->tuple[w]);
+    }
+    return(index);
+}
+
+
+/**************************************************************
+ * runtiles(): - Assemble the tiles the coordinator sends.  The
+ * shapes stand in for the pieces, so the entries of this worker
+ * are shape * 4 + rotation, the same as on the wire.  A tile is
+ * filled, along with the halo the coordinator asks for, given the
+ * entries along the top and left.  Only the tile is sent back,
+ * then the pieces are cleared for the next one.  The coordinator closes
+ * the socket when it is done, or before the shapes if the puzzle
+ * is solved by search().
+ *
+ * Input:        socket to the coordinator, the shard
+ **************************************************************/
+void runtiles(int fd, PUZZLE *sz)
+{
+    PUZZLE tz;              // the shapes, and the tile being filled
+    WIRESHAPE *ws;          // the shapes from the coordinator
+    char  *buf = 0;         // message body
+    size_t buflen = 0;      // size of buf
+    uint32_t type;          // message type
+    int    len;             // length of a message body
+    int   *left;            // pieces of each shape not yet placed
+    int   *ent;             // entries in a pool
+    int   *job;             // the tile and its border
+    int    lay[TILE_SIZE * TILE_SIZE]; // entries of the tile
+    int    x0, y0;          // top left position of the tile
+    int    tw, th;          // width and height of the tile
+    int    fw, fh;          // width and height filled, with the halo
+    int    n;               // ints read from job[], or entries
+    int    filled;          // set if the tile was filled
+    int    pool;            // pool
+    int    c;               // shape
+    int    k;               // side
+    int    i, j;            // position in the puzzle
+
+    len = jn_recv(fd, &type, &buf, &buflen);
+    if ((len < 0) && (errno == 0))
+        return;             // no tiles to do
+    if ((len <= 0) || (type != MSG_SHAPES) || (len % sizeof(WIRESHAPE) != 0)) {
+        printf("Bad shapes from the coordinator\n");
+        exit(1);
+    }
+    ws = (WIRESHAPE *) buf;
+    memset(&tz, 0, sizeof(tz));
+    tz.width = sz->width;
+    tz.height = sz->height;
+    tz.edge = sz->edge;
+    tz.keybits = sz->keybits;
+    tz.flat = (1 << tz.keybits) - 1;
+    tz.nkey = sz->nkey;
+    tz.npiece = len / sizeof(WIRESHAPE);
+    tz.nclass = tz.npiece;
+    tz.sig = malloc(sizeof(*tz.sig) * tz.npiece);
+    tz.flatside = (unsigned char *) malloc(tz.npiece);
+    tz.cls = (int *) malloc(sizeof(int) * tz.npiece);
+    tz.place = (int *) malloc(sizeof(int) * tz.width * tz.height);
+    left = (int *) malloc(sizeof(int) * tz.npiece);
+    ent = (int *) malloc(sizeof(int) * 4 * tz.npiece);
+    if ((tz.sig == 0) || (tz.flatside == 0) || (tz.cls == 0) ||
+        (tz.place == 0) || (left == 0) || (ent == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (c = 0; c < tz.npiece; c++) {
+        for (k = 0; k < 4; k++)
+            tz.sig[c][k] = ws[c].sig[k];
+        tz.flatside[c] = ws[c].flatside;
+        tz.cls[c] = c;
+        left[c] = ws[c].count;
+    }
+    for (pool = 0; pool < NPOOL; pool++)
+        indexpool(&tz, pool, ent, poolentries(&tz, pool, ent, 0));
+    free(ent);
+    for (i = 0; i < tz.width * tz.height; i++)
+        tz.place[i] = -1;
+
+    for (;;) {
+        len = jn_recv(fd, &type, &buf, &buflen);
+        if ((len < 0) && (errno == 0))
+            break;          // the coordinator is done
+        job = (int *) buf;
+        if ((len < (int) (6 * sizeof(int))) || (type != MSG_TILE) ||
+            (job[0] < 0) || (job[1] < 0) || (job[2] < 1) || (job[3] < 1) ||
+            (job[2] > TILE_SIZE) || (job[3] > TILE_SIZE) ||
+            (job[4] < job[2]) || (job[4] > job[2] + TILE_HALO) ||
+            (job[5] < job[3]) || (job[5] > job[3] + TILE_HALO) ||
+            (job[0] + job[4] > tz.width) || (job[1] + job[5] > tz.height) ||
+            (len != (int) (sizeof(int) * (6 + job[4] + 1 + job[5])))) {
+            printf("Bad tile from the coordinator\n");
+            exit(1);
+        }
+        x0 = job[0];
+        y0 = job[1];
+        tw = job[2];
+        th = job[3];
+        fw = job[4];
+        fh = job[5];
+        n = 6;
+        for (i = x0 - 1; i < x0 + fw; i++, n++)
+            if ((i >= 0) && (y0 > 0))
+                tz.place[i + ((y0 - 1) * tz.width)] = job[n];
+        for (j = y0; j < y0 + fh; j++, n++)
+            if (x0 > 0)
+                tz.place[x0 - 1 + (j * tz.width)] = job[n];
+
+        filled = filltile(&tz, left, x0, y0, fw, fh);
+        for (j = 0, n = 0; j < th; j++)
+            for (i = 0; i < tw; i++)
+                lay[n++] = tz.place[x0 + i + ((y0 + j) * tz.width)];
+        if (jn_send(fd, MSG_LAYOUT, lay, filled ? sizeof(int) * n : 0) != 0) {
+            printf("Lost the coordinator\n");
+            exit(1);
+        }
+
+        // Give back the pieces and clear the tile and its border
+        for (j = y0 - 1; j < y0 + fh; j++) {
+            for (i = x0 - 1; i < x0 + fw; i++) {
+                if ((i < 0) || (j < 0) ||
+                    (tz.place[i + (j * tz.width)] < 0))
+                    continue;
+                if ((i >= x0) && (j >= y0))
+                    left[EPIECE(tz.place[i + (j * tz.width)])]++;
+                tz.place[i + (j * tz.width)] = -1;
+            }
+        }
+    }
+    free(buf);
+}
+
+
+/**************************************************************
+ * filltile(): - Fill a tile one anti-diagonal at a time given
+ * the entries along its top and left, backing up within the tile
+ * when no candidate fits.  This is the search of assemble() on a
+ * smaller grid.  The look ahead only checks positions inside the
+ * tile, as the tiles to the right and below are not known here.
+ * A tile that needs more than TILE_TRIES pieces placed is given up.
+ *
+ * Input:        shapes, pieces left of each shape, top left
+ *               position, width, and height of the tile
+ * Output:       1 if the tile is filled, 0 if nothing was placed
+ **************************************************************/
+int filltile(PUZZLE *pz, int *left, int x0, int y0, int tw, int th)
+{
+    int   order[TILE_AREA];  // position to fill at each step
+    int   cursor[TILE_AREA]; // next candidate at each step
+    int   n = 0;            // positions in the tile
+    int   k = 0;            // step, the number of pieces placed
+    long  tries = 0;        // pieces placed, counting those taken back
+    int   d;                // anti-diagonal of the tile
+    int   pos;              // position being filled
+    int   pool;             // pool searched at the position
+    int   c;                // index of the candidate in cand[]
+    int   end;              // end of the candidates for the position
+    int   e;                // candidate entry
+    int   i, j;             // position in the puzzle
+
+    for (d = 0; d < tw + th - 1; d++)
+        for (j = 0; j < th; j++)
+            if ((d - j >= 0) && (d - j < tw))
+                order[n++] = x0 + d - j + ((y0 + j) * pz->width);
+
+    if (k < n)
+        cursor[k] = pz->start[poolof(pz, order[k])][wantkey(pz, order[k])];
+    while (k < n) {
+        pos = order[k];
+        i = pos % pz->width;
+        j = pos / pz->width;
+        pool = poolof(pz, pos);
+        end = pz->start[pool][wantkey(pz, pos) + 1];
+        for (c = cursor[k]; c < end; c++) {
+            e = pz->cand[pool][c];
+            if ((left[pz->cls[EPIECE(e)]] == 0) || !fits(pz, pos, e))
+                continue;
+            pz->place[pos] = e;
+            left[pz->cls[EPIECE(e)]]--;
+            tries++;
+            if (((i + 1 >= x0 + tw) || hascandidate(pz, left, pos + 1)) &&
+                ((i > 0) || (j + 1 >= y0 + th) ||
+                 hascandidate(pz, left, pos + pz->width)))
+                break;
+            left[pz->cls[EPIECE(e)]]++;
+            pz->place[pos] = -1;
+        }
+
+        if (c < end) {
+            cursor[k] = c + 1;
+            k++;
+            if (k < n)
+                cursor[k] = pz->start[poolof(pz, order[k])][wantkey(pz, order[k])];
+        }
+        else {
+            if (k == 0)
+                return(0);
+            k--;
+            left[pz->cls[EPIECE(pz->place[order[k]])]]++;
+            pz->place[order[k]] = -1;
+        }
+
+        // Leave a tile that takes too long to the search on the
+        // coordinator, which can back up past the tile
+        if (tries > TILE_TRIES) {
+            while (k > 0) {
+                k--;
+                left[pz->cls[EPIECE(pz->place[order[k]])]]++;
+                pz->place[order[k]] = -1;
+            }
+            return(0);
+        }
+    }
+    return(1);
+}
+
+
+/**************************************************************
+ * shardname(): - Give jl_foreach() the name of piece n of the
+ * shard.
+ *
+ **************************************************************/
+void shardname(void *arg, int n, char *name, size_t len)
+{
+    PUZZLE *pz = (PUZZLE *) arg;
+
+    js_name(JS_ENTRY(pz->first + n, 0), name, len);
+}
+
+
+/**************************************************************
+ * shardpiece(): - called by jl_foreach() with the text of each
+ * .pbm file of the shard.  Parse it into the mask table.
+ *
+ **************************************************************/
+int shardpiece(void *arg, int n, const char *data, size_t len)
+{
+    PUZZLE *pz = (PUZZLE *) arg;
+    char  fname[PBMNAMELEN]; // .pbm file name
+
+    js_name(JS_ENTRY(pz->first + n, 0), fname, PBMNAMELEN);
+    if (data == 0) {
+        printf("No piece file for %s\n", fname);
+        exit(1);
+    }
+    if (jp_parsepbm(data, len, pz->edge, &pz->mask[n]) != 0) {
+        printf("Error processing file %s\n", fname);
+        exit(1);
+    }
+    return(0);
+}
+
+
+/**************************************************************
+ * classifypieces(): - Group the pieces by shape, in piece order
+ * within a shape, so the solver can treat pieces of the same
+ * shape as one shape with a count.
+ *
+ **************************************************************/
+void classifypieces(PUZZLE *pz)
+{
+    int   n;                // piece
+    int   c;                // shape
+
+    pz->cmember = (int *) malloc(sizeof(int) * pz->npiece);
+    pz->cfirst = (int *) calloc(pz->nclass + 1, sizeof(int));
+    if ((pz->cmember == 0) || (pz->cfirst == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (n = 0; n < pz->npiece; n++)
+        pz->cfirst[pz->cls[n]]++;
+    for (c = 1; c <= pz->nclass; c++)
+        pz->cfirst[c] += pz->cfirst[c - 1];
+    for (n = pz->npiece - 1; n >= 0; n--)
+        pz->cmember[--pz->cfirst[pz->cls[n]]] = n;
+    printf("%-10s %10d of %d pieces\n", "shapes", pz->nclass, pz->npiece);
+}
+
+
+/**************************************************************
+ * indexpieces(): - Sort the entries of each pool into buckets,
+ * or merge the partial indexes of the workers.  The border pools
+ * hold each border or corner piece only at the rotations that
+ * put a straight side on that border, so the positions on the
+ * right and bottom borders see a few entries instead of every
+ * entry with the right key pair.
+ *
+ **************************************************************/
+void indexpieces(PUZZLE *pz)
+{
+    int  *ent;              // entries in a pool
+    int   nent;             // number of entries in a pool
+    int   pool;             // pool being built
+
+    if (pz->nworker > 0) {
+        mergeindex(pz);
+        return;
+    }
+    ent = (int *) malloc(sizeof(int) * pz->npiece * 4);
+    if (ent == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+
+    for (pool = 0; pool < NPOOL; pool++) {
+        nent = poolentries(pz, pool, ent, 1);
+        indexpool(pz, pool, ent, nent);
+    }
+    free(ent);
+}
+
+
+/**************************************************************
+ * poolentries(): - List the entries of a pool in piece order.
+ * The border pools hold each border or corner piece only at the
+ * rotations that put a straight side on that border.
+ *
+ * Input:        puzzle, pool, where to put the entries, set to
+ *               list only the piece that stands for each shape
+ * Output:       number of entries
+ **************************************************************/
+int poolentries(PUZZLE *pz, int pool, int *ent, int shapes)
+{
+    int   nent = 0;         // entries listed
+    int   n;                // piece
+
+    for (n = 0; n < pz->npiece; n++) {
+        // One piece stands for all the pieces of its shape
+        if (shapes && (pz->cmember[pz->cfirst[pz->cls[n]]] != n))
+            continue;
+        nent += pieceentries(pz, pool, n, &ent[nent]);
+    }
+    return(nent);
+}
+
+
+/**************************************************************
+ * pieceentries(): - List the entries of one piece in a pool
+ *
+ * Input:        puzzle, pool, piece, where to put the entries
+ * Output:       number of entries, at most 4
+ **************************************************************/
+int pieceentries(PUZZLE *pz, int pool, int n, int *ent)
+{
+    int   nent = 0;         // entries listed
+    int   k;                // side
+
+    for (k = 0; k < 4; k++) {
+        // Turn straight side k to the border of the pool
+        if ((pool == POOL_ALL) || ((pz->flatside[n] >> k) & 1))
+            ent[nent++] = ENTRY(n, (pool == POOL_ALL) ? k :
+                                ((k - pool + 4) % 4));
+    }
+    return(nent);
+}
+
+
+/**************************************************************
+ * mergeindex(): - Build the index from the buckets the workers
+ * own.  For each key pair the buckets of the workers are joined
+ * in worker order, keeping only the piece that stands for each
+ * shape.  Each bucket is in piece order, so this gives the same
+ * entries as indexpool() does.
+ *
+ **************************************************************/
+void mergeindex(PUZZLE *pz)
+{
+    SHARD *sh;              // a worker's shard
+    int  *start;            // first candidate for each key pair
+    int  *cand;             // entries sorted by key pair
+    int   ncand;            // entries in cand[]
+    int   pool;             // pool being built
+    int   key;              // key pair
+    int   w;                // worker
+    int   x;                // index into a shard's bucket
+    int   e;                // entry
+
+    for (pool = 0; pool < NPOOL; pool++) {
+        ncand = 0;
+        for (w = 0; w < pz->nworker; w++)
+            ncand += pz->shard[w].start[pool][pz->nkey];
+        start = (int *) malloc(sizeof(int) * (pz->nkey + 1));
+        cand = (int *) malloc(sizeof(int) * (ncand + 1));
+        if ((start == 0) || (cand == 0)) {
+            printf("malloc failure\n");
+            exit(1);
+        }
+        ncand = 0;
+        for (key = 0; key < pz->nkey; key++) {
+            start[key] = ncand;
+            for (w = 0; w < pz->nworker; w++) {
+                sh = &pz->shard[w];
+                for (x = sh->start[pool][key]; x < sh->start[pool][key + 1]; x++) {
+                    e = sh->cand[pool][x];
+                    if (pz->cmember[pz->cfirst[pz->cls[EPIECE(e)]]] == EPIECE(e))
+                        cand[ncand++] = e;
+                }
+            }
+        }
+        start[pz->nkey] = ncand;
+        pz->start[pool] = start;
+        pz->cand[pool] = cand;
+        for (w = 0; w < pz->nworker; w++) {
+            free(pz->shard[w].start[pool]);
+            free(pz->shard[w].cand[pool]);
+        }
+    }
+}
+
+
+/**************************************************************
+ * indexpool(): - Sort the entries of a pool into buckets by the
+ * key pair of their left and top sides.  A key pair is at most
+ * 12 bits so the buckets are a dense array addressed by the
+ * pair, in compressed sparse row form: the entries for pair k
+ * are cand[start[k]] up to cand[start[k + 1] - 1].
+ *
+ **************************************************************/
+void indexpool(PUZZLE *pz, int pool, int *ent, int nent)
+{
+    unsigned *key;          // key pair of each entry
+    int  *start;            // first candidate for each key pair
+    int  *cand;             // entries sorted by key pair
+    int   x;                // index into ent
+    int   k;                // key pair
+
+    start = (int *) calloc(pz->nkey + 1, sizeof(int));
+    cand = (int *) malloc(sizeof(int) * (nent + 1));
+    key = (unsigned *) malloc(sizeof(unsigned) * (nent + 1));
+    if ((start == 0) || (cand == 0) || (key == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+
+    // Count the entries with each key pair, then turn the counts
+    // into the end of each bucket and fill the buckets from the end
+    // back so each lists its entries in piece order.
+    for (x = 0; x < nent; x++) {
+        key[x] = keypair(pz, ent[x]);
+        start[key[x]]++;
+    }
+    for (k = 1; k <= pz->nkey; k++)
+        start[k] += start[k - 1];
+    for (x = nent - 1; x >= 0; x--)
+        cand[--start[key[x]]] = ent[x];
+
+    free(key);
+    pz->start[pool] = start;
+    pz->cand[pool] = cand;
+}
+
+
+/**************************************************************
+ * keypair(): - Return the key pair of the left and top sides of
+ * an entry, the bucket it is indexed under.
+ *
+ **************************************************************/
+unsigned keypair(PUZZLE *pz, int e)
+{
+    return(jp_sigkey(SIDE(pz, e, JP_LEFT), pz->edge) |
+           (jp_sigkey(SIDE(pz, e, JP_TOP), pz->edge) << pz->keybits));
+}
+
+
+/**************************************************************
+ * poolof(): - Return the pool to search for a position
+ *
+ **************************************************************/
+int poolof(PUZZLE *pz, int pos)
+{
+    if (pos % pz->width == pz->width - 1)
+        return(JP_RIGHT);
+    else if (pos / pz->width == pz->height - 1)
+        return(JP_BOTTOM);
+    else if (pos < pz->width)
+        return(JP_TOP);
+    else if (pos % pz->width == 0)
+        return(JP_LEFT);
+    return(POOL_ALL);
+}
+
+
+/**************************************************************
+ * assemble(): - Place the pieces by the search of growrun(),
+ * which grows the layout from the top left corner filling the
+ * most constrained position next.  With workers the tiles, with
+ * -m the two halves from meet(), or with more than one thread
+ * the wavefront, place as many pieces as they can first, and
+ * those along the anti-diagonals from the corner that fit are
+ * kept as the first steps of the search.  The search gives up
+ * after GROW_TRIES pieces placed for each position.
+ *
+ * Output:       0 if every position is filled, -1 if not
+ **************************************************************/
+int assemble(PUZZLE *pz)
+{
+    GROW  g;                // the search
+    int  *left;             // pieces of each shape not yet placed
+    int  *order;            // positions in anti-diagonal order
+    int  *rank;             // place of each position in order[]
+    int  *next;             // next candidate at each position, for
+                            // the tiles, halves, or wavefront
+    int  *lay;              // the layout they found
+    int   k = 0;            // pieces of it that are kept
+    int   pos;              // position in the puzzle
+    int   c;                // shape
+    int   ret;              // result of the search
+
+    left = (int *) malloc(sizeof(int) * pz->nclass);
+    order = (int *) malloc(sizeof(int) * pz->npiece);
+    rank = (int *) malloc(sizeof(int) * pz->npiece);
+    next = (int *) malloc(sizeof(int) * pz->npiece);
+    lay = (int *) malloc(sizeof(int) * pz->npiece);
+    pz->place = (int *) malloc(sizeof(int) * pz->npiece);
+    if ((left == 0) || (order == 0) || (rank == 0) || (next == 0) ||
+        (lay == 0) || (pz->place == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (pos = 0; pos < pz->npiece; pos++)
+        pz->place[pos] = -1;
+    for (c = 0; c < pz->nclass; c++)
+        left[c] = pz->cfirst[c + 1] - pz->cfirst[c];
+    fillorder(pz, order);
+    for (k = 0; k < pz->npiece; k++)
+        rank[order[k]] = k;
+
+    // Let the workers' tiles, the halves, or the wavefront place what
+    // they can, then give back their pieces and replay them into the
+    // search, which checks each against its neighbours and the counts
+    k = 0;
+    if ((pz->nworker > 0) || pz->meet || (pz->nthread > 1)) {
+        if (pz->nworker > 0)
+            tiles(pz, left, next);
+        else if (pz->meet)
+            meet(pz, left, next);
+        else
+            wavefront(pz, left, next);
+        for (pos = 0; pos < pz->npiece; pos++) {
+            lay[pos] = pz->place[pos];
+            if (lay[pos] >= 0)
+                left[pz->cls[EPIECE(lay[pos])]]++;
+            pz->place[pos] = -1;
+        }
+    }
+    growinit(&g, pz, left, rank, pz->npiece);
+    if ((pz->nworker > 0) || pz->meet || (pz->nthread > 1)) {
+        while ((k < pz->npiece) && (lay[order[k]] >= 0) &&
+               growreplay(&g, order[k], lay[order[k]]))
+            k++;
+        printf("%-10s %10d of %d pieces\n", "replayed", k, pz->npiece);
+    }
+
+    ret = growrun(&g, (long) GROW_TRIES * pz->npiece);
+    printf("%-10s %10ld nodes %ld backtracks\n", "search", g.nodes, g.backtracks);
+    ret = ((ret == 1) && jg_is_complete(&g.grid)) ? 0 : -1;
+    if (ret == 0)
+        unfold(pz);
+    growfree(&g);
+    free(left);
+    free(order);
+    free(rank);
+    free(next);
+    free(lay);
+    return(ret);
+}
+
+
+/**************************************************************
+ * growinit(): - Set up the search of assemble() on a puzzle or a
+ * view of it.  Pieces already in pz->place[] are put on the grid
+ * and stay there, and the open positions ranked below nrank are
+ * the ones to fill.  The counts of keys and corners only balance
+ * when every open position is to be filled, so they are checked
+ * only then.
+ *
+ * Input:        search state, puzzle, pieces left of each shape,
+ *               rank of each position, positions ranked below
+ *               this are filled
+ **************************************************************/
+void growinit(GROW *g, PUZZLE *pz, int *left, int *rank, int nrank)
+{
+    int   nkey = 1 << pz->keybits; // number of keys of one side
+    int   pos;              // position in the puzzle
+    int   e;                // entry at the position
+    int   c;                // shape
+    int   k;                // side
+    int   q;                // neighbour on side k
+    unsigned sig;           // signature of side k
+
+    memset(g, 0, sizeof(*g));
+    g->pz = pz;
+    g->left = left;
+    g->rank = rank;
+    g->nrank = nrank;
+    g->order = (int *) malloc(sizeof(int) * pz->npiece);
+    g->pair = (int *) malloc(sizeof(int) * pz->npiece);
+    g->cursor = (int *) malloc(sizeof(int) * pz->npiece);
+    g->lstart = (int *) calloc(pz->npiece + 1, sizeof(int));
+    g->count = (int *) malloc(sizeof(int) * pz->npiece);
+    g->known = (int *) malloc(sizeof(int) * pz->npiece);
+    g->front = (int *) malloc(sizeof(int) * pz->npiece);
+    g->fslot = (int *) malloc(sizeof(int) * pz->npiece);
+    g->matek = (unsigned *) malloc(sizeof(unsigned) * nkey);
+    g->supply = (int *) calloc(nkey, sizeof(int));
+    g->demand = (int *) calloc(nkey, sizeof(int));
+    g->stepof = (int *) malloc(sizeof(int) * pz->npiece);
+    g->lastuse = (int *) malloc(sizeof(int) * pz->nclass);
+    g->prevuse = (int *) malloc(sizeof(int) * pz->npiece);
+    g->blame = (int **) calloc(pz->npiece, sizeof(int *));
+    g->nblame = (int *) calloc(pz->npiece, sizeof(int));
+    g->ablame = (int *) calloc(pz->npiece, sizeof(int));
+    g->global = (char *) calloc(pz->npiece, sizeof(char));
+    g->seen = (int *) calloc(pz->npiece, sizeof(int));
+    if ((g->order == 0) || (g->pair == 0) || (g->cursor == 0) ||
+        (g->lstart == 0) || (g->count == 0) || (g->known == 0) || (g->front == 0) ||
+        (g->fslot == 0) || (g->matek == 0) || (g->supply == 0) ||
+        (g->demand == 0) || (g->stepof == 0) || (g->lastuse == 0) ||
+        (g->prevuse == 0) || (g->blame == 0) || (g->nblame == 0) ||
+        (g->ablame == 0) || (g->global == 0) || (g->seen == 0) ||
+        (jg_init(&g->grid, pz->width, pz->height, pz->edge) != 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (k = 0; k < nkey; k++)
+        g->matek[k] = jp_matekey(k << 1, pz->edge);
+    for (pos = 0; pos < pz->npiece; pos++)
+        g->stepof[pos] = -1;
+    for (c = 0; c < pz->nclass; c++)
+        g->lastuse[c] = -1;
+
+    // Count the sides and corner cells of the unused pieces, the
+    // sides the open positions want, and the vertices of the grid
+    // whose corner cell no piece has yet
+    g->whole = 1;
+    g->unowned = (pz->width + 1) * (pz->height + 1);
+    for (c = 0; c < pz->nclass; c++) {
+        for (k = 0; k < 4; k++) {
+            sig = pz->sig[pz->cmember[pz->cfirst[c]]][k];
+            g->supply[jp_sigkey(sig, pz->edge)] += left[c];
+            g->corners += (sig & 1) * left[c];
+        }
+    }
+    for (pos = 0; pos < pz->npiece; pos++) {
+        e = pz->place[pos];
+        if (e >= 0) {
+            if (jg_place(&g->grid, pz->mask[EPIECE(e)], pos, EROT(e)) != JG_OK) {
+                printf("Pieces given to the search do not fit\n");
+                exit(1);
+            }
+            for (k = 0; k < 4; k++)
+                g->unowned -= SIDE(pz, e, k) & 1;
+            continue;
+        }
+        if (rank[pos] < nrank)
+            g->nopen++;
+        else
+            g->whole = 0;
+        for (k = 0; k < 4; k++) {
+            q = neighbour(pz, pos, k);
+            if (q < 0)
+                g->demand[pz->flat]++;
+            else if (pz->place[q] >= 0)
+                g->demand[g->matek[jp_sigkey(SIDE(pz, pz->place[q], (k + 2) % 4),
+                                             pz->edge)]]++;
+        }
+    }
+    for (pos = 0; pos < pz->npiece; pos++) {
+        g->fslot[pos] = -1;
+        growfront(g, pos);
+    }
+}
+
+
+/**************************************************************
+ * growfree(): - Free a search state and its grid
+ *
+ **************************************************************/
+void growfree(GROW *g)
+{
+    int   k;                // step
+
+    jg_free(&g->grid);
+    free(g->order);
+    free(g->pair);
+    free(g->cursor);
+    free(g->lstart);
+    free(g->list);
+    free(g->rate);
+    free(g->count);
+    free(g->known);
+    free(g->front);
+    free(g->fslot);
+    free(g->matek);
+    free(g->supply);
+    free(g->demand);
+    for (k = 0; k < g->pz->npiece; k++)
+        free(g->blame[k]);
+    free(g->stepof);
+    free(g->lastuse);
+    free(g->prevuse);
+    free(g->blame);
+    free(g->nblame);
+    free(g->ablame);
+    free(g->global);
+    free(g->seen);
+}
+
+
+/**************************************************************
+ * growrun(): - Search on from the steps taken so far until every
+ * position to fill is filled.  Each step fills the position in
+ * front[] with the fewest candidates, trying them in the order
+ * growlist() puts them in, and a piece is kept only if every
+ * open position next to it still has a candidate and the counts
+ * of keys and corners still balance.
+ *   When nothing fits, going back one step would mostly try again
+ * pieces far from the trouble, since the wrong piece is often
+ * many steps back.  Instead each step keeps in blame[] the
+ * earlier steps its failures depend on: those that placed the
+ * pieces around it, and around any position it left with no
+ * candidate, and those that used up a shape it wanted.  The
+ * search goes back to the last of them, which takes the blame of
+ * the failed step, and tries its next candidate.  The steps taken
+ * before, such as those replayed by growreplay(), are tried again
+ * in the same way, but the pieces placed before growinit() stay.
+ *
+ * Input:        search state, most pieces to place, 0 for no limit
+ * Output:       1 if filled, 0 if there is no way to fill it,
+ *               -1 if it gave up or was stopped
+ **************************************************************/
+int growrun(GROW *g, long limit)
+{
+    PUZZLE *pz = g->pz;     // the puzzle being solved
+    int   fresh = 1;        // set when step k needs a position
+    int   k;                // step
+    int   pos;              // position being filled
+    int   c;                // index of the candidate in list[]
+    int   end;              // end of the candidates for the position
+    int   e;                // candidate entry
+    int   j;                // step to go back to
+    int   x;                // index into blame[]
+
+    while (g->nopen > 0) {
+        k = g->k;
+        if (fresh) {
+            pos = growchoose(g, &g->pair[k]);
+            g->order[k] = pos;
+            g->nblame[k] = 0;
+            g->global[k] = 0;
+            g->stamp++;
+            if (pos >= 0)
+                growlist(g, pos, g->pair[k]);
+            else {
+                g->global[k] = 1;
+                g->lstart[k + 1] = g->lstart[k];
+            }
+            g->cursor[k] = g->lstart[k];
+        }
+        pos = g->order[k];
+        c = g->cursor[k];
+        end = g->lstart[k + 1];
+
+        // Place the next candidate and move on to the next step.
+        // growlist() tried each of them in this same state, so it
+        // fits and keeps a candidate for the positions around it.
+        if (c < end) {
+            e = g->list[c];
+            jg_place(&g->grid, pz->mask[EPIECE(e)], pos, EROT(e));
+            growput(g, pos, e);
+            g->nodes++;
+            g->cursor[k] = c + 1;
+            g->k++;
+            fresh = 1;
+            if (((limit > 0) && (g->nodes >= limit)) ||
+                (g->stop && __atomic_load_n(g->stop, __ATOMIC_RELAXED)))
+                return(-1);
+            continue;
+        }
+
+        // Nothing fits.  Go back to the last step to blame, taking
+        // back the steps after it, and try the next candidate there.
+        if (pos >= 0)
+            growblamearound(g, pos);
+        j = -1;
+        if (g->global[k])
+            j = k - 1;
+        else {
+            for (x = 0; x < g->nblame[k]; x++)
+                if (g->blame[k][x] > j)
+                    j = g->blame[k][x];
+        }
+        if (j < 0)
+            return(0);
+        while (g->k > j) {
+            g->k--;
+            growtake(g, g->order[g->k]);
+        }
+        g->stamp++;
+        for (x = 0; x < g->nblame[j]; x++)
+            g->seen[g->blame[j][x]] = g->stamp;
+        for (x = 0; x < g->nblame[k]; x++)
+            growblame(g, g->blame[k][x]);
+        g->global[j] |= g->global[k];
+        g->backtracks++;
+        fresh = 0;
+    }
+    return(1);
+}
+
+
+/**************************************************************
+ * growblame(): - Add an earlier step to the blame of step k, the
+ * step being filled.  seen[] has the stamp of the steps already
+ * in its blame.
+ *
+ **************************************************************/
+void growblame(GROW *g, int step)
+{
+    int   k = g->k;         // step being filled
+
+    if ((step < 0) || (step >= k) || (g->seen[step] == g->stamp))
+        return;
+    if (g->nblame[k] == g->ablame[k]) {
+        g->ablame[k] = (g->ablame[k] == 0) ? 16 : 2 * g->ablame[k];
+        g->blame[k] = (int *) realloc(g->blame[k], sizeof(int) * g->ablame[k]);
+        if (g->blame[k] == 0) {
+            printf("malloc failure\n");
+            exit(1);
+        }
+    }
+    g->blame[k][g->nblame[k]++] = step;
+    g->seen[step] = g->stamp;
+}
+
+
+/**************************************************************
+ * growblamearound(): - Blame the steps that placed the pieces
+ * around a position, which fix the keys and corner cells it
+ * wants and the cells its piece may not overlap.
+ *
+ **************************************************************/
+void growblamearound(GROW *g, int pos)
+{
+    PUZZLE *pz = g->pz;     // the puzzle being solved
+    int   i, j;             // position in the puzzle
+    int   di, dj;           // offset of a position around it
+
+    i = pos % pz->width;
+    j = pos / pz->width;
+    for (dj = -1; dj <= 1; dj++) {
+        for (di = -1; di <= 1; di++) {
+            if ((i + di >= 0) && (i + di < pz->width) &&
+                (j + dj >= 0) && (j + dj < pz->height))
+                growblame(g, g->stepof[pos + di + (dj * pz->width)]);
+        }
+    }
+}
+
+
+/**************************************************************
+ * growblameshape(): - Blame the steps that used up the pieces of
+ * a shape.
+ *
+ **************************************************************/
+void growblameshape(GROW *g, int c)
+{
+    int   step;             // step that placed a piece of shape c
+
+    for (step = g->lastuse[c]; step >= 0; step = g->prevuse[step])
+        growblame(g, step);
+}
+
+
+/**************************************************************
+ * growblameempty(): - Blame what left a position with no
+ * candidate: the pieces around it, and the steps that used up
+ * the shapes that would fit there.
+ *
+ **************************************************************/
+void growblameempty(GROW *g, int pos)
+{
+    PUZZLE *pz = g->pz;     // the puzzle being solved
+    int   want[4];          // key wanted on each side, or -1
+    int   corner[4];        // corner cell wanted, see vertexwant()
+    int   s;                // first of the two known sides looked up
+    unsigned key;           // key pair of the bucket
+    int   c;                // index of the candidate in cand[]
+    int   e;                // candidate entry
+
+    growblamearound(g, pos);
+    if (growcount(g, pos, &s) < 0)
+        return;
+    growwants(g, pos, want, corner);
+    key = want[s] | (want[(s + 1) % 4] << pz->keybits);
+    for (c = pz->start[POOL_ALL][key]; c < pz->start[POOL_ALL][key + 1]; c++) {
+        e = TURNBACK(pz->cand[POOL_ALL][c], s);
+        if ((g->left[pz->cls[EPIECE(e)]] == 0) && growfits(g, e, want, corner))
+            growblameshape(g, pz->cls[EPIECE(e)]);
+    }
+}
+
+
+/**************************************************************
+ * growreplay(): - Place an entry found some other way as the
+ * next step, if it fits and keeps a candidate for the positions
+ * around it.  The entry is put first in the list of candidates
+ * of the step, so the search tries the others if it backs up to
+ * it.
+ *
+ * Output:       1 if it is placed, 0 if not
+ **************************************************************/
+int growreplay(GROW *g, int pos, int e)
+{
+    PUZZLE *pz = g->pz;     // the puzzle being solved
+    int   k = g->k;         // step
+    int   s;                // first of the two known sides looked up
+    int   c;                // index of the entry in list[]
+
+    if ((pz->place[pos] >= 0) || (growcount(g, pos, &s) <= 0))
+        return(0);
+    g->nblame[k] = 0;
+    g->global[k] = 0;
+    g->stamp++;
+    growlist(g, pos, s);
+    for (c = g->lstart[k]; (c < g->lstart[k + 1]) && (g->list[c] != e); c++)
+        ;
+    if (c == g->lstart[k + 1])
+        return(0);
+    for ( ; c > g->lstart[k]; c--)
+        g->list[c] = g->list[c - 1];
+    g->list[c] = e;
+    jg_place(&g->grid, pz->mask[EPIECE(e)], pos, EROT(e));
+    growput(g, pos, e);
+    g->order[k] = pos;
+    g->pair[k] = s;
+    g->cursor[k] = c + 1;
+    g->k++;
+    return(1);
+}
+
+
+/**************************************************************
+ * growlist(): - List the candidates of step k at a position, in
+ * g->list[] from g->lstart[k], looking in the bucket for the two
+ * known sides from s.  A candidate is listed if it fits and
+ * keeps a candidate for the positions around it, so the list is
+ * made by placing each of them and taking it back.  The earlier
+ * steps that rule out the others are added to the blame of the
+ * step.  The list is sorted so the candidates that leave the
+ * most candidates for the positions around them come first: a
+ * wrong piece seldom leaves the next position more than a
+ * chance fit, while the right one leaves the right piece there
+ * as well.
+ *
+ * Output:       number of candidates listed
+ **************************************************************/
+int growlist(GROW *g, int pos, int s)
+{
+    PUZZLE *pz = g->pz;     // the puzzle being solved
+    int   k = g->k;         // step
+    int   n = 0;            // candidates listed
+    int   want[4];          // key wanted on each side, or -1
+    int   corner[4];        // corner cell wanted, see vertexwant()
+    unsigned key;           // key pair of the bucket
+    int   c;                // index of the candidate in cand[]
+    int   e;                // candidate entry
+    int   empty;            // position left with no candidate, or -1
+    int   size;             // entries in the bucket
+
+    growwants(g, pos, want, corner);
+    key = want[s] | (want[(s + 1) % 4] << pz->keybits);
+    size = pz->start[POOL_ALL][key + 1] - pz->start[POOL_ALL][key];
+    if (g->lstart[k] + size > g->nlist) {
+        g->nlist = 2 * (g->lstart[k] + size);
+        g->list = (int *) realloc(g->list, sizeof(int) * g->nlist);
+        g->rate = (long *) realloc(g->rate, sizeof(long) * g->nlist);
+        if ((g->list == 0) || (g->rate == 0)) {
+            printf("malloc failure\n");
+            exit(1);
+        }
+    }
+
+    for (c = pz->start[POOL_ALL][key]; c < pz->start[POOL_ALL][key + 1]; c++) {
+        e = TURNBACK(pz->cand[POOL_ALL][c], s);
+        if (!growfits(g, e, want, corner))
+            continue;
+        if (g->left[pz->cls[EPIECE(e)]] == 0) {
+            growblameshape(g, pz->cls[EPIECE(e)]);
+            continue;
+        }
+        if (jg_place(&g->grid, pz->mask[EPIECE(e)], pos, EROT(e)) != JG_OK)
+            continue;
+        growput(g, pos, e);
+        g->nodes++;
+        if (growcheck(g, pos, &empty)) {
+            // Rate it, keeping the bucket order among equals
+            g->list[g->lstart[k] + n] = e;
+            g->rate[n] = ((long) growrate(g, pos) << 32) | (long) (size - n);
+            n++;
+        }
+        else if (empty < 0)
+            g->global[k] = 1;
+        else
+            growblameempty(g, empty);
+        growtake(g, pos);
+    }
+    qsort(g->rate, n, sizeof(long), ratecmp);
+    for (c = 0; c < n; c++)
+        g->rate[c] = g->list[g->lstart[k] + size - (g->rate[c] & 0xffffffff)];
+    for (c = 0; c < n; c++)
+        g->list[g->lstart[k] + c] = (int) g->rate[c];
+    g->lstart[k + 1] = g->lstart[k] + n;
+    return(n);
+}
+
+
+/**************************************************************
+ * growrate(): - Rate the piece just placed at a position by the
+ * candidates left at the open positions around it.
+ *
+ * Output:       sum of the counts of the positions in front[]
+ **************************************************************/
+int growrate(GROW *g, int pos)
+{
+    PUZZLE *pz = g->pz;     // the puzzle being solved
+    int   rate = 0;         // sum of the counts
+    int   i, j;             // position in the puzzle
+    int   di, dj;           // offset of a position around it
+    int   q;                // position around pos
+
+    i = pos % pz->width;
+    j = pos / pz->width;
+    for (dj = -1; dj <= 1; dj++) {
+        for (di = -1; di <= 1; di++) {
+            if ((i + di < 0) || (i + di >= pz->width) ||
+                (j + dj < 0) || (j + dj >= pz->height))
+                continue;
+            q = pos + di + (dj * pz->width);
+            if (g->fslot[q] >= 0)
+                rate += g->count[q];
+        }
+    }
+    return(rate);
+}
+
+
+/**************************************************************
+ * ratecmp(): - Compare two ratings for qsort(), highest first
+ *
+ **************************************************************/
+int ratecmp(const void *a, const void *b)
+{
+    long  ra = *(const long *) a;
+    long  rb = *(const long *) b;
+
+    return((ra < rb) - (ra > rb));
+}
+
+
+/**************************************************************
+ * growchoose(): - Return the position in front[] with the fewest
+ * candidates, the most constrained, so forced positions are
+ * filled first and one with nothing left is found at once.  Ties
+ * go to the position with more known sides, then to the lowest
+ * rank.  The counts of positions away from the last pieces placed
+ * may be out of date, so the one chosen is counted again, and
+ * chosen again if its count has changed.
+ *
+ * Output:       position, or -1 if front[] is empty, and the first
+ *               of the two known sides to look up its candidates by
+ **************************************************************/
+int growchoose(GROW *g, int *pair)
+{
+    int   best;             // position chosen
+    int   pos;              // position in front[]
+    int   n;                // candidates at best counted again
+    int   x;                // index into front[]
+
+    if (g->nfront == 0)
+        return(-1);
+    while (1) {
+        best = g->front[0];
+        for (x = 1; x < g->nfront; x++) {
+            pos = g->front[x];
+            if ((g->count[pos] < g->count[best]) ||
+                ((g->count[pos] == g->count[best]) &&
+                 ((g->known[pos] > g->known[best]) ||
+                  ((g->known[pos] == g->known[best]) &&
+                   (g->rank[pos] < g->rank[best])))))
+                best = pos;
+        }
+        n = growcount(g, best, pair);
+        if (n == g->count[best])
+            return(best);
+        g->count[best] = n;
+    }
+}
+
+
+/**************************************************************
+ * growcount(): - Count the unused entries that fit at a position,
+ * up to GROW_CAP, looking in the smallest bucket for two of its
+ * known sides next to each other.  Every entry is in POOL_ALL at
+ * each of its turns, so the bucket for sides s and s + 1 is the
+ * bucket for the left and top sides of the entries turned a
+ * quarter clockwise s + 1 times.
+ *
+ * Output:       number of candidates, or -1 if no two known sides
+ *               are next to each other, and the first of the two
+ *               sides used
+ **************************************************************/
+int growcount(GROW *g, int pos, int *pair)
+{
+    PUZZLE *pz = g->pz;     // the puzzle being solved
+    int   want[4];          // key wanted on each side, or -1
+    int   corner[4];        // corner cell wanted, see vertexwant()
+    int   best = -1;        // first side of the smallest bucket
+    int   size = 0;         // entries in the smallest bucket
+    int   n = 0;            // candidates counted
+    unsigned key;           // key pair of a bucket
+    int   s;                // first of two sides next to each other
+    int   c;                // index of the candidate in cand[]
+    int   e;                // candidate entry
+
+    growwants(g, pos, want, corner);
+    for (s = 0; s < 4; s++) {
+        if ((want[s] < 0) || (want[(s + 1) % 4] < 0))
+            continue;
+        key = want[s] | (want[(s + 1) % 4] << pz->keybits);
+        if ((best < 0) ||
+            (pz->start[POOL_ALL][key + 1] - pz->start[POOL_ALL][key] < size)) {
+            best = s;
+            size = pz->start[POOL_ALL][key + 1] - pz->start[POOL_ALL][key];
+        }
+    }
+    if (pair)
+        *pair = best;
+    if (best < 0)
+        return(-1);
+
+    key = want[best] | (want[(best + 1) % 4] << pz->keybits);
+    for (c = pz->start[POOL_ALL][key]; c < pz->start[POOL_ALL][key + 1]; c++) {
+        e = TURNBACK(pz->cand[POOL_ALL][c], best);
+        if ((g->left[pz->cls[EPIECE(e)]] > 0) && growfits(g, e, want, corner) &&
+            (++n == GROW_CAP))
+            break;
+    }
+    return(n);
+}
+
+
+/**************************************************************
+ * growwants(): - Get the key wanted on each side of a position,
+ * from the border or the placed piece on that side, and the
+ * corner cell wanted at each of its corners.
+ *
+ * Output:       number of known sides, want[] and corner[]
+ **************************************************************/
+int growwants(GROW *g, int pos, int *want, int *corner)
+{
+    PUZZLE *pz = g->pz;     // the puzzle being solved
+    int   i, j;             // position in the puzzle
+    int   n = 0;            // known sides
+    int   k;                // side or corner
+    int   q;                // neighbour on side k
+
+    i = pos % pz->width;
+    j = pos / pz->width;
+    for (k = 0; k < 4; k++) {
+        q = neighbour(pz, pos, k);
+        if (q < 0)
+            want[k] = pz->flat;
+        else if (pz->place[q] >= 0)
+            want[k] = g->matek[jp_sigkey(SIDE(pz, pz->place[q], (k + 2) % 4),
+                                         pz->edge)];
+        else
+            want[k] = -1;
+        n += (want[k] >= 0);
+        corner[k] = vertexwant(pz, i + ((k == 1) || (k == 2)), j + (k >= 2), pos);
+    }
+    return(n);
+}
+
+
+/**************************************************************
+ * growfits(): - Check an entry against the keys and corner cells
+ * wanted at a position.  Corner k of a piece is bit 0 of its side
+ * k, as a signature starts at the clockwise start of the side.
+ *
+ * Output:       1 if the entry can go at the position
+ **************************************************************/
+int growfits(GROW *g, int e, int *want, int *corner)
+{
+    PUZZLE *pz = g->pz;     // the puzzle being solved
+    unsigned sig;           // signature of side k
+    int   k;                // side or corner
+
+    for (k = 0; k < 4; k++) {
+        sig = SIDE(pz, e, k);
+        if ((want[k] >= 0) && (jp_sigkey(sig, pz->edge) != (unsigned) want[k]))
+            return(0);
+        if ((corner[k] != 2) && ((int) (sig & 1) != corner[k]))
+            return(0);
+    }
+    return(1);
+}
+
+
+/**************************************************************
+ * vertexwant(): - Return what a piece at pos must have at the
+ * corner at vertex (vx, vy): 0 if a placed piece has it, 1 if
+ * every other piece there is placed without it, 2 for either.
+ * This is cornerwant() for the layout in pz->place[].
+ *
+ **************************************************************/
+int vertexwant(PUZZLE *pz, int vx, int vy, int pos)
+{
+    int   open = 0;         // other open positions at the vertex
+    int   k;                // corner of the piece at the vertex
+    int   i, j;             // position of the piece
+    int   q;                // position in the puzzle
+
+    for (k = 0; k < 4; k++) {
+        i = vx - ((k == 1) || (k == 2));
+        j = vy - (k >= 2);
+        if ((i < 0) || (j < 0) || (i >= pz->width) || (j >= pz->height))
+            continue;
+        q = i + (j * pz->width);
+        if (q == pos)
+            continue;
+        if (pz->place[q] < 0)
+            open++;
+        else if (SIDE(pz, pz->place[q], k) & 1)
+            return(0);
+    }
+    return(open ? 2 : 1);
+}
+
+
+/**************************************************************
+ * growput(): - Place an entry already on the grid at a position
+ * as step g->k, and update the counts and front[] around it.
+ *
+ **************************************************************/
+void growput(GROW *g, int pos, int e)
+{
+    PUZZLE *pz = g->pz;     // the puzzle being solved
+    unsigned sig;           // signature of side k
+    unsigned key;           // key of side k
+    int   k;                // side
+    int   q;                // neighbour on side k
+
+    pz->place[pos] = e;
+    g->left[pz->cls[EPIECE(e)]]--;
+    g->nopen--;
+    g->stepof[pos] = g->k;
+    g->prevuse[g->k] = g->lastuse[pz->cls[EPIECE(e)]];
+    g->lastuse[pz->cls[EPIECE(e)]] = g->k;
+
+    // A known side of pos is no longer wanted, and an open
+    // neighbour now wants the mate of the side it touches
+    for (k = 0; k < 4; k++) {
+        sig = SIDE(pz, e, k);
+        key = jp_sigkey(sig, pz->edge);
+        g->supply[key]--;
+        g->corners -= sig & 1;
+        g->unowned -= sig & 1;
+        q = neighbour(pz, pos, k);
+        if ((q < 0) || (pz->place[q] >= 0))
+            g->demand[key]--;
+        else
+            g->demand[g->matek[key]]++;
+    }
+    growaround(g, pos);
+}
+
+
+/**************************************************************
+ * growtake(): - Take back the piece growput() placed at a
+ * position, and take it off the grid.  Pieces must be taken back
+ * in the reverse order they were placed.
+ *
+ **************************************************************/
+void growtake(GROW *g, int pos)
+{
+    PUZZLE *pz = g->pz;     // the puzzle being solved
+    unsigned sig;           // signature of side k
+    unsigned key;           // key of side k
+    int   e;                // entry placed at pos
+    int   k;                // side
+    int   q;                // neighbour on side k
+
+    e = pz->place[pos];
+    for (k = 0; k < 4; k++) {
+        sig = SIDE(pz, e, k);
+        key = jp_sigkey(sig, pz->edge);
+        g->supply[key]++;
+        g->corners += sig & 1;
+        g->unowned += sig & 1;
+        q = neighbour(pz, pos, k);
+        if ((q < 0) || (pz->place[q] >= 0))
+            g->demand[key]++;
+        else
+            g->demand[g->matek[key]]--;
+    }
+    pz->place[pos] = -1;
+    g->left[pz->cls[EPIECE(e)]]++;
+    g->nopen++;
+    g->lastuse[pz->cls[EPIECE(e)]] = g->prevuse[g->stepof[pos]];
+    g->stepof[pos] = -1;
+    jg_unplace(&g->grid);
+    growaround(g, pos);
+}
+
+
+/**************************************************************
+ * growaround(): - Bring a position and the eight around it, whose
+ * sides or corners it touches, up to date in front[].
+ *
+ **************************************************************/
+void growaround(GROW *g, int pos)
+{
+    PUZZLE *pz = g->pz;     // the puzzle being solved
+    int   i, j;             // position in the puzzle
+    int   di, dj;           // offset of a position around it
+
+    i = pos % pz->width;
+    j = pos / pz->width;
+    for (dj = -1; dj <= 1; dj++) {
+        for (di = -1; di <= 1; di++) {
+            if ((i + di >= 0) && (i + di < pz->width) &&
+                (j + dj >= 0) && (j + dj < pz->height))
+                growfront(g, pos + di + (dj * pz->width));
+        }
+    }
+}
+
+
+/**************************************************************
+ * growfront(): - Add a position to front[] if it is open, to be
+ * filled, has two known sides next to each other, and is next to
+ * a placed piece or is the first position, or take it out if not.
+ * Keeping to positions next to placed pieces grows one region
+ * instead of one from each corner, which would only be found not
+ * to meet after much work.  The candidates at a position in
+ * front[] are counted again each time it is brought up to date.
+ *
+ **************************************************************/
+void growfront(GROW *g, int pos)
+{
+    PUZZLE *pz = g->pz;     // the puzzle being solved
+    int   in = 0;           // set if pos belongs in front[]
+    int   touch = 0;        // set if pos is next to a placed piece
+    int   last;             // position in the last slot
+    int   k;                // side
+    int   q;                // neighbour on side k
+
+    if ((pz->place[pos] < 0) && (g->rank[pos] < g->nrank)) {
+        g->known[pos] = 0;
+        for (k = 0; k < 4; k++) {
+            q = neighbour(pz, pos, k);
+            if ((q >= 0) && (pz->place[q] >= 0))
+                touch = 1;
+            g->known[pos] += (q < 0) || (pz->place[q] >= 0);
+        }
+        if (touch || (g->rank[pos] == 0)) {
+            g->count[pos] = growcount(g, pos, 0);
+            in = (g->count[pos] >= 0);
+        }
+    }
+    if (in && (g->fslot[pos] < 0)) {
+        g->fslot[pos] = g->nfront;
+        g->front[g->nfront++] = pos;
+    }
+    else if (!in && (g->fslot[pos] >= 0)) {
+        last = g->front[--g->nfront];
+        g->front[g->fslot[pos]] = last;
+        g->fslot[last] = g->fslot[pos];
+        g->fslot[pos] = -1;
+    }
+}
+
+
+/**************************************************************
+ * growcheck(): - Check the state after a piece is placed at pos.
+ * Every open position around it that can be looked up must still
+ * have a candidate.  When the whole puzzle is being filled the
+ * counts must also balance: every open side either wants a known
+ * key or touches another open side, where a key and its mate
+ * pair up, so for each key the sides of unused pieces left over
+ * from what is wanted must match those of its mate.  In the same
+ * way every vertex with no corner cell yet needs one from an
+ * unused piece.
+ *
+ * Output:       1 if the puzzle may still be filled, else the
+ *               position left with no candidate, or -1 if the
+ *               counts do not balance
+ **************************************************************/
+int growcheck(GROW *g, int pos, int *empty)
+{
+    PUZZLE *pz = g->pz;     // the puzzle being solved
+    int   i, j;             // position in the puzzle
+    int   di, dj;           // offset of a position around it
+    int   q;                // position around pos
+    int   a;                // key
+    int   spare;            // sides with key a not wanted
+
+    i = pos % pz->width;
+    j = pos / pz->width;
+    for (dj = -1; dj <= 1; dj++) {
+        for (di = -1; di <= 1; di++) {
+            if ((i + di < 0) || (i + di >= pz->width) ||
+                (j + dj < 0) || (j + dj >= pz->height))
+                continue;
+            q = pos + di + (dj * pz->width);
+            if ((g->fslot[q] >= 0) && (g->count[q] == 0)) {
+                *empty = q;
+                return(0);
+            }
+        }
+    }
+
+    *empty = -1;
+    if (!g->whole)
+        return(1);
+    if (g->corners != g->unowned)
+        return(0);
+    for (a = 0; a < (1 << pz->keybits); a++) {
+        spare = g->supply[a] - g->demand[a];
+        if ((spare < 0) ||
+            ((g->matek[a] == (unsigned) a) && (spare & 1)) ||
+            (spare != g->supply[g->matek[a]] - g->demand[g->matek[a]]))
+            return(0);
+    }
+    return(1);
+}
+
+
+/**************************************************************
+ * meet(): - Assemble the puzzle from the top left and bottom
+ * right corners at once, a thread each, meeting at the middle
+ * anti-diagonal.  Each half is the search of assemble() on a view
+ * of the puzzle, the one from the bottom right turned half way
+ * round, and each goes MEET_HALO anti-diagonals past the middle
+ * to check the pieces along it.  The halves claim pieces by an
+ * atomic decrement of the count of their shape, so they never
+ * take the same piece.  The seam where they meet is checked as
+ * the pieces are replayed by assemble(), see halfworker().
+ *
+ * Input:        puzzle, pieces left of each shape, next candidate
+ *               at each position
+ * Output:       pieces are placed in pz->place[]
+ **************************************************************/
+void meet(PUZZLE *pz, int *left, int *next)
+{
+    MEET  mt;               // state shared by the halves
+    HALF  half[2];          // the half from each corner
+    pthread_t tid[2];       // a thread for each half
+    int  *count;            // positions on each anti-diagonal
+    int   ndiag;            // number of anti-diagonals
+    int   pos;              // position in the puzzle
+    int   n;                // positions before the middle
+    int   i;                // half
+
+    ndiag = pz->width + pz->height - 1;
+    count = (int *) calloc(ndiag, sizeof(int));
+    if (count == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (pos = 0; pos < pz->npiece; pos++)
+        count[(pos % pz->width) + (pos / pz->width)]++;
+
+    // Split the anti-diagonals so each half has about as many pieces
+    memset(&mt, 0, sizeof(mt));
+    mt.pz = pz;
+    mt.left = left;
+    mt.next = next;
+    for (mt.mid = 0, n = 0; (mt.mid < ndiag) && (2 * n < pz->npiece); mt.mid++)
+        n += count[mt.mid];
+    free(count);
+
+    for (i = 0; i < 2; i++) {
+        memset(&half[i], 0, sizeof(HALF));
+        half[i].mt = &mt;
+        half[i].turns = 2 * i;
+        half[i].view = *pz;
+        half[i].diags = (i == 0) ? mt.mid : ndiag - mt.mid;
+        if (pthread_create(&tid[i], 0, halfworker, &half[i]) != 0) {
+            printf("Unable to start the assembly threads\n");
+            exit(1);
+        }
+    }
+    for (i = 0; i < 2; i++)
+        pthread_join(tid[i], 0);
+    printf("%-10s %10d and %d of %d pieces\n", "meet", half[0].placed,
+           half[1].placed, pz->npiece);
+}
+
+
+/**************************************************************
+ * halfworker(): - Fill one half, and the halo past it, then copy
+ * the half into the puzzle turned back.  The top left half is in
+ * the puzzle's own frame, so the cursor of each of its positions
+ * is kept; the other half's are found on replay.  A half that got
+ * stuck after the other took a piece it wanted may have lost to a
+ * wrong piece, so the first half to do so waits for the other to
+ * finish and tries once more with the counts settled.  If the top
+ * left half is stuck the other is stopped, as the search will
+ * start again from the corner.
+ *
+ **************************************************************/
+void *halfworker(void *arg)
+{
+    HALF *hf = (HALF *) arg;
+    MEET *mt = hf->mt;      // state shared by the halves
+    PUZZLE *pz = &hf->view; // the puzzle as this half sees it
+    int   me = hf->turns / 2;  // index of this half in mt->done
+    int   filled;           // set if the half and its halo are filled
+    int   k;                // step
+    int   pos;              // position at the step
+    int   e;                // entry at the position
+    int   s;                // shape
+    int   d;                // anti-diagonal of a step
+
+    hf->spare = (int *) malloc(sizeof(int) * pz->nclass);
+    hf->order = (int *) malloc(sizeof(int) * pz->npiece);
+    hf->cursor = (int *) malloc(sizeof(int) * pz->npiece);
+    pz->place = (int *) malloc(sizeof(int) * pz->npiece);
+    if ((hf->spare == 0) || (hf->order == 0) || (hf->cursor == 0) ||
+        (pz->place == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    fillorder(pz, hf->order);
+    for (hf->nown = 0, hf->nstep = 0; hf->nstep < pz->npiece; hf->nstep++) {
+        d = (hf->order[hf->nstep] % pz->width) + (hf->order[hf->nstep] / pz->width);
+        if (d < hf->diags)
+            hf->nown = hf->nstep + 1;
+        else if (d >= hf->diags + MEET_HALO)
+            break;
+    }
+
+    while (1) {
+        for (s = 0; s < pz->nclass; s++)
+            hf->spare[s] = pz->cfirst[s + 1] - pz->cfirst[s];
+        hf->lost = 0;
+        filled = halfsearch(hf);
+        if (filled || !hf->lost ||
+            __atomic_load_n(&mt->stop, __ATOMIC_RELAXED) ||
+            (__atomic_fetch_add(&mt->nstuck, 1, __ATOMIC_SEQ_CST) > 0))
+            break;
+        while (!__atomic_load_n(&mt->done[1 - me], __ATOMIC_ACQUIRE))
+            sched_yield();
+    }
+
+    if (filled) {
+        for (k = 0; k < hf->nown; k++) {
+            pos = hf->order[k];
+            e = pz->place[pos];
+            if (hf->turns == 0) {
+                mt->pz->place[pos] = e;
+                mt->next[pos] = hf->cursor[k];
+            }
+            else {
+                mt->pz->place[pz->npiece - 1 - pos] =
+                    ENTRY(EPIECE(e), (EROT(e) + hf->turns) % 4);
+                mt->next[pz->npiece - 1 - pos] = -1;
+            }
+        }
+        hf->placed = hf->nown;
+    }
+    else if (hf->turns == 0)
+        __atomic_store_n(&mt->stop, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&mt->done[me], 1, __ATOMIC_RELEASE);
+    free(hf->spare);
+    free(hf->order);
+    free(hf->cursor);
+    free(pz->place);
+    return(0);
+}
+
+
+/**************************************************************
+ * halfsearch(): - Fill the anti-diagonals of one half, and the
+ * halo past them, with the search of assemble().  The pieces of
+ * the half are claimed from the shared counts.  The halo only
+ * checks the half, so its pieces are counted against the half's
+ * own spare count of each shape and never claimed.
+ *
+ * Output:       1 if the half and its halo are filled, 0 if not,
+ *               with the pieces of the half given back
+ **************************************************************/
+int halfsearch(HALF *hf)
+{
+    MEET *mt = hf->mt;      // state shared by the halves
+    PUZZLE *pz = &hf->view; // the puzzle as this half sees it
+    int  *cursor = hf->cursor;  // next candidate to try at each step
+    JGRID grid;             // placement oracle
+    int   k;                // step, the number of pieces placed
+    int   pos;              // position being filled
+    int   c;                // index of the candidate in cand[]
+    int   end;              // end of the candidates for the position
+    int   e;                // candidate entry
+    int   s;                // shape of the candidate
+    int   pool;             // pool searched at the position
+
+    if (jg_init(&grid, pz->width, pz->height, pz->edge) != 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (pos = 0; pos < pz->npiece; pos++)
+        pz->place[pos] = -1;
+
+    k = 0;
+    cursor[0] = pz->start[poolof(pz, hf->order[0])][wantkey(pz, hf->order[0])];
+    while ((k < hf->nstep) && (__atomic_load_n(&mt->stop, __ATOMIC_RELAXED) == 0)) {
+        pos = hf->order[k];
+        pool = poolof(pz, pos);
+        end = pz->start[pool][wantkey(pz, pos) + 1];
+        for (c = cursor[k]; c < end; c++) {
+            e = pz->cand[pool][c];
+            s = pz->cls[EPIECE(e)];
+            if ((hf->spare[s] == 0) || !fits(pz, pos, e))
+                continue;
+            if ((k < hf->nown) &&
+                (__atomic_sub_fetch(&mt->left[s], 1, __ATOMIC_ACQ_REL) < 0)) {
+                // the other half got the last one first
+                __atomic_add_fetch(&mt->left[s], 1, __ATOMIC_RELEASE);
+                hf->lost = 1;
+                continue;
+            }
+            if (jg_place(&grid, pz->mask[EPIECE(e)], pos, EROT(e)) != JG_OK) {
+                if (k < hf->nown)
+                    __atomic_add_fetch(&mt->left[s], 1, __ATOMIC_RELEASE);
+                continue;
+            }
+            pz->place[pos] = e;
+            hf->spare[s]--;
+            // The look ahead may reach the other half, whose pieces
+            // would be missing from the shared counts
+            if (lookahead(pz, hf->spare, pos))
+                break;
+            hf->spare[s]++;
+            if (k < hf->nown)
+                __atomic_add_fetch(&mt->left[s], 1, __ATOMIC_RELEASE);
+            jg_unplace(&grid);
+        }
+
+        if (c < end) {
+            cursor[k] = c + 1;
+            k++;
+            if (k < pz->npiece)
+                cursor[k] = pz->start[poolof(pz, hf->order[k])][wantkey(pz, hf->order[k])];
+        }
+        else {
+            if (k == 0)
+                break;
+            k--;
+            jg_unplace(&grid);
+            s = pz->cls[EPIECE(pz->place[hf->order[k]])];
+            hf->spare[s]++;
+            if (k < hf->nown)
+                __atomic_add_fetch(&mt->left[s], 1, __ATOMIC_RELEASE);
+        }
+    }
+    jg_free(&grid);
+    if (k == hf->nstep)
+        return(1);
+
+    // Stopped part way, give back the pieces of the half
+    while (--k >= 0) {
+        if (k < hf->nown)
+            __atomic_add_fetch(&mt->left[pz->cls[EPIECE(pz->place[hf->order[k]])]],
+                               1, __ATOMIC_RELEASE);
+    }
+    return(0);
+}
+
+
+/**************************************************************
+ * portfolio(): - Run a strategy on each thread, the search of
+ * assemble() from one of the corners filling by anti-diagonals,
+ * rows, or columns, and keep the layout of the first to fill the
+ * puzzle.  Starting at another corner is the same as solving the
+ * puzzle turned, so each strategy has a view of the puzzle with
+ * its own width, height, and layout that shares the buckets of
+ * the others, which no strategy changes.  The first strategy to
+ * finish sets a flag the others check after every placement.
+ *
+ * Output:       0 if every position is filled, -1 if not
+ **************************************************************/
+int portfolio(PUZZLE *pz)
+{
+    static const char *corner[4] = { "top left", "bottom left",
+                                     "bottom right", "top right" };
+    static const char *how[3] = { "diagonals", "rows", "columns" };
+    PORTFOLIO pf;           // state shared by the strategies
+    STRATEGY *sy;           // each strategy
+    pthread_t tid[NSTRATEGY]; // a thread for each strategy
+    long  nodes = 0;        // pieces placed by all of the strategies
+    int   i;                // strategy
+
+    memset(&pf, 0, sizeof(pf));
+    pf.nrun = (pz->nthread < NSTRATEGY) ? pz->nthread : NSTRATEGY;
+    pf.winner = -1;
+    sy = (STRATEGY *) calloc(pf.nrun, sizeof(STRATEGY));
+    if (sy == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (i = 0; i < pf.nrun; i++) {
+        sy[i].pf = &pf;
+        sy[i].id = i;
+        sy[i].view = *pz;
+        if (pthread_create(&tid[i], 0, strategyworker, &sy[i]) != 0) {
+            printf("Unable to start the strategy threads\n");
+            exit(1);
+        }
+    }
+    for (i = 0; i < pf.nrun; i++) {
+        pthread_join(tid[i], 0);
+        nodes += sy[i].nodes;
+    }
+
+    i = pf.winner;
+    if (i >= 0) {
+        printf("%-10s %10s %s by %s\n", "strategy", "", corner[i % 4],
+               how[i / 4]);
+        pz->place = (int *) malloc(sizeof(int) * pz->npiece);
+        if (pz->place == 0) {
+            printf("malloc failure\n");
+            exit(1);
+        }
+        unturn(pz, &sy[i].view, i % 4);
+        unfold(pz);
+    }
+    printf("%-10s %10ld placed by %d strategies\n", "portfolio", nodes, pf.nrun);
+    for (i = 0; i < pf.nrun; i++)
+        free(sy[i].view.place);
+    free(sy);
+    return((pf.winner >= 0) ? 0 : -1);
+}
+
+
+/**************************************************************
+ * strategyworker(): - Run one strategy of the portfolio.  This
+ * is the search of assemble() on the strategy's view.  Strategy
+ * i starts at corner i % 4, where the view is the puzzle turned
+ * a quarter clockwise that many times, and fills in order i / 4.
+ *
+ **************************************************************/
+void *strategyworker(void *arg)
+{
+    STRATEGY *sy = (STRATEGY *) arg;
+    PORTFOLIO *pf = sy->pf; // state shared by the strategies
+    PUZZLE *pz = &sy->view; // the puzzle as this strategy sees it
+    JGRID grid;             // placement oracle
+    int  *left;             // pieces of each shape not yet placed
+    int  *order;            // position to fill at each step
+    int  *cursor;           // next candidate to try at each step
+    int   k;                // step, the number of pieces placed
+    int   pos;              // position being filled
+    int   c;                // index of the candidate in cand[]
+    int   end;              // end of the candidates for the position
+    int   e;                // candidate entry
+    int   pool;             // pool searched at the position
+    int   none = -1;        // no winner yet, for the exchange
+
+    if (sy->id % 2) {
+        pz->width = pz->height;
+        pz->height = pz->npiece / pz->width;
+    }
+    pz->bycolumn = (sy->id / 4 == ORDER_COLS);
+    pz->online = 0;
+    left = (int *) malloc(sizeof(int) * pz->nclass);
+    order = (int *) malloc(sizeof(int) * pz->npiece);
+    cursor = (int *) malloc(sizeof(int) * pz->npiece);
+    pz->place = (int *) malloc(sizeof(int) * pz->npiece);
+    if ((left == 0) || (order == 0) || (cursor == 0) || (pz->place == 0) ||
+        (jg_init(&grid, pz->width, pz->height, pz->edge) != 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (pos = 0; pos < pz->npiece; pos++)
+        pz->place[pos] = -1;
+    for (c = 0; c < pz->nclass; c++)
+        left[c] = pz->cfirst[c + 1] - pz->cfirst[c];
+    strategyorder(pz, sy->id / 4, order);
+
+    k = 0;
+    cursor[0] = pz->start[poolof(pz, order[0])][wantkey(pz, order[0])];
+    while ((k < pz->npiece) && (__atomic_load_n(&pf->stop, __ATOMIC_RELAXED) == 0)) {
+        pos = order[k];
+        pool = poolof(pz, pos);
+        end = pz->start[pool][wantkey(pz, pos) + 1];
+        for (c = cursor[k]; c < end; c++) {
+            e = pz->cand[pool][c];
+            if ((left[pz->cls[EPIECE(e)]] == 0) || !fits(pz, pos, e))
+                continue;
+            if (jg_place(&grid, pz->mask[EPIECE(e)], pos, EROT(e)) != JG_OK)
+                continue;
+            pz->place[pos] = e;
+            left[pz->cls[EPIECE(e)]]--;
+            sy->nodes++;
+            if (lookahead(pz, left, pos))
+                break;
+            left[pz->cls[EPIECE(e)]]++;
+            jg_unplace(&grid);
+        }
+
+        if (c < end) {
+            cursor[k] = c + 1;
+            k++;
+            if (k < pz->npiece)
+                cursor[k] = pz->start[poolof(pz, order[k])][wantkey(pz, order[k])];
+        }
+        else {
+            if (k == 0)
+                break;
+            k--;
+            jg_unplace(&grid);
+            left[pz->cls[EPIECE(pz->place[order[k]])]]++;
+        }
+    }
+
+    // Only the first strategy to fill the puzzle stops the others
+    sy->result = ((k == pz->npiece) && jg_is_complete(&grid)) ? 0 : -1;
+    if ((sy->result == 0) &&
+        __atomic_compare_exchange_n(&pf->winner, &none, sy->id, 0,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        __atomic_store_n(&pf->stop, 1, __ATOMIC_RELAXED);
+    jg_free(&grid);
+    free(left);
+    free(order);
+    free(cursor);
+    return(0);
+}
+
+
+/**************************************************************
+ * strategyorder(): - Get the order in which a strategy fills the
+ * positions.  In every order the pieces to the left, above, and
+ * above left of a position are placed before it.
+ *
+ * Input:        view of the puzzle, ORDER_DIAG, ORDER_ROWS, or
+ *               ORDER_COLS, where to put the order
+ **************************************************************/
+void strategyorder(PUZZLE *pz, int how, int *order)
+{
+    int   k;                // step
+
+    if (how == ORDER_DIAG)
+        fillorder(pz, order);
+    else if (how == ORDER_ROWS) {
+        for (k = 0; k < pz->npiece; k++)
+            order[k] = k;
+    }
+    else {
+        for (k = 0; k < pz->npiece; k++)
+            order[k] = ((k % pz->height) * pz->width) + (k / pz->height);
+    }
+}
+
+
+/**************************************************************
+ * unturn(): - Copy the layout of a view turned a quarter
+ * clockwise some number of times back into the puzzle.  Each
+ * quarter turn back moves position (i, j) of a view w wide to
+ * (j, w - 1 - i) and turns each piece a quarter with it.
+ *
+ * Input:        puzzle, view, quarter turns
+ **************************************************************/
+void unturn(PUZZLE *pz, PUZZLE *view, int turns)
+{
+    int   pos;              // position in the view
+    int   i, j;             // position as it is turned back
+    int   w, h;             // width and height as it is turned back
+    int   t;                // quarter turn
+    int   x;                // for swapping
+
+    for (pos = 0; pos < view->npiece; pos++) {
+        i = pos % view->width;
+        j = pos / view->width;
+        w = view->width;
+        h = view->height;
+        for (t = 0; t < turns; t++) {
+            x = i;
+            i = j;
+            j = w - 1 - x;
+            x = w;
+            w = h;
+            h = x;
+        }
+        pz->place[i + (j * pz->width)] =
+            ENTRY(EPIECE(view->place[pos]), (EROT(view->place[pos]) + turns) % 4);
+    }
+}
+
+
+/**************************************************************
+ * wavefront(): - Assemble the rows in parallel once column 0 is
+ * in place.  Column 0 is filled first by growrun(), which can
+ * back up over it, with the rest of the puzzle ranked out of its
+ * reach.  Threads then claim rows in order, and a row only places
+ * the piece in column i once the row above has placed column
+ * i + 1, so each piece has its left, top, and top right
+ * neighbours when it is placed.  Pieces are claimed by an atomic
+ * decrement of the count of their shape, so the pools need no
+ * locks.  If column 0 can not be filled the rows start at column
+ * 0 themselves.
+ *
+ * Input:        puzzle, pieces left of each shape, next candidate
+ *               at each position
+ * Output:       pieces are placed in pz->place[]
+ **************************************************************/
+void wavefront(PUZZLE *pz, int *left, int *next)
+{
+    pthread_t tid[MAX_THREADS]; // worker threads
+    WAVE  wave;             // state shared by the threads
+    GROW  g;                // the search of column 0
+    int  *rank;             // column 0 first, then the rest
+    int   nthread;          // number of threads started
+    int   pos;              // position in the puzzle
+    int   i;                // generic loop counter
+
+    memset(&wave, 0, sizeof(wave));
+    wave.pz = pz;
+    wave.left = left;
+    wave.next = next;
+    wave.progress = (int *) calloc(pz->height, sizeof(int));
+    rank = (int *) malloc(sizeof(int) * pz->npiece);
+    if ((wave.progress == 0) || (rank == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+
+    // Fill column 0, or clear what the search left of it
+    for (pos = 0; pos < pz->npiece; pos++)
+        rank[pos] = ((pos % pz->width) == 0) ? pos / pz->width : pz->height + pos;
+    growinit(&g, pz, left, rank, pz->height);
+    if (growrun(&g, (long) GROW_TRIES * pz->height) == 1)
+        wave.first = 1;
+    printf("%-10s %10ld nodes %ld backtracks\n", "column", g.nodes, g.backtracks);
+    growfree(&g);
+    free(rank);
+    for (i = 0; i < pz->height; i++) {
+        pos = i * pz->width;
+        if ((wave.first == 0) && (pz->place[pos] >= 0)) {
+            left[pz->cls[EPIECE(pz->place[pos])]]++;
+            pz->place[pos] = -1;
+        }
+        wave.progress[i] = wave.first;
+    }
+
+    for (nthread = 0; nthread < pz->nthread; nthread++) {
+        if (pthread_create(&tid[nthread], 0, rowworker, &wave) != 0)
+            break;
+    }
+    if (nthread == 0)
+        rowworker(&wave);
+    for (i = 0; i < nthread; i++)
+        pthread_join(tid[i], 0);
+
+    free(wave.progress);
+}
+
+
+/**************************************************************
+ * tiles(): - Have the workers assemble the puzzle a tile at a
+ * time.  Tile (tx, ty) goes out in step tx + 2 * ty, after the
+ * tiles to its left, above, and above right, so all the tiles of
+ * a step are sent out at once, each with the pieces along its top
+ * and left, and the layouts are put in place as they come back.
+ * No tiles are sent after a step with a tile that was stuck or
+ * did not fit.  The workers are stopped when the tiles are done.
+ *   The tiles are then merged pairwise in rounds, side by side
+ * and then one above the other, so each round doubles the width
+ * or height of the clusters until one covers the puzzle.  A merge
+ * only checks the seam between the two clusters, see seam(), and
+ * a cluster is good if both halves were and the seam fits.
+ *
+ * Input:        puzzle, pieces left of each shape, next candidate
+ *               at each position
+ * Output:       pieces are placed in pz->place[]
+ **************************************************************/
+void tiles(PUZZLE *pz, int *left, int *next)
+{
+    WIRESHAPE *ws;          // the shapes, sent to every worker
+    int  *owner;            // worker given each tile of a step
+    int  *row;              // tile row of each tile of a step
+    int  *good;             // set at the top left tile of each good
+                            // cluster
+    int   ntx, nty;         // tiles across and down
+    int   cw, ch;           // tiles across and down a cluster
+    int   across;           // set if this round merges side by side
+    int   x1, y1;           // bottom right corner of a merged cluster
+    int   nsent;            // tiles sent in this step
+    int   placed = 0;       // tiles put in place
+    int   stuck = 0;        // set when a tile is stuck or does not fit
+    int   merges = 0;       // pairs of clusters merged
+    int   fitted = 0;       // merges that gave a good cluster
+    int   rounds = 0;       // rounds of merges
+    int   w = 0;            // worker given the next tile
+    int   d;                // step
+    int   tx, ty;           // tile column and row
+    int   bx, by;           // tile at the top left of the other half
+    int   a, b;             // the two halves of a merge
+    int   c;                // shape
+    int   k;                // side
+    int   i;                // tile of the step
+
+    ntx = (pz->width + TILE_SIZE - 1) / TILE_SIZE;
+    nty = (pz->height + TILE_SIZE - 1) / TILE_SIZE;
+    ws = (WIRESHAPE *) calloc(pz->nclass + 1, sizeof(WIRESHAPE));
+    owner = (int *) malloc(sizeof(int) * nty);
+    row = (int *) malloc(sizeof(int) * nty);
+    good = (int *) calloc(ntx * nty, sizeof(int));
+    if ((ws == 0) || (owner == 0) || (row == 0) || (good == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+
+    // Each worker gets the signatures and count of every shape, and
+    // entries go over the wire as shape * 4 + rotation
+    for (c = 0; c < pz->nclass; c++) {
+        for (k = 0; k < 4; k++)
+            ws[c].sig[k] = pz->sig[pz->cmember[pz->cfirst[c]]][k];
+        ws[c].flatside = pz->flatside[pz->cmember[pz->cfirst[c]]];
+        ws[c].count = pz->cfirst[c + 1] - pz->cfirst[c];
+    }
+    for (i = 0; i < pz->nworker; i++) {
+        if (jn_send(pz->sock[i], MSG_SHAPES, ws,
+                    sizeof(WIRESHAPE) * pz->nclass) != 0) {
+            printf("Lost worker %d\n", i);
+            exit(1);
+        }
+    }
+    free(ws);
+
+    for (d = 0; (d < ntx + (2 * (nty - 1))) && !stuck; d++) {
+        nsent = 0;
+        for (ty = 0; ty < nty; ty++) {
+            if ((d - (2 * ty) < 0) || (d - (2 * ty) >= ntx))
+                continue;
+            sendtile(pz, w, d - (2 * ty), ty);
+            owner[nsent] = w;
+            row[nsent++] = ty;
+            w = (w + 1) % pz->nworker;
+        }
+        for (i = 0; i < nsent; i++) {
+            tx = d - (2 * row[i]);
+            if (recvtile(pz, left, next, owner[i], tx, row[i]) == 0) {
+                good[tx + (row[i] * ntx)] = 1;
+                placed++;
+            }
+            else
+                stuck = 1;
+        }
+    }
+    printf("%-10s %10d of %d tiles\n", "tiles", placed, ntx * nty);
+    free(owner);
+    free(row);
+    stopcluster(pz);
+
+    // Merge the clusters in pairs, keeping the narrower way even
+    for (cw = 1, ch = 1; (cw < ntx) || (ch < nty); rounds++) {
+        across = (cw < ntx) && ((cw <= ch) || (ch >= nty));
+        for (ty = 0; ty < nty; ty += across ? ch : 2 * ch) {
+            for (tx = 0; tx < ntx; tx += across ? 2 * cw : cw) {
+                bx = across ? tx + cw : tx;
+                by = across ? ty : ty + ch;
+                if ((bx >= ntx) || (by >= nty))
+                    continue;       // no other half to merge with
+                x1 = (tx + (across ? 2 * cw : cw)) * TILE_SIZE;
+                y1 = (ty + (across ? ch : 2 * ch)) * TILE_SIZE;
+                a = tx + (ty * ntx);
+                b = bx + (by * ntx);
+                good[a] = good[a] && good[b] &&
+                          seam(pz, next, tx * TILE_SIZE, ty * TILE_SIZE,
+                               (x1 < pz->width) ? x1 : pz->width,
+                               (y1 < pz->height) ? y1 : pz->height,
+                               bx * TILE_SIZE, by * TILE_SIZE, across);
+                merges++;
+                fitted += good[a];
+            }
+        }
+        if (across)
+            cw *= 2;
+        else
+            ch *= 2;
+    }
+    printf("%-10s %10d of %d merges in %d rounds\n", "stitched", fitted,
+           merges, rounds);
+    free(good);
+}
+
+
+/**************************************************************
+ * sendtile(): - Send a worker a tile and the halo to fill with
+ * it, with the entries along the top, from the one above left,
+ * and down the left side, or -1 where it is on the border.  The
+ * halo goes TILE_HALO columns to the right, where the tile above
+ * right is placed, and on the left border TILE_HALO rows down.
+ *
+ * Input:        puzzle, worker, tile column and row
+ **************************************************************/
+void sendtile(PUZZLE *pz, int w, int tx, int ty)
+{
+    int   job[6 + (2 * (TILE_SIZE + TILE_HALO)) + 1]; // the tile and
+                            // its border
+    int   x0, y0;           // top left position of the tile
+    int   tw, th;           // width and height of the tile
+    int   fw, fh;           // width and height to fill, with the halo
+    int   n = 6;            // ints in job[]
+    int   e;                // entry on the border
+    int   i, j;             // position in the puzzle
+
+    x0 = tx * TILE_SIZE;
+    y0 = ty * TILE_SIZE;
+    tw = (pz->width - x0 < TILE_SIZE) ? pz->width - x0 : TILE_SIZE;
+    th = (pz->height - y0 < TILE_SIZE) ? pz->height - y0 : TILE_SIZE;
+    fw = (pz->width - x0 < tw + TILE_HALO) ? pz->width - x0 : tw + TILE_HALO;
+    fh = th;
+    if (tx == 0)
+        fh = (pz->height - y0 < th + TILE_HALO) ? pz->height - y0 : th + TILE_HALO;
+    job[0] = x0;
+    job[1] = y0;
+    job[2] = tw;
+    job[3] = th;
+    job[4] = fw;
+    job[5] = fh;
+    for (i = x0 - 1; i < x0 + fw; i++) {
+        e = ((i >= 0) && (y0 > 0)) ? pz->place[i + ((y0 - 1) * pz->width)] : -1;
+        job[n++] = (e < 0) ? -1 : ENTRY(pz->cls[EPIECE(e)], EROT(e));
+    }
+    for (j = y0; j < y0 + fh; j++) {
+        e = (x0 > 0) ? pz->place[x0 - 1 + (j * pz->width)] : -1;
+        job[n++] = (e < 0) ? -1 : ENTRY(pz->cls[EPIECE(e)], EROT(e));
+    }
+    if (jn_send(pz->sock[w], MSG_TILE, job, sizeof(int) * n) != 0) {
+        printf("Lost worker %d\n", w);
+        exit(1);
+    }
+}
+
+
+/**************************************************************
+ * recvtile(): - Put in place the layout of a tile from a worker.
+ * Each entry must have pieces of its shape left, and those whose
+ * left, top, and top left neighbours are all in the tile, or off
+ * the puzzle, must fit them, see tilefits().  The rest are on the
+ * seams with the tiles to the left and above, and are checked
+ * when the tiles are merged.
+ *
+ * Input:        puzzle, pieces left of each shape, next candidate
+ *               at each position, worker, tile column and row
+ * Output:       0 if the whole tile was placed, -1 if not
+ **************************************************************/
+int recvtile(PUZZLE *pz, int *left, int *next, int w, int tx, int ty)
+{
+    char *buf = 0;          // message body
+    size_t buflen = 0;      // size of buf
+    uint32_t type;          // message type
+    int   len;              // length of the message body
+    int  *lay;              // entry at each position of the tile
+    int   x0, y0;           // top left position of the tile
+    int   tw, th;           // width and height of the tile
+    int   pos;              // position in the puzzle
+    int   c;                // shape of the entry
+    int   i, j;             // position in the tile, then the puzzle
+    int   ret = 0;          // return value
+
+    x0 = tx * TILE_SIZE;
+    y0 = ty * TILE_SIZE;
+    tw = (pz->width - x0 < TILE_SIZE) ? pz->width - x0 : TILE_SIZE;
+    th = (pz->height - y0 < TILE_SIZE) ? pz->height - y0 : TILE_SIZE;
+    len = jn_recv(pz->sock[w], &type, &buf, &buflen);
+    if ((len < 0) || (type != MSG_LAYOUT)) {
+        printf("Lost worker %d\n", w);
+        exit(1);
+    }
+    lay = (int *) buf;
+    if (len != (int) (sizeof(int) * tw * th))
+        ret = -1;           // the worker found no layout
+
+    // Put each entry in place while its shape has pieces left
+    for (j = 0; (ret == 0) && (j < th); j++) {
+        for (i = 0; i < tw; i++) {
+            pos = x0 + i + ((y0 + j) * pz->width);
+            c = EPIECE(lay[i + (j * tw)]);
+            if ((lay[i + (j * tw)] < 0) || (c >= pz->nclass) || (left[c] == 0)) {
+                ret = -1;
+                break;
+            }
+            pz->place[pos] = ENTRY(pz->cmember[pz->cfirst[c]], EROT(lay[i + (j * tw)]));
+            left[c]--;
+        }
+    }
+
+    // Row by row, so the left and top neighbours are checked first
+    for (j = y0; (ret == 0) && (j < y0 + th); j++) {
+        for (i = x0; i < x0 + tw; i++) {
+            if (((i > x0) || (i == 0)) && ((j > y0) || (j == 0)) &&
+                !tilefits(pz, next, i + (j * pz->width))) {
+                ret = -1;
+                break;
+            }
+        }
+    }
+    free(buf);
+    return(ret);
+}
+
+
+/**************************************************************
+ * seam(): - Check the seam where a cluster of tiles is merged
+ * with the one to its left or above it.  The seam is the first
+ * column, or first row, of the right or lower cluster.  Only the
+ * entries whose left, top, and top left neighbours are all in the
+ * merged cluster, or off the puzzle, are checked now; the others
+ * are left to a later merge that brings those in, so every entry
+ * is checked exactly once by the time one cluster is left.
+ *
+ * Input:        puzzle, next candidate at each position, top
+ *               left and bottom right corners of the merged
+ *               cluster, top left of the right or lower cluster,
+ *               set if it is to the right
+ * Output:       1 if every entry checked fits, 0 if not
+ **************************************************************/
+int seam(PUZZLE *pz, int *next, int x0, int y0, int x1, int y1,
+         int bx, int by, int right)
+{
+    int   i, j;             // position in the puzzle
+
+    if (right) {
+        for (j = y0; j < y1; j++)
+            if (((j > y0) || (j == 0)) && !tilefits(pz, next, bx + (j * pz->width)))
+                return(0);
+    }
+    else {
+        for (i = x0; i < x1; i++)
+            if (((i > x0) || (i == 0)) && !tilefits(pz, next, i + (by * pz->width)))
+                return(0);
+    }
+    return(1);
+}
+
+
+/**************************************************************
+ * tilefits(): - Check that the entry placed at a position is in
+ * the bucket for the sides of its neighbours and fits its
+ * corners.  The place after it in the bucket is kept so that
+ * the search can back up into the tile.
+ *
+ * Input:        puzzle, next candidate at each position, position
+ * Output:       1 if it fits, 0 if not
+ **************************************************************/
+int tilefits(PUZZLE *pz, int *next, int pos)
+{
+    int   e = pz->place[pos];   // the entry
+    int   pool;             // pool searched at the position
+    unsigned key;           // key pair wanted at the position
+    int   x;                // index of the entry in cand[]
+
+    if (e < 0)
+        return(0);
+    pool = poolof(pz, pos);
+    key = wantkey(pz, pos);
+    for (x = pz->start[pool][key];
+         (x < pz->start[pool][key + 1]) && (pz->cand[pool][x] != e); x++)
+        ;
+    if ((x == pz->start[pool][key + 1]) || !fits(pz, pos, e))
+        return(0);
+    next[pos] = x + 1;
+    return(1);
+}
+
+
+/**************************************************************
+ * stopcluster(): - Close the sockets to the workers, which ends
+ * them, and reap the workers started on this machine.
+ *
+ **************************************************************/
+void stopcluster(PUZZLE *pz)
+{
+    int   w;                // worker
+
+    for (w = 0; w < pz->nworker; w++)
+        close(pz->sock[w]);
+    if (pz->port == 0)
+        while (wait(0) > 0)
+            ;               // reap the local workers
+    free(pz->sock);
+    pz->sock = 0;
+}
+
+
+/**************************************************************
+ * rowworker(): - Claim rows and place their pieces left to right
+ * until the puzzle is done or some row is stuck.
+ *
+ * A row that is stuck backs up within itself, but only while the
+ * row below has not used the pieces it is taking back.  The row
+ * below reads columns up to one past its own, so a row may take
+ * back column c only when the row below has placed fewer than
+ * c - 1 pieces.  The row lowers its progress before it looks, so
+ * the row below cannot move up while it backs up.  When a row
+ * would have to back up further than that, every thread stops and
+ * the search in assemble() takes over.
+ *
+ **************************************************************/
+void *rowworker(void *arg)
+{
+    WAVE *w = (WAVE *) arg;
+    PUZZLE *pz = w->pz;     // the puzzle being solved
+    int   row;              // row being placed
+    int   i;                // column being placed
+    int   pos;              // position being placed
+    int   need;             // pieces needed in the row above
+    int   fresh;            // set when arriving at a new column
+
+    while (!__atomic_load_n(&w->stop, __ATOMIC_RELAXED)) {
+        row = __atomic_fetch_add(&w->nextrow, 1, __ATOMIC_RELAXED);
+        if (row >= pz->height)
+            break;
+        i = w->first;
+        fresh = 1;
+        while (i < pz->width) {
+            // Wait for the row above to get ahead
+            need = (i + 2 < pz->width) ? i + 2 : pz->width;
+            while ((row > 0) &&
+                   (__atomic_load_n(&w->progress[row - 1], __ATOMIC_ACQUIRE) < need)) {
+                if (__atomic_load_n(&w->stop, __ATOMIC_RELAXED))
+                    return(0);
+                sched_yield();
+            }
+
+            pos = i + (row * pz->width);
+            if (fresh)
+                w->next[pos] = pz->start[poolof(pz, pos)][wantkey(pz, pos)];
+            if (placeone(w, pos)) {
+                __atomic_store_n(&w->progress[row], i + 1, __ATOMIC_RELEASE);
+                i++;
+                fresh = 1;
+                continue;
+            }
+
+            // Nothing fits.  Take back the previous column if the row
+            // below allows it and it is not column 0, or give up.
+            __atomic_store_n(&w->progress[row], i - 1, __ATOMIC_SEQ_CST);
+            if ((i == w->first) || ((row + 1 < pz->height) &&
+                (__atomic_load_n(&w->progress[row + 1], __ATOMIC_SEQ_CST) > i - 3))) {
+                __atomic_store_n(&w->stop, 1, __ATOMIC_RELAXED);
+                return(0);
+            }
+            i--;
+            pos = i + (row * pz->width);
+            __atomic_add_fetch(&w->left[pz->cls[EPIECE(pz->place[pos])]], 1,
+                               __ATOMIC_RELEASE);
+            pz->place[pos] = -1;
+            fresh = 0;
+        }
+    }
+    return(0);
+}
+
+
+/**************************************************************
+ * placeone(): - Claim and place the next candidate that fits at
+ * a position and passes the look ahead.
+ *
+ * Output:       1 if a piece was placed, 0 if none fits
+ **************************************************************/
+int placeone(WAVE *w, int pos)
+{
+    PUZZLE *pz = w->pz;     // the puzzle being solved
+    int   pool;             // pool searched at the position
+    int   c;                // index of the candidate in cand[]
+    int   end;              // end of the candidates for the position
+    int   e;                // candidate entry
+
+    pool = poolof(pz, pos);
+    end = pz->start[pool][wantkey(pz, pos) + 1];
+    for (c = w->next[pos]; c < end; c++) {
+        e = pz->cand[pool][c];
+        if ((__atomic_load_n(&w->left[pz->cls[EPIECE(e)]], __ATOMIC_RELAXED) == 0) ||
+            !fits(pz, pos, e))
+            continue;
+        if (__atomic_sub_fetch(&w->left[pz->cls[EPIECE(e)]], 1, __ATOMIC_ACQ_REL) < 0) {
+            // another row got the last one first
+            __atomic_add_fetch(&w->left[pz->cls[EPIECE(e)]], 1, __ATOMIC_RELEASE);
+            continue;
+        }
+        pz->place[pos] = e;
+        if (lookahead(pz, w->left, pos)) {
+            w->next[pos] = c + 1;
+            return(1);
+        }
+        pz->place[pos] = -1;
+        __atomic_add_fetch(&w->left[pz->cls[EPIECE(e)]], 1, __ATOMIC_RELEASE);
+    }
+    w->next[pos] = end;
+    return(0);
+}
+
+
+/**************************************************************
+ * unfold(): - Replace the piece standing for each shape in the
+ * layout by the pieces of that shape in turn.  A piece p of the
+ * shape of piece n turned by rot has the same mask as n turned
+ * by rot + crot[p] - crot[n], as both are the canonical mask
+ * turned by the same amount.
+ *
+ **************************************************************/
+void unfold(PUZZLE *pz)
+{
+    int  *taken;            // pieces of each shape used so far
+    int   pos;              // position in the puzzle
+    int   e;                // entry at the position
+    int   c;                // shape of the entry
+    int   p;                // piece put at the position
+
+    taken = (int *) calloc(pz->nclass, sizeof(int));
+    if (taken == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (pos = 0; pos < pz->npiece; pos++) {
+        e = pz->place[pos];
+        c = pz->cls[EPIECE(e)];
+        p = pz->cmember[pz->cfirst[c] + taken[c]++];
+        pz->place[pos] = ENTRY(p, (EROT(e) + pz->crot[p] -
+                                   pz->crot[EPIECE(e)] + 4) % 4);
+    }
+    free(taken);
+}
+
+
+/**************************************************************
+ * fillorder(): - Get the order in which to fill the positions.
+ * Each anti-diagonal (i + j constant) is filled from the top
+ * down, so the pieces to the left, above, above left, and above
+ * right of a position are always placed before it.
+ *
+ **************************************************************/
+void fillorder(PUZZLE *pz, int *order)
+{
+    int   d;                // anti-diagonal, i + j
+    int   i, j;             // position in the puzzle
+    int   k = 0;            // index into order
+
+    for (d = 0; d < pz->width + pz->height - 1; d++) {
+        for (j = 0; j < pz->height; j++) {
+            i = d - j;
+            if ((i >= 0) && (i < pz->width))
+                order[k++] = i + (j * pz->width);
+        }
+    }
+}
+
+
+/**************************************************************
+ * lookahead(): - Check that the positions whose left and top
+ * neighbours are all placed once the piece at pos is placed
+ * still have an unused candidate.  This finds most wrong pieces
+ * right away instead of a whole anti-diagonal later.  While -o
+ * is assembling, left is the pieces of each shape used instead.
+ *
+ * Output:       1 if no neighbour is left without a candidate
+ **************************************************************/
+int lookahead(PUZZLE *pz, int *left, int pos)
+{
+    int (*has)(PUZZLE *, int *, int);   // check for a candidate
+    int   i, j;             // position in the puzzle
+
+    i = pos % pz->width;
+    j = pos / pz->width;
+    has = pz->online ? onlinecandidate : hascandidate;
+
+    // Filling by columns the same holds with rows and columns swapped
+    if (pz->bycolumn) {
+        if ((j < pz->height - 1) && !has(pz, left, pos + pz->width))
+            return(0);
+        if ((j == 0) && (i < pz->width - 1) && !has(pz, left, pos + 1))
+            return(0);
+        return(1);
+    }
+
+    // The piece above and right of pos + 1 was placed earlier
+    if ((i < pz->width - 1) && !has(pz, left, pos + 1))
+        return(0);
+    // The position below has no left neighbour on the left border
+    if ((i == 0) && (j < pz->height - 1) &&
+        !has(pz, left, pos + pz->width))
+        return(0);
+    return(1);
+}
+
+
+/**************************************************************
+ * hascandidate(): - Return 1 if a shape with pieces left has the key
+ * wanted at a position and fits there.
+ *
+ **************************************************************/
+int hascandidate(PUZZLE *pz, int *left, int pos)
+{
+    unsigned key;           // key wanted at the position
+    int   pool;             // pool searched at the position
+    int   c;                // index of the candidate in cand[]
+    int   e;                // candidate entry
+
+    key = wantkey(pz, pos);
+    pool = poolof(pz, pos);
+    for (c = pz->start[pool][key]; c < pz->start[pool][key + 1]; c++) {
+        e = pz->cand[pool][c];
+        if ((__atomic_load_n(&left[pz->cls[EPIECE(e)]], __ATOMIC_RELAXED) > 0) &&
+            fits(pz, pos, e))
+            return(1);
+    }
+    return(0);
+}
+
+
+/**************************************************************
+ * wantkey(): - Return the key of the left and top sides wanted
+ * at a position, from the pieces to the left and above.
+ *
+ **************************************************************/
+unsigned wantkey(PUZZLE *pz, int pos)
+{
+    unsigned left, top;     // keys wanted on the left and top
+
+    if (pos % pz->width == 0)
+        left = pz->flat;
+    else
+        left = jp_matekey(SIDE(pz, pz->place[pos - 1], JP_RIGHT), pz->edge);
+    if (pos < pz->width)
+        top = pz->flat;
+    else
+        top = jp_matekey(SIDE(pz, pz->place[pos - pz->width], JP_BOTTOM),
+                         pz->edge);
+    return(left | (top << pz->keybits));
+}
+
+
+/**************************************************************
+ * fits(): - Check the corner cells of an entry at a position,
+ * and the right and bottom sides on the border.  The seam cells
+ * of the left and top sides are already known to match.  Bit 0
+ * of a signature is the corner at the clockwise start of the
+ * side, so the top left corner of a piece is bit 0 of its top.
+ *
+ * Output:       1 if the entry can go at the position
+ **************************************************************/
+int fits(PUZZLE *pz, int pos, int e)
+{
+    int   i, j;             // position in the puzzle
+    int   e1 = pz->edge - 1;   // index of the last bit in a signature
+    int   n;                // number of pieces claiming a corner
+    unsigned top, right, bottom; // signatures of the candidate
+    unsigned ul, u, l;      // bottom, bottom, and right of the pieces
+                            // up-left, up, and left
+
+    top = SIDE(pz, e, JP_TOP);
+    right = SIDE(pz, e, JP_RIGHT);
+    bottom = SIDE(pz, e, JP_BOTTOM);
+    i = pos % pz->width;
+    j = pos / pz->width;
+    ul = ((i > 0) && (j > 0)) ? SIDE(pz, pz->place[pos - pz->width - 1], JP_BOTTOM) : 0;
+    u = (j > 0) ? SIDE(pz, pz->place[pos - pz->width], JP_BOTTOM) : 0;
+    l = (i > 0) ? SIDE(pz, pz->place[pos - 1], JP_RIGHT) : 0;
+
+    // The top left corner is complete once this piece is placed
+    n = (ul & 1) + ((u >> e1) & 1) + (l & 1) + (top & 1);
+    if (n != 1)
+        return(0);
+
+    // On the right border, the right side and top right corner
+    if (i == pz->width - 1) {
+        if (jp_sigkey(right, pz->edge) != pz->flat)
+            return(0);
+        if ((u & 1) + (right & 1) != 1)
+            return(0);
+    }
+
+    // On the bottom border, the bottom side and bottom corners
+    if (j == pz->height - 1) {
+        if (jp_sigkey(bottom, pz->edge) != pz->flat)
+            return(0);
+        l = (i > 0) ? SIDE(pz, pz->place[pos - 1], JP_BOTTOM) : 0;
+        if ((l & 1) + ((bottom >> e1) & 1) != 1)
+            return(0);
+        if ((i == pz->width - 1) && ((bottom & 1) != 1))
+            return(0);
+    }
+
+    return(1);
+}
+
+
+/**************************************************************
+ * search(): - Place pieces by depth first search, always filling
+ * the open position with the fewest unused pieces that fit.  The
+ * placements are kept on an explicit stack of frames, and each
+ * frame lists the codes that fit at its position with the most
+ * plentiful first.  Pieces with the same code fit in exactly the
+ * same places, so the search tries each code once instead of each
+ * piece.  With more than one thread the search tree is shared out
+ * by work stealing, see searchworker().
+ * Which of several equally good positions is filled first makes
+ * a great difference to the size of the tree, and an unlucky
+ * early choice can leave the search in a subtree it will not
+ * finish.  So each worker may only place a budget of pieces,
+ * RESTART_TRIES for each position to start with, before the
+ * search starts again with ties broken another way and the
+ * budget doubled.  A round that ends without reaching the budget
+ * has searched the whole tree.
+ *
+ * Output:       0 if every position is filled, -1 if not
+ **************************************************************/
+int search(PUZZLE *pz)
+{
+    SEARCH s;               // search state the workers start from
+    STEAL st;               // state shared by the workers
+    WORKER *w;              // each worker
+    pthread_t tid[MAX_THREADS]; // worker threads
+    int  *root;             // task holding the whole tree
+    int  *task;             // task left over from a round
+    JGRID grid;             // check on the finished puzzle
+    long  nodes = 0;        // pieces placed by all the workers
+    long  backtracks = 0;   // pieces taken back by all the workers
+    long  limit;            // pieces each worker may place this round
+    int   restarts = 0;     // rounds that reached the limit
+    int   nthread;          // number of threads started
+    int   pos;              // position in the puzzle
+    int   ret;              // return value
+    int   i;                // generic loop counter
+
+    searchinit(&s, pz);
+    memset(&st, 0, sizeof(st));
+    st.nthread = pz->nthread;
+    st.winner = -1;
+    w = (WORKER *) calloc(st.nthread, sizeof(WORKER));
+    root = (int *) calloc(1, sizeof(int));
+    if ((w == 0) || (root == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (i = 0; i < st.nthread; i++) {
+        pthread_mutex_init(&st.dq[i].lock, 0);
+        w[i].st = &st;
+        w[i].id = i;
+        searchcopy(&w[i].s, &s);
+    }
+
+    // The whole tree is one task to start each round
+    for (limit = (long) RESTART_TRIES * pz->npiece; ; limit *= 2) {
+        st.pending = 1;
+        st.stop = 0;
+        st.spent = 0;
+        pushtask(&st.dq[0], root);
+        for (i = 0; i < st.nthread; i++) {
+            w[i].s.seed = (restarts * st.nthread) + i;
+            w[i].budget = w[i].s.nodes + limit;
+        }
+        for (nthread = 1; nthread < st.nthread; nthread++) {
+            if (pthread_create(&tid[nthread], 0, searchworker,
+                               &w[nthread]) != 0)
+                break;
+        }
+        searchworker(&w[0]);
+        for (i = 1; i < nthread; i++)
+            pthread_join(tid[i], 0);
+        if ((st.winner >= 0) || !st.spent)
+            break;
+
+        // Drop the tasks left over.  The root was freed when taken.
+        for (i = 0; i < st.nthread; i++) {
+            while ((task = poptask(&st.dq[i], 0)) != 0)
+                free(task);
+        }
+        root = (int *) calloc(1, sizeof(int));
+        if (root == 0) {
+            printf("malloc failure\n");
+            exit(1);
+        }
+        restarts++;
+    }
+
+    for (i = 0; i < st.nthread; i++) {
+        nodes += w[i].s.nodes;
+        backtracks += w[i].s.backtracks;
+        if (st.winner == i)
+            memcpy(pz->place, w[i].s.place, sizeof(int) * pz->npiece);
+        searchfree(&w[i].s);
+        free(st.dq[i].task);
+        pthread_mutex_destroy(&st.dq[i].lock);
+    }
+    printf("%-10s %10ld nodes %ld backtracks %d restarts\n", "search", nodes,
+           backtracks, restarts);
+
+    // The codes check every edge cell, so the grid should agree
+    ret = (st.winner >= 0) ? 0 : -1;
+    if (jg_init(&grid, pz->width, pz->height, pz->edge) != 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (pos = 0; (ret == 0) && (pos < pz->npiece); pos++) {
+        if (jg_place(&grid, pz->mask[EPIECE(pz->place[pos])], pos,
+                     EROT(pz->place[pos])) != JG_OK)
+            ret = -1;
+    }
+    if ((ret == 0) && !jg_is_complete(&grid))
+        ret = -1;
+    jg_free(&grid);
+    searchfree(&s);
+    free(s.code);
+    free(s.first);
+    free(s.fitoff);
+    free(s.matek);
+    free(w);
+    return(ret);
+}
+
+
+/**************************************************************
+ * searchworker(): - Take tasks, from the bottom of the worker's
+ * own deque or else from the top of another's, and search each
+ * one.  A task is the list of placements leading to a subtree.
+ * The workers share the piece codes and nothing else that
+ * changes, so a task is replayed onto the worker's own state
+ * with sput() and taken off again with stake() when its subtree
+ * is done.  pending counts the tasks queued or being searched,
+ * and a task is only counted out after any tasks split from it
+ * are counted in, so the search is over when it reaches zero.
+ *
+ **************************************************************/
+void *searchworker(void *arg)
+{
+    WORKER *w = (WORKER *) arg;
+    STEAL *st = w->st;      // state shared by the workers
+    SEARCH *s = &w->s;      // this worker's search state
+    int  *task;             // task being searched
+    int   none = -1;        // winner before the puzzle is solved
+    int   k;                // placement in the task
+    int   i;                // deque to steal from
+
+    while (!__atomic_load_n(&st->stop, __ATOMIC_ACQUIRE)) {
+        task = poptask(&st->dq[w->id], 0);
+        if (task == 0) {
+            __atomic_add_fetch(&st->idle, 1, __ATOMIC_RELAXED);
+            for (i = (w->id + 1) % st->nthread; task == 0;
+                 i = (i + 1) % st->nthread) {
+                if (__atomic_load_n(&st->stop, __ATOMIC_ACQUIRE) ||
+                    (__atomic_load_n(&st->pending, __ATOMIC_ACQUIRE) == 0))
+                    break;
+                task = poptask(&st->dq[i], 1);
+                if ((task == 0) && (i == w->id))
+                    sched_yield();
+            }
+            __atomic_sub_fetch(&st->idle, 1, __ATOMIC_RELAXED);
+            if (task == 0)
+                break;
+        }
+
+        for (k = 0; k < task[0]; k++) {
+            s->stack[k].pos = task[1 + (2 * k)];
+            s->stack[k].cbase = 0;
+            s->stack[k].ncand = 0;
+            sput(s, task[1 + (2 * k)], task[2 + (2 * k)]);
+        }
+        if (dfs(w, task[0]) &&
+            __atomic_compare_exchange_n(&st->winner, &none, w->id, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            __atomic_store_n(&st->stop, 1, __ATOMIC_RELEASE);
+        if (__atomic_load_n(&st->winner, __ATOMIC_ACQUIRE) != w->id) {
+            for (k = task[0] - 1; k >= 0; k--)
+                stake(s, task[1 + (2 * k)]);
+        }
+        free(task);
+        __atomic_sub_fetch(&st->pending, 1, __ATOMIC_ACQ_REL);
+    }
+    return(0);
+}
+
+
+/**************************************************************
+ * dfs(): - Search the subtree below the placements already made
+ * by the worker, never backing up past depth base.  Every so
+ * often, if another worker is idle, the untried code nearest the
+ * base is split off as a task for it to steal.  A worker that
+ * has placed its budget of pieces stops every worker, and
+ * search() starts again in a new order.
+ *
+ * Output:       1 if every position is filled, 0 if the subtree
+ *               has no solution or the search was stopped
+ **************************************************************/
+int dfs(WORKER *w, int base)
+{
+    SEARCH *s = &w->s;      // this worker's search state
+    PUZZLE *pz = s->pz;     // the puzzle being solved
+    FRAME *f;               // frame at the current depth
+    int   depth = base;     // number of pieces placed
+    int   fresh = 1;        // set when depth needs a new frame
+    int   placed;           // set when a candidate was placed
+
+    while (depth < pz->npiece) {
+        f = &s->stack[depth];
+        if (fresh) {
+            f->cbase = (depth == base) ? 0 :
+                       s->stack[depth - 1].cbase + s->stack[depth - 1].ncand;
+            f->pos = choose(s, &f->ncand);
+            f->next = 0;
+            if (f->ncand > 0)
+                f->ncand = candidates(s, f->pos, f->cbase);
+        }
+
+        // Try the next code at the position
+        placed = 0;
+        while (f->next < f->ncand) {
+            sput(s, f->pos, s->ccode[f->cbase + f->next++]);
+            s->nodes++;
+            if (pigeonhole(s)) {
+                placed = 1;
+                break;
+            }
+            stake(s, f->pos);
+        }
+        if (placed) {
+            depth++;
+            fresh = 1;
+            if ((s->nodes % SPLIT_NODES) == 0) {
+                if (s->nodes >= w->budget) {
+                    __atomic_store_n(&w->st->spent, 1, __ATOMIC_RELAXED);
+                    __atomic_store_n(&w->st->stop, 1, __ATOMIC_RELEASE);
+                }
+                if (__atomic_load_n(&w->st->stop, __ATOMIC_ACQUIRE))
+                    break;
+                if (__atomic_load_n(&w->st->idle, __ATOMIC_RELAXED) > 0)
+                    split(w, base, depth);
+            }
+            continue;
+        }
+
+        // Nothing fits.  Back up and try the next code there.
+        if (depth == base)
+            break;
+        depth--;
+        stake(s, s->stack[depth].pos);
+        s->backtracks++;
+        fresh = 0;
+    }
+    if (depth == pz->npiece)
+        return(1);
+
+    // Stopped by another worker, so take back this subtree
+    while (depth > base) {
+        depth--;
+        stake(s, s->stack[depth].pos);
+    }
+    return(0);
+}
+
+
+/**************************************************************
+ * split(): - Give the last untried code of the shallowest frame
+ * above base that has one to the worker's deque as a new task.
+ * Shallow frames have the largest subtrees, so a thief gets a
+ * good share of work for the cost of replaying a short task.
+ *
+ **************************************************************/
+void split(WORKER *w, int base, int depth)
+{
+    SEARCH *s = &w->s;      // this worker's search state
+    FRAME *f;               // frame the code is taken from
+    int  *task;             // the new task
+    int   d;                // depth of the frame
+    int   k;                // placement in the task
+
+    for (d = base; d < depth; d++)
+        if (s->stack[d].next < s->stack[d].ncand)
+            break;
+    if (d == depth)
+        return;
+
+    f = &s->stack[d];
+    task = (int *) malloc(sizeof(int) * (3 + (2 * d)));
+    if (task == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    task[0] = d + 1;
+    for (k = 0; k < d; k++) {
+        task[1 + (2 * k)] = s->stack[k].pos;
+        task[2 + (2 * k)] = s->pcode[s->stack[k].pos];
+    }
+    f->ncand--;
+    task[1 + (2 * d)] = f->pos;
+    task[2 + (2 * d)] = s->ccode[f->cbase + f->ncand];
+    __atomic_add_fetch(&w->st->pending, 1, __ATOMIC_ACQ_REL);
+    pushtask(&w->st->dq[w->id], task);
+}
+
+
+/**************************************************************
+ * pushtask(): - Add a task to the bottom of a deque
+ *
+ **************************************************************/
+void pushtask(DEQUE *dq, int *task)
+{
+    int **grow;             // larger ring of tasks
+    int   k;                // task being moved
+
+    pthread_mutex_lock(&dq->lock);
+    if (dq->count == dq->size) {
+        grow = (int **) malloc(sizeof(int *) * (2 * dq->size + 16));
+        if (grow == 0) {
+            printf("malloc failure\n");
+            exit(1);
+        }
+        for (k = 0; k < dq->count; k++)
+            grow[k] = dq->task[(dq->head + k) % dq->size];
+        free(dq->task);
+        dq->task = grow;
+        dq->size = (2 * dq->size) + 16;
+        dq->head = 0;
+    }
+    dq->task[(dq->head + dq->count) % dq->size] = task;
+    __atomic_store_n(&dq->count, dq->count + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&dq->lock);
+}
+
+
+/**************************************************************
+ * poptask(): - Take a task from the bottom of a deque, the most
+ * recent, or from the top, the oldest, when stealing.
+ *
+ * Output:       the task, or NULL if the deque is empty
+ **************************************************************/
+int *poptask(DEQUE *dq, int top)
+{
+    int  *task = 0;         // task taken
+
+    // Look before taking the lock, as most deques are empty
+    if (__atomic_load_n(&dq->count, __ATOMIC_RELAXED) == 0)
+        return(0);
+    pthread_mutex_lock(&dq->lock);
+    if (dq->count > 0) {
+        if (top) {
+            task = dq->task[dq->head];
+            dq->head = (dq->head + 1) % dq->size;
+        }
+        else
+            task = dq->task[(dq->head + dq->count - 1) % dq->size];
+        __atomic_store_n(&dq->count, dq->count - 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return(task);
+}
+
+
+/**************************************************************
+ * searchinit(): - Get the code of every entry and group the
+ * entries by code.  A code is the four corner cells and the keys
+ * of the four sides of an entry, which for a small edge is every
+ * edge cell of the piece.
+ *
+ **************************************************************/
+void searchinit(SEARCH *s, PUZZLE *pz)
+{
+    int   nent = pz->npiece * 4;   // number of entries
+    int   nkey = 1 << pz->keybits; // number of keys of one side
+    int   e;                // entry
+    int   c;                // code
+    int   k;                // side
+    int   set;              // set of sides
+    int   pos;              // position in the puzzle
+
+    memset(s, 0, sizeof(*s));
+    s->pz = pz;
+    s->ncode = 1 << CODE_KEY(pz, 4);
+    s->fitoff = (int *) malloc(sizeof(int) * 17);
+    if (s->fitoff == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    s->fitoff[0] = 0;
+    for (set = 0; set < 16; set++)
+        s->fitoff[set + 1] = s->fitoff[set] +
+                             (1 << (4 + (pz->keybits * __builtin_popcount(set))));
+    s->fitc = (int *) calloc(s->fitoff[16], sizeof(int));
+    s->code = (int *) malloc(sizeof(int) * nent);
+    s->list = (int *) malloc(sizeof(int) * nent);
+    s->slot = (int *) malloc(sizeof(int) * nent);
+    s->first = (int *) calloc(s->ncode + 1, sizeof(int));
+    s->len = (int *) calloc(s->ncode, sizeof(int));
+    s->pcode = (int *) malloc(sizeof(int) * pz->npiece);
+    s->matek = (unsigned *) malloc(sizeof(unsigned) * nkey);
+    s->supply = (int *) calloc(nkey, sizeof(int));
+    s->demand = (int *) calloc(nkey, sizeof(int));
+    s->front = (int *) malloc(sizeof(int) * pz->npiece);
+    s->fslot = (int *) malloc(sizeof(int) * pz->npiece);
+    s->stack = (FRAME *) malloc(sizeof(FRAME) * pz->npiece);
+    s->nccode = s->ncode;
+    s->ccode = (int *) malloc(sizeof(int) * s->nccode);
+    s->place = (int *) malloc(sizeof(int) * pz->npiece);
+    pz->place = (int *) malloc(sizeof(int) * pz->npiece);
+    if ((s->code == 0) || (s->list == 0) || (s->slot == 0) ||
+        (s->first == 0) || (s->len == 0) || (s->fitc == 0) ||
+        (s->pcode == 0) || (s->matek == 0) || (s->supply == 0) || (s->demand == 0) ||
+        (s->front == 0) || (s->fslot == 0) || (s->stack == 0) ||
+        (s->ccode == 0) || (s->place == 0) || (pz->place == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+
+    for (k = 0; k < nkey; k++)
+        s->matek[k] = jp_matekey(k << 1, pz->edge);
+    for (e = 0; e < nent; e++) {
+        c = (SIDE(pz, e, JP_TOP) & 1) ? CODE_TL : 0;
+        c |= (SIDE(pz, e, JP_RIGHT) & 1) ? CODE_TR : 0;
+        c |= (SIDE(pz, e, JP_BOTTOM) & 1) ? CODE_BR : 0;
+        c |= (SIDE(pz, e, JP_LEFT) & 1) ? CODE_BL : 0;
+        for (k = 0; k < 4; k++) {
+            c |= jp_sigkey(SIDE(pz, e, k), pz->edge) << CODE_KEY(pz, k);
+            if (EROT(e) == 0)
+                s->supply[jp_sigkey(SIDE(pz, e, k), pz->edge)]++;
+        }
+        s->code[e] = c;
+        s->first[c]++;
+        fitadd(s, c, 1);
+    }
+
+    // Group the entries by code as in indexpool()
+    for (c = 1; c <= s->ncode; c++)
+        s->first[c] += s->first[c - 1];
+    for (e = nent - 1; e >= 0; e--) {
+        s->slot[e] = --s->first[s->code[e]];
+        s->list[s->slot[e]] = e;
+        s->len[s->code[e]]++;
+    }
+
+    // Every side on the border wants a straight side
+    s->demand[pz->flat] = 2 * (pz->width + pz->height);
+    for (pos = 0; pos < pz->npiece; pos++) {
+        pz->place[pos] = -1;
+        s->place[pos] = -1;
+        s->pcode[pos] = -1;
+        s->fslot[pos] = -1;
+    }
+    for (pos = 0; pos < pz->npiece; pos++)
+        setfront(s, pos);
+}
+
+
+/**************************************************************
+ * searchcopy(): - Give a worker its own copy of the parts of a
+ * search state that change.  The codes of the entries, where
+ * each code starts in list[], and the mate of each key never
+ * change and are shared.
+ *
+ **************************************************************/
+void searchcopy(SEARCH *dst, SEARCH *src)
+{
+    PUZZLE *pz = src->pz;   // the puzzle being solved
+    int   nent = pz->npiece * 4;   // number of entries
+    int   nkey = 1 << pz->keybits; // number of keys of one side
+
+    *dst = *src;
+    dst->list = (int *) malloc(sizeof(int) * nent);
+    dst->slot = (int *) malloc(sizeof(int) * nent);
+    dst->len = (int *) malloc(sizeof(int) * src->ncode);
+    dst->fitc = (int *) malloc(sizeof(int) * src->fitoff[16]);
+    dst->pcode = (int *) malloc(sizeof(int) * pz->npiece);
+    dst->supply = (int *) malloc(sizeof(int) * nkey);
+    dst->demand = (int *) malloc(sizeof(int) * nkey);
+    dst->front = (int *) malloc(sizeof(int) * pz->npiece);
+    dst->fslot = (int *) malloc(sizeof(int) * pz->npiece);
+    dst->stack = (FRAME *) malloc(sizeof(FRAME) * pz->npiece);
+    dst->ccode = (int *) malloc(sizeof(int) * src->nccode);
+    dst->place = (int *) malloc(sizeof(int) * pz->npiece);
+    if ((dst->list == 0) || (dst->slot == 0) || (dst->len == 0) ||
+        (dst->fitc == 0) || (dst->pcode == 0) || (dst->supply == 0) || (dst->demand == 0) ||
+        (dst->front == 0) || (dst->fslot == 0) || (dst->stack == 0) ||
+        (dst->ccode == 0) || (dst->place == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    memcpy(dst->list, src->list, sizeof(int) * nent);
+    memcpy(dst->slot, src->slot, sizeof(int) * nent);
+    memcpy(dst->len, src->len, sizeof(int) * src->ncode);
+    memcpy(dst->fitc, src->fitc, sizeof(int) * src->fitoff[16]);
+    memcpy(dst->pcode, src->pcode, sizeof(int) * pz->npiece);
+    memcpy(dst->supply, src->supply, sizeof(int) * nkey);
+    memcpy(dst->demand, src->demand, sizeof(int) * nkey);
+    memcpy(dst->front, src->front, sizeof(int) * pz->npiece);
+    memcpy(dst->fslot, src->fslot, sizeof(int) * pz->npiece);
+    memcpy(dst->place, src->place, sizeof(int) * pz->npiece);
+}
+
+
+/**************************************************************
+ * searchfree(): - Free the parts of a search state that change.
+ * The shared parts are freed with the state they were copied
+ * from.
+ *
+ **************************************************************/
+void searchfree(SEARCH *s)
+{
+    free(s->list);
+    free(s->slot);
+    free(s->len);
+    free(s->fitc);
+    free(s->pcode);
+    free(s->supply);
+    free(s->demand);
+    free(s->front);
+    free(s->fslot);
+    free(s->stack);
+    free(s->ccode);
+    free(s->place);
+}
+
+
+/**************************************************************
+ * choose(): - Return the position in front[] with the fewest
+ * unused entries that fit.
+ * Ties go to the position with more known sides, then to one
+ * picked at random with the search's seed, so each restart of
+ * search() grows the puzzle in a different order.  A position
+ * where nothing fits is returned at once so the caller can back
+ * up.
+ *
+ * Output:       position, and the number of entries that fit
+ **************************************************************/
+int choose(SEARCH *s, int *nfit)
+{
+    int   best = -1;        // position chosen
+    int   bestn = 0;        // entries that fit at best
+    int   bestk = 0;        // known sides of best
+    int   ties = 0;         // positions as good as best so far
+    int   pos;              // position in the puzzle
+    int   n;                // entries that fit at pos
+    int   k;                // known sides of pos
+    int   care, val;        // code bits fixed at pos and their values
+    int   x;                // index into front[]
+
+    for (x = 0; x < s->nfront; x++) {
+        pos = s->front[x];
+        n = domain(s, pos, &care, &val);
+        if (n == 0) {
+            *nfit = 0;
+            return(pos);
+        }
+        k = known(s, pos);
+        if ((best < 0) || (n < bestn) || ((n == bestn) && (k > bestk))) {
+            best = pos;
+            bestn = n;
+            bestk = k;
+            ties = 1;
+        }
+        else if ((n == bestn) && (k == bestk) &&
+                 ((rand_r(&s->seed) % ++ties) == 0))
+            best = pos;
+    }
+    *nfit = bestn;
+    return(best);
+}
+
+
+/**************************************************************
+ * candidates(): - List the codes that fit at a position in
+ * ccode[] starting at cbase, the most plentiful first.
+ *
+ * Output:       number of codes listed
+ **************************************************************/
+int candidates(SEARCH *s, int pos, int cbase)
+{
+    int   care, val;        // code bits fixed at pos and their values
+    int   free;             // code bits not fixed
+    int   sub;              // subset of the free bits
+    int   n = 0;            // codes listed
+    int   c;                // code
+    int   x;                // index for the insertion sort
+
+    domain(s, pos, &care, &val);
+    free = (s->ncode - 1) & ~care;
+    if (cbase + (free + 1) > s->nccode) {
+        s->nccode = 2 * (cbase + free + 1);
+        s->ccode = (int *) realloc(s->ccode, sizeof(int) * s->nccode);
+        if (s->ccode == 0) {
+            printf("malloc failure\n");
+            exit(1);
+        }
+    }
+
+    for (sub = free; ; sub = (sub - 1) & free) {
+        c = val | sub;
+        if (s->len[c] > 0) {
+            for (x = cbase + n; (x > cbase) && (s->len[s->ccode[x - 1]] < s->len[c]); x--)
+                s->ccode[x] = s->ccode[x - 1];
+            s->ccode[x] = c;
+            n++;
+        }
+        if (sub == 0)
+            break;
+    }
+    return(n);
+}
+
+
+/**************************************************************
+ * domain(): - Get the code bits fixed at a position by its known
+ * sides and corners, and count the unused entries that have them.
+ *
+ * Output:       number of entries that fit, care and val
+ **************************************************************/
+int domain(SEARCH *s, int pos, int *care, int *val)
+{
+    fixedbits(s, pos, care, val);
+    return(fitcount(s, *care, *val));
+}
+
+
+/**************************************************************
+ * fixedbits(): - Get the code bits fixed at a position by its
+ * known sides and corners.
+ *
+ * Output:       care and val
+ **************************************************************/
+void fixedbits(SEARCH *s, int pos, int *care, int *val)
+{
+    PUZZLE *pz = s->pz;     // the puzzle being solved
+    int   i, j;             // position in the puzzle
+    int   kmask;            // mask of one key
+    int   k;                // side
+    int   q;                // neighbour on side k, or -1 on the border
+    int   want;             // corner wanted, 0, 1, or 2 for either
+
+    i = pos % pz->width;
+    j = pos / pz->width;
+    kmask = (1 << pz->keybits) - 1;
+    *care = 0;
+    *val = 0;
+    for (k = 0; k < 4; k++) {
+        q = neighbour(pz, pos, k);
+        if (q < 0) {
+            *care |= kmask << CODE_KEY(pz, k);
+            *val |= pz->flat << CODE_KEY(pz, k);
+        }
+        else if (s->pcode[q] >= 0) {
+            *care |= kmask << CODE_KEY(pz, k);
+            *val |= s->matek[(s->pcode[q] >> CODE_KEY(pz, (k + 2) % 4)) & kmask]
+                    << CODE_KEY(pz, k);
+        }
+    }
+
+    // Each corner goes to exactly one of the pieces that meet there
+    for (k = 0; k < 4; k++) {
+        want = cornerwant(s, i + ((k == 1) || (k == 2)), j + (k >= 2), pos);
+        if (want != 2) {
+            *care |= 1 << k;
+            *val |= want << k;
+        }
+    }
+}
+
+
+/**************************************************************
+ * fitcount(): - Count the unused entries with the fixed bits.
+ * A side of a position is either known or not, so the count of
+ * the unused entries with each corner cells and keys is kept for
+ * every set of sides, see fitadd(), and only the corners that are
+ * not fixed are summed over.
+ *
+ * Output:       number of entries that fit
+ **************************************************************/
+int fitcount(SEARCH *s, int care, int val)
+{
+    PUZZLE *pz = s->pz;     // the puzzle being solved
+    int   kmask;            // mask of one key
+    int   set = 0;          // sides with a known key
+    int   at = 0;           // index of the keys among those of set
+    int   stride = 1 << 4;  // counts for the keys of set before side k
+    int   free;             // corners not fixed
+    int   sub;              // subset of the free corners
+    int   n = 0;            // entries that fit
+    int   k;                // side
+
+    kmask = (1 << pz->keybits) - 1;
+    for (k = 0; k < 4; k++) {
+        if ((care >> CODE_KEY(pz, k)) & kmask) {
+            set |= 1 << k;
+            at += ((val >> CODE_KEY(pz, k)) & kmask) * stride;
+            stride <<= pz->keybits;
+        }
+    }
+    at += s->fitoff[set] + (val & CODE_CORNERS);
+    free = CODE_CORNERS & ~care;
+    for (sub = free; ; sub = (sub - 1) & free) {
+        n += s->fitc[at + sub];
+        if (sub == 0)
+            break;
+    }
+    return(n);
+}
+
+
+/**************************************************************
+ * fitadd(): - Add d to the counts of a code for every set of
+ * sides.  The keys of a set are numbered with those of the set
+ * without its last side, then the last side's key, after the
+ * four corner cells.
+ *
+ **************************************************************/
+void fitadd(SEARCH *s, int c, int d)
+{
+    PUZZLE *pz = s->pz;     // the puzzle being solved
+    int   at[16];           // index of c in the counts of each set
+    int   shift[16];        // bits of the corners and keys of each set
+    int   set;              // set of sides
+    int   k;                // last side of set
+    int   rest;             // set without k
+
+    at[0] = c & CODE_CORNERS;
+    shift[0] = 4;
+    s->fitc[at[0]] += d;
+    for (set = 1; set < 16; set++) {
+        k = 31 - __builtin_clz(set);
+        rest = set & ~(1 << k);
+        at[set] = at[rest] + (((c >> CODE_KEY(pz, k)) & ((1 << pz->keybits) - 1))
+                              << shift[rest]);
+        shift[set] = shift[rest] + pz->keybits;
+        s->fitc[s->fitoff[set] + at[set]] += d;
+    }
+}
+
+
+/**************************************************************
+ * cornerwant(): - Return what a piece at pos must have at the
+ * corner at vertex (vx, vy): 0 if a placed piece has it, 1 if
+ * every other piece there is placed without it, 2 for either.
+ *
+ **************************************************************/
+int cornerwant(SEARCH *s, int vx, int vy, int pos)
+{
+    PUZZLE *pz = s->pz;     // the puzzle being solved
+    int   open = 0;         // other open positions at the vertex
+    int   k;                // corner of the piece at the vertex
+    int   i, j;             // position of the piece
+    int   q;                // position in the puzzle
+
+    // The piece with its corner k at the vertex
+    for (k = 0; k < 4; k++) {
+        i = vx - ((k == 1) || (k == 2));
+        j = vy - (k >= 2);
+        if ((i < 0) || (j < 0) || (i >= pz->width) || (j >= pz->height))
+            continue;
+        q = i + (j * pz->width);
+        if (q == pos)
+            continue;
+        if (s->pcode[q] < 0)
+            open++;
+        else if (s->pcode[q] & (1 << k))
+            return(0);
+    }
+    return(open ? 2 : 1);
+}
+
+
+/**************************************************************
+ * neighbour(): - Return the position next to pos on a side, or
+ * -1 if that side is on the border.
+ *
+ **************************************************************/
+int neighbour(PUZZLE *pz, int pos, int side)
+{
+    int   i, j;             // position in the puzzle
+
+    i = pos % pz->width;
+    j = pos / pz->width;
+    if (side == JP_TOP)
+        return((j > 0) ? pos - pz->width : -1);
+    else if (side == JP_RIGHT)
+        return((i < pz->width - 1) ? pos + 1 : -1);
+    else if (side == JP_BOTTOM)
+        return((j < pz->height - 1) ? pos + pz->width : -1);
+    return((i > 0) ? pos - 1 : -1);
+}
+
+
+/**************************************************************
+ * known(): - Return the number of sides of a position that are
+ * on the border or next to a placed piece.
+ *
+ **************************************************************/
+int known(SEARCH *s, int pos)
+{
+    int   n = 0;            // known sides
+    int   k;                // side
+    int   q;                // neighbour on side k
+
+    for (k = 0; k < 4; k++) {
+        q = neighbour(s->pz, pos, k);
+        if ((q < 0) || (s->pcode[q] >= 0))
+            n++;
+    }
+    return(n);
+}
+
+
+/**************************************************************
+ * setfront(): - Add a position to front[] if it is open with at
+ * least one known side, or take it out if not.  An open position
+ * with no known side fits every unused entry, so it is never the
+ * one with the fewest candidates and need not be looked at.
+ *
+ **************************************************************/
+void setfront(SEARCH *s, int pos)
+{
+    int   in;               // set if pos belongs in front[]
+    int   last;             // position in the last slot
+
+    in = (s->pcode[pos] < 0) && (known(s, pos) >= 1);
+    if (in && (s->fslot[pos] < 0)) {
+        s->fslot[pos] = s->nfront;
+        s->front[s->nfront++] = pos;
+    }
+    else if (!in && (s->fslot[pos] >= 0)) {
+        last = s->front[--s->nfront];
+        s->front[s->fslot[pos]] = last;
+        s->fslot[last] = s->fslot[pos];
+        s->fslot[pos] = -1;
+    }
+}
+
+
+/**************************************************************
+ * sput(): - Place an unused piece with a code at a position.
+ * The four entries of the piece are swapped to the end of their
+ * codes' lists so stake() can put them back by counting them in
+ * again, as long as pieces are taken back in the reverse order.
+ *
+ **************************************************************/
+void sput(SEARCH *s, int pos, int c)
+{
+    PUZZLE *pz = s->pz;     // the puzzle being solved
+    int   kmask;            // mask of one key
+    int   e;                // entry placed
+    int   x;                // entry being taken out of its list
+    int   y;                // entry in the last slot of the list
+    int   cx;               // code of x
+    int   last;             // last slot of the list
+    int   r;                // rotation
+    int   k;                // side
+    int   q;                // neighbour on side k
+    int   key;              // key of side k
+
+    e = s->list[s->first[c] + s->len[c] - 1];
+    for (r = 0; r < 4; r++) {
+        x = ENTRY(EPIECE(e), r);
+        cx = s->code[x];
+        last = s->first[cx] + s->len[cx] - 1;
+        y = s->list[last];
+        s->list[s->slot[x]] = y;
+        s->slot[y] = s->slot[x];
+        s->list[last] = x;
+        s->slot[x] = last;
+        s->len[cx]--;
+        fitadd(s, cx, -1);
+    }
+    s->place[pos] = e;
+    s->pcode[pos] = c;
+
+    // A known side of pos is no longer wanted, and an open
+    // neighbour now wants the mate of the side it touches.
+    kmask = (1 << pz->keybits) - 1;
+    for (k = 0; k < 4; k++) {
+        key = (c >> CODE_KEY(pz, k)) & kmask;
+        s->supply[key]--;
+        q = neighbour(pz, pos, k);
+        if ((q < 0) || (s->pcode[q] >= 0))
+            s->demand[key]--;
+        else
+            s->demand[s->matek[key]]++;
+        if (q >= 0)
+            setfront(s, q);
+    }
+    setfront(s, pos);
+}
+
+
+/**************************************************************
+ * stake(): - Take back the piece placed at a position by the
+ * most recent sput() still in effect.
+ *
+ **************************************************************/
+void stake(SEARCH *s, int pos)
+{
+    PUZZLE *pz = s->pz;     // the puzzle being solved
+    int   kmask;            // mask of one key
+    int   c;                // code placed at pos
+    int   e;                // entry placed at pos
+    int   r;                // rotation
+    int   k;                // side
+    int   q;                // neighbour on side k
+    int   key;              // key of side k
+
+    c = s->pcode[pos];
+    e = s->place[pos];
+    kmask = (1 << pz->keybits) - 1;
+    for (k = 0; k < 4; k++) {
+        key = (c >> CODE_KEY(pz, k)) & kmask;
+        s->supply[key]++;
+        q = neighbour(pz, pos, k);
+        if ((q < 0) || (s->pcode[q] >= 0))
+            s->demand[key]++;
+        else
+            s->demand[s->matek[key]]--;
+    }
+    for (r = 3; r >= 0; r--) {
+        s->len[s->code[ENTRY(EPIECE(e), r)]]++;
+        fitadd(s, s->code[ENTRY(EPIECE(e), r)], 1);
+    }
+    s->place[pos] = -1;
+    s->pcode[pos] = -1;
+
+    setfront(s, pos);
+    for (k = 0; k < 4; k++) {
+        q = neighbour(pz, pos, k);
+        if (q >= 0)
+            setfront(s, q);
+    }
+}
+
+
+/**************************************************************
+ * pigeonhole(): - Check the sides of the unused pieces against
+ * the sides of the open positions.  Each wanted side needs an
+ * unused side with its key, so a key may not be short.  The sides
+ * left over must go between two open positions, where a side with
+ * a key meets one with its mate, so each key must have as many
+ * left over as its mate, and a key that is its own mate an even
+ * number.  Placing a piece that fits its neighbours keeps both of
+ * these, so they are only a cheap check that the counts are right;
+ * a short key is what ends a branch.
+ *
+ * Output:       1 if the counts allow the puzzle to be finished
+ **************************************************************/
+int pigeonhole(SEARCH *s)
+{
+    int   spare;            // sides of unused pieces with key k that
+                            // no open position wants
+    int   k;                // key
+    unsigned m;             // mate of key k
+
+    for (k = 0; k < (1 << s->pz->keybits); k++) {
+        m = s->matek[k];
+        spare = s->supply[k] - s->demand[k];
+        if ((spare < 0) || (spare != s->supply[m] - s->demand[m]) ||
+            ((m == (unsigned) k) && (spare & 1)))
+            return(0);
+    }
+    return(1);
+}
+
+
+/**************************************************************
+ * outputsolution(): - Write solution.txt
+ *
+ **************************************************************/
+void outputsolution(PUZZLE *pz)
+{
+    uint32_t *sol;          // solution in jigsawsol.c form
+    int   pos;              // position in the puzzle
+
+    sol = (uint32_t *) malloc(sizeof(uint32_t) * pz->npiece);
+    if (sol == 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    for (pos = 0; pos < pz->npiece; pos++)
+        sol[pos] = JS_ENTRY(EPIECE(pz->place[pos]), EROT(pz->place[pos]));
+    if (js_writetxt("solution.txt", sol, pz->npiece) != 0) {
+        printf("Error writing solution.txt: %s\n", strerror(errno));
+        exit(1);
+    }
+    free(sol);
+}
+
+
+/**************************************************************
+ * stagetime(): - Print the time since the last call with the
+ * name of the stage that just finished.  With a NULL name the
+ * clock is started on the first call, and later calls return
+ * the total time in milliseconds without printing.
+ *
+ **************************************************************/
+double stagetime(const char *stage)
+{
+    static struct timespec start;  // time of the first call
+    static struct timespec last;   // time of the previous call
+    struct timespec now;    // current time
+    double ms;              // milliseconds since the last call
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if ((stage == 0) && (start.tv_sec == 0) && (start.tv_nsec == 0)) {
+        start = now;
+        last = now;
+        return(0);
+    }
+    if (stage == 0) {
+        return(((now.tv_sec - start.tv_sec) * 1000.0) +
+               ((now.tv_nsec - start.tv_nsec) / 1e6));
+    }
+    ms = ((now.tv_sec - last.tv_sec) * 1000.0) +
+         ((now.tv_nsec - last.tv_nsec) / 1e6);
+    last = now;
+    printf("%-10s %10.3f ms\n", stage, ms);
+    return(ms);
+}
@@ -16,7 +16,9 @@
  *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
  *              GNU General Public License for more details.
  *
- * Build:       gcc -o validatejigsaw validatejigsaw.c
+ * Build:       gcc -o validatejigsaw validatejigsaw.c jigsawgrid.c \
+ *                  jigsawload.c jigsawpiece.c jigsawzip.c jigsawsol.c \
+ *                  -lz -lpthread
  *
  */
 
@@ -96,6 +98,48 @@
  * The main() routine gets the input parameters, computes the size of the
  * grid, and allocates memory for it.
  *
+ * The grid itself is kept by the placement oracle in jigsawgrid.c.  It
+ * stores one bit per grid cell and only tests the perimeter cells of
+ * each piece, since the interior cells of a piece can not overlap with
+ * any other piece.  Solvers can use the same oracle to test placements.
+ *
+ * The getgrid() routine reads solution.txt and places each piece in turn,
+ * stopping at the first collision.
+ *
+ * The testgrid() routine checks that every cell in the grid is filled.
+ *
+ * With the -s option the grid is not used at all.  The seamgrid() routine
+ * instead compares the edge strips of each piece with those of its left
+ * and upper neighbours, keeping only the bottom strips of the row above.
+ * This takes O(pieces * edge) time and gives the same valid/invalid
+ * answer as the grid, although an invalid puzzle may report a different
+ * first error.  The seams themselves need only O(width * edge) memory,
+ * but the solution and the mask of every piece are still read whole
+ * first, as for the grid, so -s saves the grid and nothing more.
+ *
+ * With the -z option the pieces are read from the challenge zip file
+ * instead of from .pbm files on disk.  The loadzip() routine decrypts and
+ * inflates every entry in parallel (see jigsawzip.c), converts each one
+ * to a piece mask in memory, and sorts the names so readpbm() can find a
+ * piece with a binary search.  Nothing is written to disk.
+ *
+ * Without -z the loadfiles() routine reads the .pbm file of every piece
+ * in the solution before any is placed, using jl_foreach() to keep
+ * hundreds of files in flight through io_uring (or a pool of threads),
+ * instead of waiting on an open, read, and close for each piece in turn.
+ * The mask or error of each file is kept by its place in the solution and
+ * readpbm() reports a missing or malformed file when the piece is reached,
+ * as it would reading the files one at a time.  With -v the time to read
+ * the pieces, in files per second, is printed on stderr.
+ *
+ * With the -b option the solution is read from a binary solution file,
+ * as written by makejigsaw and convertjigsaw, instead of solution.txt.
+ * The loadsolution() routine reads the whole solution before any piece is
+ * placed and the nextpiece() routine hides the difference between the two
+ * formats from getgrid() and seamgrid().  solution.txt is parsed in one
+ * pass by the tokenizer in jigsawsol.c; an angle other than 0, 90, 180,
+ * or 270 makes the solution invalid.  With -v the time to read the
+ * solution, in lines per second, is printed on stderr.
  */
 
 
@@ -106,6 +150,12 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <time.h>
+#include "jigsawgrid.h"
+#include "jigsawload.h"
+#include "jigsawpiece.h"
+#include "jigsawzip.h"
+#include "jigsawsol.h"
 
 
 
@@ -124,9 +174,31 @@
 /**************************************************************
  *  - Globals, function prototypes, and forward references
  **************************************************************/
-void initgrid(int *, int, int, int);
-void getgrid(int *, int, int, int);
-void testgrid(int *, int, int, int);
+void getgrid(JGRID *);
+void seamgrid(int, int, int);
+void seamcheck(unsigned, unsigned, unsigned, int, int, int, int, int, int);
+void testgrid(JGRID *);
+uint64_t readpbm(char *, int);
+void loadzip(char *, char *, int);
+int  zippiece(void *, int, const char *, size_t);
+int  zipcmp(const void *, const void *);
+void loadsolution(char *, int);
+void loadfiles(int, int);
+void filename(void *, int, char *, size_t);
+int  filepiece(void *, int, const char *, size_t);
+int  nextpiece(char *, int *);
+
+        // Pieces read from a zip file, sorted by name, if -z is given
+JZIP      zipfile;
+int      *zipsort;          // entry numbers sorted by file name
+uint64_t *zipmask;          // piece mask of each entry
+char     *zipok;            // set if the entry is a valid .pbm file
+        // The solution, from solution.txt or a binary file
+JSOL      sol;
+int       solnext;          // next entry in sol
+        // Pieces read from .pbm files, by place in the solution, if no -z
+uint64_t *filemask;         // piece mask of each entry
+signed char *filestat;      // JP_OK, JP_NOFILE, or JP_FORMAT
 
 
 
@@ -140,20 +212,39 @@ void testgrid(int *, int, int, int);
  **************************************************************/
 int main(int argc, char **argv)
 {
-    int  *grid;             // The grid of points
+    JGRID grid;             // The grid of points
     int   width;            // Width of the puzzle in pieces
     int   height;           // Height of the puzzle in pieces
     int   edge;             // Resolution of a piece edge
-    int   gw;               // Grid width
-    int   gh;               // Grid height
-    int   i,j;              // Generic loop counters
-
-
-    // Get the width, height, and edge resolution from the user
-    if (! ((argc == 4) &&
-           (sscanf(argv[1], "%d", &width) == 1) &&
-           (sscanf(argv[2], "%d", &height) == 1) &&
-           (sscanf(argv[3], "%d", &edge) == 1) &&
+    int   seamonly = 0;     // Check seams only, without a grid
+    int   opt;              // command line option
+    int   badopt = 0;       // set on an unknown option
+    char *zipname = 0;      // zip file with the pieces, if any
+    char *password = 0;     // password for the zip file
+    char *binname = 0;      // binary solution file, if any
+    int   verbose = 0;      // print timings
+
+
+    // Get the options, then the width, height, and edge resolution
+    while ((opt = getopt(argc, argv, "sz:p:b:v")) != -1) {
+        if (opt == 's')
+            seamonly = 1;
+        else if (opt == 'v')
+            verbose = 1;
+        else if (opt == 'b')
+            binname = optarg;
+        else if (opt == 'z')
+            zipname = optarg;
+        else if (opt == 'p')
+            password = optarg;
+        else
+            badopt = 1;
+    }
+    if (! ((badopt == 0) &&
+           (argc - optind == 3) &&
+           (sscanf(argv[optind], "%d", &width) == 1) &&
+           (sscanf(argv[optind + 1], "%d", &height) == 1) &&
+           (sscanf(argv[optind + 2], "%d", &edge) == 1) &&
            (width >= 2) &&
            (height >= 2) &&
            (edge >= 2) &&
@@ -162,55 +253,45 @@ int main(int argc, char **argv)
            (edge <= MAX_EDGE)))
     {
         // Could not get puzzle parameters
-        printf("Usage: %s <width> <height> <size>\n", argv[0]);
+        printf("Usage: %s [-s] [-v] [-b <solution.bin>] [-z <zipfile> [-p <password>]] <width> <height> <size>\n", argv[0]);
         exit(1);
     }
 
-    // Allocate memory for grid
-    gw = (width * (edge - 1)) + 1;
-    gh = (height * (edge - 1)) + 1;
-    grid = (int *) malloc(sizeof(int) * gw * gh);
-    for (i = 0; i < gw; i++) {
-        for (j = 0; j < gh; j++) {
-            grid[i + (j * gw)] = -1;
-        }
-    } 
+    // Read the whole solution, from a binary file if one is given
+    loadsolution(binname, verbose);
+    if (binname && ((sol.width != width) || (sol.height != height) ||
+                    (sol.edge != edge))) {
+        printf("invalid -- %s is for a %d %d %d puzzle\n", binname,
+               sol.width, sol.height, sol.edge);
+        exit(1);
+    }
 
-    // Init the grid with the known values
-    initgrid(grid, width, height, edge);
+    // Get the pieces from the zip file if one is given
+    if (zipname) {
+        if (password == 0)
+            password = getpass("Password: ");
+        loadzip(zipname, password, edge);
+    }
+    else
+        loadfiles(edge, verbose);
+
+    // Seam checking needs no grid.  Program exit is in seamgrid().
+    if (seamonly)
+        seamgrid(width, height, edge);
+
+    // Allocate memory for the grid.  It starts with no bits claimed.
+    if (jg_init(&grid, width, height, edge) != 0) {
+        printf("malloc failure\n");
+        exit(1);
+    }
 
 
     // Read each piece from solution.txt and place it.
-    getgrid(grid, width, height, edge);
+    getgrid(&grid);
 
     // No collisions but are all grid locations filled?
     // Program exit is in testgrid().
-    testgrid(grid, width, height, edge);
-}
-
-
-/**************************************************************
- * initgrid(): - Fill the grid with -1 to indicate a bit is
- * not occupied.
- *
- **************************************************************/
-void initgrid(int *grid, int width, int height, int edge)
-{
-    int   i,j;              // loop indices
-    int   gw;               // grid width
-    int   gh;               // grid height
-    int   x;                // grid location
-
-    gw = 1 + (width * (edge -1));
-    gh = 1 + (height * (edge -1));
-
-    // Walk the array marking each location as unused
-    for (j = 0; j < gh; j++) {
-        for (i = 0; i < gw; i++) {
-             x = (j * width) + i;
-             grid[x] = -1;
-        }
-    }
+    testgrid(&grid);
 }
 
 
@@ -218,114 +299,210 @@ void initgrid(int *grid, int width, int height, int edge)
  * getgrid(): - read .pbm files and place pieces on grid
  *
  **************************************************************/
-void getgrid(int *grid, int width, int height, int edge)
+void getgrid(JGRID *grid)
 {
-    int   gw;               // Grid width
-    int   gh;               // Grid height
-    int   i,j;              // Increment over width and height
-    int   ik,jk;            // Increment over edge in i/j dimension
-    int   is,js;            // Starting i/j for loops
+    int   edge;             // Resolution of a piece edge
     int   piece = 0;        // Which piece we're working on
-    int   x = 0;            // location in the grid array
-    FILE *fp;               // File pointer to .pbm file
-    FILE *fs;               // File pointer to solution file
+    uint64_t mask;          // bits of the piece as read from the file
     int   ret;              // system call return value
     char  fname[PBMNAMELEN]; // .pbm file name
-    int   discard;          // discard lines at top of .pbm file
     int   angle;
-    char  inchar;
 
-    // get grid width and height
-    gw = (width * (edge - 1)) + 1;
-    gh = (height * (edge - 1)) + 1;
+    edge = grid->edge;
 
-    // Open the solution file
-    fs = fopen("solution.txt", "r");
-    if (fs == 0)
-        exit(1);
+    // Start at the first piece of the solution
+    solnext = 0;
 
     while (1) {             // loop reading file names from solution.txt
         // printf("%d %s %d\n", piece, fname, angle);
 
-        ret = fscanf(fs, "%s %d", fname, &angle);
+        ret = nextpiece(fname, &angle);
         // return when we hit the end of file
-        if (ret <= 0) {
-            fclose(fs);
+        if (ret <= 0)
             return;
+        mask = readpbm(fname, edge);
+
+        // Claim the grid locations for the piece at its rotation
+        ret = jg_place(grid, mask, piece, angle / 90);
+        if (ret == JG_COLLIDE) {
+            printf("invalid -- Collision between pieces %d and %d\n", grid->owner, piece);
+            exit(1);
         }
-        fp = fopen(fname, "r");
-        if (fp == 0) {
-            printf("No piece file for %s\n", fname);
+        else if (ret == JG_HOLE) {
+            printf("invalid -- missing bit at grid location j=%d i=%d\n", grid->cy, grid->cx);
+            exit(1);
+        }
+        else if (ret != JG_OK) {
+            printf("invalid -- more than %d pieces in solution.txt\n", grid->width * grid->height);
             exit(1);
         }
 
+        // loop back up to get the next piece
+        piece++;
+    }
+}
+
 
-        // read then discard the first 3 lines in .pbm file
-        discard = 3;
-        while (discard) {
-            ret = fread(&inchar, sizeof(char), 1, fp);
-            if (ret != 1) {
-                printf("Error processing file %s\n", fname);
+/**************************************************************
+ * seamgrid(): - read .pbm files and check each seam between a
+ * piece and its left and upper neighbours.  Only the bottom
+ * strips of the row above are kept, so no grid is allocated.
+ * Output 'valid' or 'invalid' and exit.
+ *
+ * The grid cells fall into three groups.  Interior cells belong
+ * to one piece and must all be set.  Cells along a seam, other
+ * than the ends, are shared by two pieces and must be set in
+ * exactly one of them.  Cells at the intersection of seams are
+ * shared by up to four pieces and must be set in exactly one.
+ * Pieces off the edge of the puzzle are treated as empty, so
+ * the same tests cover the outside border.
+ **************************************************************/
+void seamgrid(int width, int height, int edge)
+{
+    unsigned *above;        // bottom strips of the row above
+    unsigned *below;        // bottom strips of the current row
+    unsigned *swap;         // for exchanging above and below
+    unsigned  strips[4];    // strips of the current piece
+    unsigned  lright;       // right strip of the left neighbour
+    unsigned  ulb, ub;      // bottom strips of the upper left and upper pieces
+    unsigned  seam;         // mask of the non-corner cells of a strip
+    uint64_t  inner;        // mask of the interior cells of a piece
+    uint64_t  mask;         // bits of the piece as read from the file
+    int   who[4];           // pieces claiming an intersection cell
+    int   nclaim;           // number of pieces claiming the cell
+    int   first = -1;       // first piece to claim the cell
+    int   i,j;              // location of the piece in the puzzle
+    int   k;                // loop counter
+    int   piece = 0;        // Which piece we're working on
+    int   ret;              // system call return value
+    char  fname[PBMNAMELEN]; // .pbm file name
+    int   angle;
+
+    above = (unsigned *) calloc(width, sizeof(unsigned));
+    below = (unsigned *) calloc(width, sizeof(unsigned));
+    if ((above == 0) || (below == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+    seam = ((1 << edge) - 1) & ~1 & ~(1 << (edge - 1));
+    inner = jg_inner(edge);
+
+    // Start at the first piece of the solution
+    solnext = 0;
+
+    // Visit one extra row and column of empty pieces to close the border
+    lright = 0;
+    for (piece = 0; piece < (width + 1) * (height + 1); piece++) {
+        i = piece % (width + 1);
+        j = piece / (width + 1);
+
+        if ((i < width) && (j < height)) {
+            ret = nextpiece(fname, &angle);
+            if (ret <= 0) {
+                printf("invalid -- missing bit at grid location j=%d i=%d\n",
+                       j * (edge - 1), i * (edge - 1));
                 exit(1);
             }
-            if (inchar == '\n')
-                discard--;
+            mask = readpbm(fname, edge);
+            if ((mask & inner) != inner) {
+                printf("invalid -- missing bit inside piece %d\n", i + (j * width));
+                exit(1);
+            }
+            jg_strips(mask, angle / 90, edge, strips);
+        }
+        else {
+            strips[JG_TOP] = 0;
+            strips[JG_RIGHT] = 0;
+            strips[JG_BOTTOM] = 0;
+            strips[JG_LEFT] = 0;
         }
+        ub = (j > 0) && (i < width) ? above[i] : 0;
+        ulb = (j > 0) && (i > 0) ? above[i - 1] : 0;
 
-        // get to the target piece
-        i = piece % width;    // as piece number
-        j = piece / height;
-        is = i * (edge -1);      // as grid index
-        js = j * (edge -1);
-
-        // Claim grid location for each '1' in the .pbm file
-        for (jk = 0; jk < edge; jk++) {
-            for (ik = 0; ik < edge; ik++) {
-                // Compute location of bit based on rotation of piece
-                if (angle == 0)
-                    x = ik + is + ((jk + js) * gw);              // 0 rotation
-                else if (angle == 90)
-                    x = jk + is + (((edge -1 -ik) + js) * gw);           // 90
-                else if (angle == 180)
-                    x = edge -1 - ik + is + (((edge -1 -jk) + js) * gw); // 180
-                else
-                    x = edge -1 - jk + is + ((ik + js) * gw);            // 270
-
-                ret = fread(&inchar, sizeof(char), 1, fp);
-                if (ret != 1) {
-                    printf("Error processing file %s\n", fname);
-                    exit(1);
-                }
-                if (inchar == '0') {
-                    continue;
-                }
-                if (inchar == '1') {
-                    // is another piece on this spot?
-                    if (grid[x] != -1) {
-                        printf("invalid -- Collision between pieces %d and %d\n", grid[x], piece);
-                        exit(1);
-                    }
-                    // if not, we claim it
-                    grid[x] = piece;
-                }
-                else {
-                    // expected a 1 or 0, error out
-                    printf("Error processing file %s\n", fname);
-                    exit(1);
-                }
-            }
-            // skip to the next line
-            ret = fread(&inchar, sizeof(char), 1, fp);
-            if ((ret != 1) || (inchar != '\n')) { 
-                printf("Error processing file %s\n", fname);
+        // Left seam, shared with the piece to the left
+        if (j < height) {
+            seamcheck(lright, strips[JG_LEFT], seam, (i - 1) + (j * width),
+                      i + (j * width), i * (edge - 1), j * (edge - 1), 0, 1);
+        }
+
+        // Top seam, shared with the piece above
+        if (i < width) {
+            seamcheck(ub, strips[JG_TOP], seam, i + ((j - 1) * width),
+                      i + (j * width), i * (edge - 1), j * (edge - 1), 1, 0);
+        }
+
+        // Top left intersection, shared by up to four pieces
+        who[0] = (ulb >> (edge - 1)) & 1 ? (i - 1) + ((j - 1) * width) : -1;
+        who[1] = ub & 1 ? i + ((j - 1) * width) : -1;
+        who[2] = lright & 1 ? (i - 1) + (j * width) : -1;
+        who[3] = strips[JG_TOP] & 1 ? i + (j * width) : -1;
+        nclaim = 0;
+        for (k = 0; k < 4; k++) {
+            if (who[k] == -1)
+                continue;
+            if (nclaim == 1) {
+                printf("invalid -- Collision between pieces %d and %d\n", first, who[k]);
                 exit(1);
             }
+            first = who[k];
+            nclaim++;
+        }
+        if (nclaim == 0) {
+            printf("invalid -- missing bit at grid location j=%d i=%d\n",
+                   j * (edge - 1), i * (edge - 1));
+            exit(1);
         }
 
-        // loop back up to get the next piece
-        fclose(fp);
-        piece++;
+        // Save the strips needed by the next piece and next row
+        if (i < width)
+            below[i] = strips[JG_BOTTOM];
+        lright = strips[JG_RIGHT];
+        if (i == width) {
+            swap = above;
+            above = below;
+            below = swap;
+            lright = 0;
+        }
     }
+
+    // Anything left in solution.txt is one piece too many
+    if (nextpiece(fname, &angle) > 0) {
+        printf("invalid -- more than %d pieces in solution.txt\n", width * height);
+        exit(1);
+    }
+
+    // To get here means every seam and intersection is claimed once
+    printf("valid\n");
+    exit(0);
+}
+
+
+/**************************************************************
+ * seamcheck(): - verify that each non-corner cell of a seam is
+ * set in exactly one of the two strips that share it.  Exits
+ * with 'invalid' if not.
+ *
+ * Input:        the two strips, mask of the non-corner cells,
+ *               piece numbers for each strip, grid location of
+ *               the start of the seam, and the grid step (di,dj)
+ *               along the seam
+ **************************************************************/
+void seamcheck(unsigned s1, unsigned s2, unsigned seam, int p1, int p2,
+               int gi, int gj, int di, int dj)
+{
+    int   k;                // cell along the seam
+
+    if (((s1 ^ s2) & seam) == seam)
+        return;
+
+    for (k = 0; ((seam >> k) & 1) == 0 || ((s1 ^ s2) >> k) & 1; k++)
+        ;
+    if ((s1 >> k) & 1)
+        printf("invalid -- Collision between pieces %d and %d\n", p1, p2);
+    else
+        printf("invalid -- missing bit at grid location j=%d i=%d\n",
+               gj + (k * dj), gi + (k * di));
+    exit(1);
 }
 
 
@@ -334,25 +511,14 @@ void getgrid(int *grid, int width, int height, int edge)
  * Output 'valid' or 'invalid' and exit
  *
  **************************************************************/
-void testgrid(int *grid, int width, int height, int edge)
+void testgrid(JGRID *grid)
 {
-    int   i,j;              // loop indices
-    int   gw;               // grid width
-    int   gh;               // grid height
-    int   x;                // grid location
-
-    gw = 1 + (width * (edge -1));
-    gh = 1 + (height * (edge -1));
-
-    // Walk the array marking each location as unused
-    for (j = 0; j < gh; j++) {
-        for (i = 0; i < gw; i++) {
-            x = (j * gw) + i;
-            if (grid[x] == -1) {
-                printf("invalid -- missing bit at grid location j=%d i=%d\n", j, i);
-                exit(1);
-            }
-        }
+    int   i,j;              // grid location of a missing bit
+
+    if (! jg_is_complete(grid)) {
+        jg_firsthole(grid, &i, &j);
+        printf("invalid -- missing bit at grid location j=%d i=%d\n", j, i);
+        exit(1);
     }
 
     // To get here means there were no collisions and every grid location is filled
@@ -360,3 +526,249 @@ void testgrid(int *grid, int width, int height, int edge)
     exit(0);
 }
 
+
+/**************************************************************
+ * loadsolution(): - read the whole solution into memory, from
+ * solution.txt or from a binary file.  Exits on error.
+ *
+ * Input:        binary solution file or NULL, print timing if set
+ **************************************************************/
+void loadsolution(char *binname, int verbose)
+{
+    struct timespec t0, t1; // start and end time of the read
+    double secs;            // time to read the solution
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (binname) {
+        if (js_mapbin(&sol, binname) != 0) {
+            printf("Error reading binary solution %s\n", binname);
+            exit(1);
+        }
+    }
+    else if (js_readtxt(&sol, "solution.txt") != 0) {
+        if (sol.line)
+            printf("invalid -- bad line %d in solution.txt\n", sol.line);
+        else
+            printf("Error reading solution.txt: %s\n", strerror(errno));
+        exit(1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (verbose) {
+        secs = (t1.tv_sec - t0.tv_sec) + ((t1.tv_nsec - t0.tv_nsec) / 1e9);
+        fprintf(stderr, "read %d pieces from %s in %.3f ms (%.0f lines/sec)\n",
+                sol.n, binname ? binname : "solution.txt", secs * 1000,
+                (secs > 0) ? sol.n / secs : 0);
+    }
+}
+
+
+/**************************************************************
+ * loadfiles(): - read the .pbm file of every piece in the
+ * solution into memory, many at a time.  Errors are kept for
+ * readpbm() to report.
+ *
+ * Input:        edge, print timing if set
+ **************************************************************/
+void loadfiles(int edge, int verbose)
+{
+    struct timespec t0, t1; // start and end time of the read
+    double secs;            // time to read the pieces
+
+    filemask = (uint64_t *) malloc(sizeof(uint64_t) * (sol.n + 1));
+    filestat = (signed char *) malloc(sol.n + 1);
+    if ((filemask == 0) || (filestat == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (jl_foreach(sol.n, JL_AUTO, filename, filepiece, &edge) != JL_OK) {
+        printf("Error reading the piece files\n");
+        exit(1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (verbose) {
+        secs = (t1.tv_sec - t0.tv_sec) + ((t1.tv_nsec - t0.tv_nsec) / 1e9);
+        fprintf(stderr, "read %d pieces in %.3f ms (%.0f files/sec)\n",
+                sol.n, secs * 1000, (secs > 0) ? sol.n / secs : 0);
+    }
+}
+
+
+/**************************************************************
+ * filename(): - Give jl_foreach() the file name of entry n of
+ * the solution.
+ *
+ **************************************************************/
+void filename(void *arg, int n, char *fname, size_t len)
+{
+    if (sol.name)
+        snprintf(fname, len, "%s", sol.name[n]);
+    else
+        js_name(sol.ent[n], fname, len);
+}
+
+
+/**************************************************************
+ * filepiece(): - called from many threads by jl_foreach() with
+ * the contents of the file of each entry of the solution.
+ *
+ **************************************************************/
+int filepiece(void *arg, int n, const char *data, size_t len)
+{
+    int   edge = *(int *) arg;  // Resolution of a piece edge
+
+    if (data == 0)
+        filestat[n] = JP_NOFILE;
+    else if (jp_parsepbm(data, len, edge, &filemask[n]) != 0)
+        filestat[n] = JP_FORMAT;
+    else
+        filestat[n] = JP_OK;
+    return(0);
+}
+
+
+/**************************************************************
+ * nextpiece(): - get the file name and angle of the next piece
+ * in the solution.
+ *
+ * Input:        buffer for the name, angle
+ * Output:       1 if a piece was read, 0 at end of solution
+ **************************************************************/
+int nextpiece(char *fname, int *angle)
+{
+    if (solnext >= sol.n)
+        return(0);
+    if (sol.name)
+        strcpy(fname, sol.name[solnext]);   // less than PBMNAMELEN long
+    else
+        js_name(sol.ent[solnext], fname, PBMNAMELEN);
+    *angle = JS_ROT(sol.ent[solnext]) * 90;
+    solnext++;
+    return(1);
+}
+
+
+/**************************************************************
+ * readpbm(): - read a .pbm file and return its bits as a mask,
+ * bit (row * 8) + column.  The piece comes from the zip file if
+ * one was loaded, or else from the files read by loadfiles() for
+ * the entry nextpiece() just returned.  Exits on a missing or
+ * malformed file.
+ *
+ **************************************************************/
+uint64_t readpbm(char *fname, int edge)
+{
+    uint64_t mask;          // bits of the piece as read from the file
+    int   ret;              // return value
+    int   lo, hi, mid;      // binary search bounds
+    int   cmp;              // result of name comparison
+
+    if (zipsort) {
+        lo = 0;
+        hi = zipfile.nent - 1;
+        while (lo <= hi) {
+            mid = (lo + hi) / 2;
+            cmp = strcmp(fname, zipfile.ent[zipsort[mid]].base);
+            if (cmp == 0) {
+                if (! zipok[zipsort[mid]])
+                    break;
+                return(zipmask[zipsort[mid]]);
+            }
+            if (cmp < 0)
+                hi = mid - 1;
+            else
+                lo = mid + 1;
+        }
+        if (lo > hi)
+            printf("No piece file for %s\n", fname);
+        else
+            printf("Error processing file %s\n", fname);
+        exit(1);
+    }
+
+    if (filestat) {
+        ret = filestat[solnext - 1];
+        mask = filemask[solnext - 1];
+    }
+    else
+        ret = jp_readpbm(fname, edge, &mask);
+    if (ret == JP_NOFILE) {
+        printf("No piece file for %s\n", fname);
+        exit(1);
+    }
+    else if (ret != JP_OK) {
+        printf("Error processing file %s\n", fname);
+        exit(1);
+    }
+
+    return(mask);
+}
+
+
+/**************************************************************
+ * loadzip(): - read every piece in the zip file into memory and
+ * sort the pieces by name.  Exits on error.
+ *
+ **************************************************************/
+void loadzip(char *zipname, char *password, int edge)
+{
+    int   i;                // entry index
+    int   ret;              // return value
+
+    if (jz_open(&zipfile, zipname) != 0) {
+        printf("Unable to open zip file %s: %s\n", zipname, strerror(errno));
+        exit(1);
+    }
+    zipsort = (int *) malloc(sizeof(int) * (zipfile.nent + 1));
+    zipmask = (uint64_t *) malloc(sizeof(uint64_t) * (zipfile.nent + 1));
+    zipok = (char *) calloc(zipfile.nent + 1, sizeof(char));
+    if ((zipsort == 0) || (zipmask == 0) || (zipok == 0)) {
+        printf("malloc failure\n");
+        exit(1);
+    }
+
+    // Decrypt, inflate, and parse all pieces in parallel
+    ret = jz_foreach(&zipfile, password, 0, zippiece, &edge);
+    if (ret == JZ_BADPASS) {
+        printf("Wrong password for zip file %s\n", zipname);
+        exit(1);
+    }
+    else if (ret != JZ_OK) {
+        printf("Error reading zip file %s\n", zipname);
+        exit(1);
+    }
+
+    for (i = 0; i < zipfile.nent; i++)
+        zipsort[i] = i;
+    qsort(zipsort, zipfile.nent, sizeof(int), zipcmp);
+}
+
+
+/**************************************************************
+ * zippiece(): - called from many threads by jz_foreach() with
+ * the contents of each zip entry.  Entries that are not .pbm
+ * files are left marked as not valid.
+ *
+ **************************************************************/
+int zippiece(void *arg, int n, const char *data, size_t len)
+{
+    int   edge = *(int *) arg;  // Resolution of a piece edge
+
+    if (jp_parsepbm(data, len, edge, &zipmask[n]) == 0)
+        zipok[n] = 1;
+    return(0);
+}
+
+
+/**************************************************************
+ * zipcmp(): - qsort() comparison of zip entries by file name
+ *
+ **************************************************************/
+int zipcmp(const void *a, const void *b)
+{
+    return(strcmp(zipfile.ent[*(const int *) a].base,
+                  zipfile.ent[*(const int *) b].base));
+}